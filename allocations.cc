@@ -0,0 +1,37 @@
+#include "allocations.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+bool Allocations::enabled = false;
+thread_local Allocations::Counts Allocations::counts;
+
+// These read and write /proc with plain descriptors, not streams, which
+// would allocate, and be counted in the stage asking.
+
+uint64_t Allocations::peakResident() {
+  const int fd = open("/proc/self/status", O_RDONLY);
+  if (fd < 0) return 0;
+
+  char status[4096];
+  const ssize_t length = read(fd, status, sizeof(status) - 1);
+  close(fd);
+  if (length <= 0) return 0;
+  status[length] = 0;
+
+  const char* line = strstr(status, "\nVmHWM:");
+  if (line == nullptr) return 0;
+  return strtoull(line + strlen("\nVmHWM:"), nullptr, 10) * 1024;
+}
+
+bool Allocations::resetPeak() {
+  // Writing 5 to clear_refs resets VmHWM (since Linux 4.0)
+  const int fd = open("/proc/self/clear_refs", O_WRONLY);
+  if (fd < 0) return false;
+  const bool reset = write(fd, "5", 1) == 1;
+  close(fd);
+  return reset;
+}
@@ -0,0 +1,49 @@
+#if !defined ALLOCATIONS_H
+#define      ALLOCATIONS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Counts of memory allocated, and the most memory the process has used,
+// for 'track -T' and the benchmarks.
+//
+// Allocations are only counted in a build that links countnew.cc, which
+// replaces the global operator new (make COUNT_ALLOCATIONS=1, or bazel
+// --define count_allocations=1). Only operator new is counted, not what
+// C libraries like gd allocate with malloc. Each thread counts its own,
+// without locks, so a stage's count is what was allocated on its thread.
+class Allocations {
+ public:
+  struct Counts {
+    uint64_t allocations;
+    uint64_t bytes;
+  };
+
+  // Whether allocations are being counted in this build
+  static bool counting() { return enabled; }
+
+  // What's been allocated on this thread so far, or zeros if allocations
+  // aren't counted
+  static Counts onThisThread() { return counts; }
+
+  // Count an allocation of 'size' bytes on this thread. For countnew.cc.
+  static void add(size_t size) {
+    ++counts.allocations;
+    counts.bytes += size;
+  }
+  static void enable() { enabled = true; }
+
+  // The most memory the process has had resident (VmHWM from
+  // /proc/self/status), in bytes, or 0 where that isn't known
+  static uint64_t peakResident();
+
+  // Start the peak over from what's resident now, where the system can.
+  // Returns false if it can't.
+  static bool resetPeak();
+
+ private:
+  static bool enabled;
+  static thread_local Counts counts;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "bench.h"
+
+#include "allocations.h"
+#include "dtoa.h"
+#include "exception.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <math.h>
+
+using namespace std;
+
+namespace {
+
+string number(double value) {
+  char buffer[Dtoa::kBufferSize];
+  return string(buffer, Dtoa::shortest(value, buffer));
+}
+
+string jsonString(const string& value) {
+  string quoted = "\"";
+  for (char c : value) {
+    if (c == '"' || c == '\\') quoted += '\\';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+}  // namespace
+
+double Bench::Result::percentile(double p) const {
+  PRECONDITION(!seconds.empty());
+  PRECONDITION(p > 0 && p <= 100);
+
+  vector<double> sorted(seconds);
+  sort(sorted.begin(), sorted.end());
+  const size_t rank = ceil(p / 100 * sorted.size());
+  return sorted[max<size_t>(rank, 1) - 1];
+}
+
+Bench::Bench(Options opt) : options(opt) {
+  PRECONDITION(options.warmups >= 0);
+  PRECONDITION(options.repetitions > 0);
+}
+
+bool Bench::wanted(const string& name) const {
+  return name.find(options.filter) != string::npos;
+}
+
+void Bench::run(const string& name, const string& profile, size_t points,
+                size_t bytes, const function<void()>& setup,
+                const function<void()>& body, ostream& log) {
+  Result result;
+  result.name = name;
+  result.profile = profile;
+  result.points = points;
+  result.bytes = bytes;
+
+  // The peak is only this benchmark's if it can start over
+  const bool peak = Allocations::resetPeak();
+
+  for (int i = 0; i < options.warmups + options.repetitions; ++i) {
+    if (setup) setup();
+
+    const Allocations::Counts before = Allocations::onThisThread();
+    const auto start = chrono::steady_clock::now();
+    body();
+    const chrono::duration<double> elapsed =
+        chrono::steady_clock::now() - start;
+    const Allocations::Counts after = Allocations::onThisThread();
+
+    if (i >= options.warmups) result.seconds.push_back(elapsed.count());
+    result.allocations = after.allocations - before.allocations;
+    result.allocatedBytes = after.bytes - before.bytes;
+  }
+  if (peak) result.peakResident = Allocations::peakResident();
+
+  log << name << " " << profile << " " << points << ": median "
+      << result.median() * 1000 << " ms, p95 "
+      << result.percentile(95) * 1000 << " ms";
+  if (Allocations::counting()) {
+    log << ", " << result.allocations << " allocations";
+  }
+  log << endl;
+  results.push_back(result);
+}
+
+void Bench::writeJSON(ostream& out) const {
+  out << "{\n"
+      << "  \"version\": \"track-bench-1\",\n"
+      << "  \"warmups\": " << options.warmups << ",\n"
+      << "  \"repetitions\": " << options.repetitions << ",\n"
+      << "  \"counting_allocations\": "
+      << (Allocations::counting() ? "true" : "false") << ",\n"
+      << "  \"results\": [";
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& result = results[i];
+    const double median = result.median();
+    const double fastest =
+        *min_element(result.seconds.begin(), result.seconds.end());
+
+    out << (i == 0 ? "\n" : ",\n")
+        << "    {\"name\": " << jsonString(result.name)
+        << ", \"profile\": " << jsonString(result.profile)
+        << ", \"points\": " << result.points;
+    if (result.bytes > 0) out << ", \"bytes\": " << result.bytes;
+    out << ", \"median_seconds\": " << number(median)
+        << ", \"p95_seconds\": " << number(result.percentile(95))
+        << ", \"min_seconds\": " << number(fastest);
+    if (median > 0) {
+      out << ", \"points_per_second\": " << number(result.points / median);
+      if (result.bytes > 0) {
+        out << ", \"bytes_per_second\": " << number(result.bytes / median);
+      }
+    }
+    if (Allocations::counting()) {
+      out << ", \"allocations\": " << result.allocations
+          << ", \"allocated_bytes\": " << result.allocatedBytes;
+    }
+    if (result.peakResident > 0) {
+      out << ", \"peak_resident_bytes\": " << result.peakResident;
+    }
+    out << "}";
+  }
+
+  out << "\n  ]\n}\n";
+}
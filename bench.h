@@ -0,0 +1,67 @@
+#if !defined BENCH_H
+#define      BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "util.h"
+
+// Times pieces of code, for the benchmarks in benchmain.cc. Each is run a
+// few times untimed to warm up, then timed over several repetitions, and
+// reported by its median and 95th percentile, with what it allocated
+// (where that's counted; see allocations.h) and the peak memory while it
+// ran. The results are written as JSON, so runs before and after a change
+// can be compared.
+class Bench : public NoCopy {
+ public:
+  struct Options {
+    Options() {}
+
+    int warmups = 1;       // untimed runs before the timed ones
+    int repetitions = 5;
+    std::string filter;    // only run benchmarks whose name contains this
+  };
+
+  struct Result {
+    std::string name;
+    std::string profile;   // the kind of input, like the terrain
+    size_t points = 0;     // processed by each run
+    size_t bytes = 0;      // read or written by each run, if any
+    std::vector<double> seconds;  // of each repetition, in order
+    uint64_t allocations = 0;     // by each run, if counted
+    uint64_t allocatedBytes = 0;
+    uint64_t peakResident = 0;    // bytes, from when it started; 0 if unknown
+
+    double median() const { return percentile(50); }
+
+    // The nearest-rank percentile of the times
+    double percentile(double p) const;
+  };
+
+  explicit Bench(Options opt = Options());
+
+  // Whether the filter lets 'name' run
+  bool wanted(const std::string& name) const;
+
+  // Time 'body', running 'setup' (untimed) before each run. 'points' and
+  // 'bytes' are what each run processes, for the rates. Progress goes
+  // to 'log'.
+  void run(const std::string& name, const std::string& profile,
+           size_t points, size_t bytes, const std::function<void()>& setup,
+           const std::function<void()>& body, std::ostream& log);
+
+  const std::vector<Result>& getResults() const { return results; }
+
+  void writeJSON(std::ostream& out) const;
+
+ private:
+  Options options;
+  std::vector<Result> results;
+};
+
+#endif
@@ -0,0 +1,454 @@
+// bench: times the Track methods, and the readers and writers, on made-up
+// rides of several sizes and terrains (see synthetic.h), and writes the
+// results as JSON.
+//
+//   bench [-n <points,...>] [-t <terrain,...>] [-r <repetitions>]
+//         [-w <warmups>] [-f <filter>] [-d <dir>] [-o <file>]
+
+#include "bench.h"
+#include "exception.h"
+#include "geojson.h"
+#include "gnuplot.h"
+#include "json.h"
+#include "parse.h"
+#include "png.h"
+#include "polyline.h"
+#include "synthetic.h"
+#include "track.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void usage() {
+  cerr << "Usage: bench [-n <points,...>] [-t <terrain,...>]"
+       << " [-r <repetitions>] [-w <warmups>]" << endl
+       << "             [-f <filter>] [-d <dir>] [-o <file>]" << endl
+       << "Options:" << endl
+       << "             -n <points> (track sizes; default"
+       << " 1000,10000,100000,1000000)" << endl
+       << "             -t <terrains> (flat, rolling, hilly, mountainous;"
+       << " default all)" << endl
+       << "             -r <int> (timed repetitions; default 5)" << endl
+       << "             -w <int> (untimed warm-up runs; default 1)" << endl
+       << "             -f <text> (only benchmarks whose names contain it)"
+       << endl
+       << "             -d <dir> (keep the files read and written here;"
+       << " default a" << endl
+       << "               temporary directory, removed after)" << endl
+       << "             -o <file> (write the JSON here; default stdout)"
+       << endl;
+}
+
+vector<string> split(const string& text) {
+  vector<string> parts;
+  string::size_type start = 0;
+  while (true) {
+    const string::size_type comma = text.find(',', start);
+    parts.push_back(text.substr(start, comma - start));
+    if (comma == string::npos) break;
+    start = comma + 1;
+  }
+  return parts;
+}
+
+// What a benchmark needs done to the track first
+enum Stage {
+  RAW,       // as read
+  ANALYZED,  // with grades, climb and velocity, as 'track' does
+  CLIMBS     // and with its climbs found
+};
+
+// A benchmark of one method. If it changes the track, it's run on a
+// fresh copy each time. It's skipped on tracks of more than 'maxPoints'.
+struct Benchmark {
+  const char* name;
+  Stage stage;
+  bool changes;
+  function<void(Track&)> body;
+  size_t maxPoints;
+};
+
+const size_t kAnySize = SIZE_MAX;
+
+// Keeps the result of a const method, so it isn't optimized away
+volatile double sink;
+
+const vector<Benchmark>& benchmarks() {
+  static const vector<Benchmark> all = {
+    { "Point::distance", RAW, false, [](Track& track) {
+        double total = 0;
+        for (size_t i = 1; i < track.size(); ++i) {
+          total += track[i].distance(track[i - 1]);
+        }
+        sink = total;
+      }, kAnySize },
+    { "CalculateLength", RAW, true,
+      [](Track& track) { track.CalculateLength(); }, kAnySize },
+    { "RemoveBurrs", RAW, true,
+      [](Track& track) { track.RemoveBurrs(); }, kAnySize },
+    { "decayElevation", RAW, true,
+      [](Track& track) { track.decayElevation(10); }, kAnySize },
+    { "calculateSegmentGrade", RAW, true,
+      [](Track& track) { track.calculateSegmentGrade(100); }, kAnySize },
+    { "calculateClimb", RAW, true,
+      [](Track& track) { sink = track.calculateClimb(10); }, kAnySize },
+    { "calculateVelocity", RAW, true,
+      [](Track& track) { track.calculateVelocity(10); }, kAnySize },
+    { "calculatePeaks", ANALYZED, true,
+      [](Track& track) { track.calculatePeaks(2000, 50); }, kAnySize },
+    { "calculateClimbs", ANALYZED, true, [](Track& track) {
+        // As Command::calculateClimbs
+        track.calculateClimbs(4, 0.8, 1000, 6, 100, 600, 0.35);
+      }, kAnySize },
+    { "calculateDifficulty", ANALYZED, false,
+      [](Track& track) { sink = track.calculateDifficulty(); }, kAnySize },
+    { "mostDifficult", ANALYZED, false, [](Track& track) {
+        int start = 0;
+        int end = 0;
+        double score = 0;
+        track.mostDifficult(1000, start, end, score);
+        sink = score;
+      }, kAnySize },
+    { "difficultyCurve", ANALYZED, false, [](Track& track) {
+        const vector<Track::Difficult> curve =
+            track.difficultyCurve(Track::defaultDifficultyWindows());
+        sink = curve.back().score;
+      }, kAnySize },
+    { "meanMaxCurve/speed", RAW, false, [](Track& track) {
+        sink = track.meanMaxCurve(Track::SPEED).back().value;
+      }, kAnySize },
+    { "meanMaxCurve/heart-rate", RAW, false, [](Track& track) {
+        sink = track.meanMaxCurve(Track::HEART_RATE).back().value;
+      }, kAnySize },
+    { "calculateMovingTime", ANALYZED, false,
+      [](Track& track) { sink = track.calculateMovingTime(); }, kAnySize },
+    // This erases points one run at a time, so its time grows with the
+    // square of the size
+    { "ShrinkBySample", CLIMBS, true,
+      [](Track& track) { track.ShrinkBySample(track.size() / 10 + 1); },
+      100000 },
+    { "ShrinkByAverage", CLIMBS, true,
+      [](Track& track) { track.ShrinkByAverage(track.size() / 10 + 1); },
+      kAnySize },
+    { "ResampleByDistance", CLIMBS, true,
+      [](Track& track) { track.ResampleByDistance(20); }, kAnySize },
+    { "Simplify/douglas-peucker", CLIMBS, true,
+      [](Track& track) { track.Simplify(5, Track::DOUGLAS_PEUCKER); },
+      kAnySize },
+    { "Simplify/visvalingam-whyatt", CLIMBS, true,
+      [](Track& track) { track.Simplify(5, Track::VISVALINGAM_WHYATT); },
+      kAnySize },
+  };
+  return all;
+}
+
+// A format the rides are read from and written to, through Parse::read
+// and Synthetic::write
+struct Format {
+  Parse::Format format;
+  const char* suffix;
+  const char* writer;  // the class that writes it
+};
+
+const Format kFormats[] = {
+  { Parse::FORMAT_GPX, "gpx", "GPX" },
+  { Parse::FORMAT_KML, "kml", "KML" },
+  { Parse::FORMAT_TEXT, "txt", "Text" },
+};
+
+// A format that's only written, with the options 'track' uses by
+// default. It's written from the track with its climbs found, as the
+// writers show them.
+struct Writer {
+  const char* name;  // the class that writes it
+  const char* suffix;
+  function<void(ostream&, const Track&)> write;
+};
+
+const vector<Writer>& writers() {
+  static const vector<Writer> all = {
+    { "JSON", "json", [](ostream& out, const Track& track) {
+        JSON::write(out, track, JSON::Options());
+      } },
+    { "GeoJSON", "geojson", [](ostream& out, const Track& track) {
+        GeoJSON::write(out, track, GeoJSON::Options());
+      } },
+    { "Polyline", "polyline", [](ostream& out, const Track& track) {
+        Polyline::write(out, track, Polyline::Options());
+      } },
+    { "Gnuplot", "gp", [](ostream& out, const Track& track) {
+        Gnuplot::write(out, track, Gnuplot::Options());
+      } },
+    { "PNG", "png", [](ostream& out, const Track& track) {
+        PNG::write(out, track, PNG::Options());
+      } },
+  };
+  return all;
+}
+
+// The directory the rides are written to for the I/O benchmarks, and the
+// files in it. A temporary one is removed, files and all, when done.
+class Corpus : public NoCopy {
+ public:
+  explicit Corpus(const string& dir) : directory(dir) {
+    if (directory.empty()) {
+      const char* tmp = getenv("TMPDIR");
+      string pattern = string(tmp != nullptr ? tmp : "/tmp") +
+          "/bench.XXXXXX";
+      if (mkdtemp(&pattern[0]) == nullptr) {
+        throw SystemException(errno, "Unable to make a directory in " +
+                              pattern);
+      }
+      directory = pattern;
+      temporary = true;
+    }
+  }
+
+  ~Corpus() {
+    if (!temporary) return;
+    for (const string& file : files) unlink(file.c_str());
+    rmdir(directory.c_str());
+  }
+
+  // Write a file named by the arguments with 'body', and return its name
+  string add(const string& profile, size_t points, const string& suffix,
+             const function<void(ostream&)>& body) {
+    const string name = directory + "/" + profile + "-" +
+        to_string(points) + "." + suffix;
+    write(name, body);
+    files.push_back(name);
+    return name;
+  }
+
+  static void write(const string& name,
+                    const function<void(ostream&)>& body) {
+    ofstream out(name.c_str(), ios::out | ios::trunc | ios::binary);
+    if (!out) throw SystemException(errno, "Unable to open " + name);
+    body(out);
+    out.close();
+    if (!out) throw SystemException(errno, "Unable to write " + name);
+  }
+
+  static size_t size(const string& name) {
+    struct stat status;
+    if (stat(name.c_str(), &status) != 0) {
+      throw SystemException(errno, "Unable to stat " + name);
+    }
+    return status.st_size;
+  }
+
+ private:
+  string directory;
+  bool temporary = false;
+  vector<string> files;
+};
+
+// Make standard input read 'name' from the start, as if it were piped or
+// redirected there, so Parse::read reads it through cin.
+void redirectInput(const string& name) {
+  const int fd = open(name.c_str(), O_RDONLY);
+  if (fd < 0) throw SystemException(errno, "Unable to open " + name);
+  const int result = dup2(fd, STDIN_FILENO);
+  const int error = errno;
+  close(fd);
+  if (result < 0) throw SystemException(error, "Unable to redirect input");
+
+  // Drop whatever stdio read before, and start again
+  clearerr(stdin);
+  fseek(stdin, 0, SEEK_SET);
+  cin.clear();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  try {
+    Bench::Options options;
+    vector<size_t> sizes = { 1000, 10000, 100000, 1000000 };
+    vector<Synthetic::Terrain> terrains;
+    string directory;
+    string output;
+
+    while (true) {
+      const int opt = getopt(argc, argv, "n:t:r:w:f:d:o:");
+      if (opt == -1) break;
+
+      switch (opt) {
+        case 'n':
+          sizes.clear();
+          for (const string& size : split(optarg)) {
+            const long points = strtol(size.c_str(), 0, 0);
+            if (points < 1) {
+              throw Exception("-n (points) must be positive");
+            }
+            sizes.push_back(points);
+          }
+          break;
+
+        case 't':
+          for (const string& name : split(optarg)) {
+            terrains.push_back(Synthetic::findTerrain(name));
+          }
+          break;
+
+        case 'r':
+          options.repetitions = strtol(optarg, 0, 0);
+          if (options.repetitions < 1) {
+            throw Exception("-r (repetitions) must be positive");
+          }
+          break;
+
+        case 'w':
+          options.warmups = strtol(optarg, 0, 0);
+          if (options.warmups < 0) {
+            throw Exception("-w (warm-ups) can't be negative");
+          }
+          break;
+
+        case 'f':
+          options.filter = optarg;
+          break;
+
+        case 'd':
+          directory = optarg;
+          break;
+
+        case 'o':
+          output = optarg;
+          break;
+
+        default:
+          throw Exception("Unknown option");
+      }
+    }
+    if (optind != argc) {
+      throw Exception(string("Extra parameter detected: ") + argv[optind]);
+    }
+    if (terrains.empty()) {
+      for (int t = 0; t < Synthetic::TERRAIN_COUNT; ++t) {
+        terrains.push_back(static_cast<Synthetic::Terrain>(t));
+      }
+    }
+
+    // Open the output first, so a bad name doesn't waste a run
+    ofstream file;
+    if (!output.empty()) {
+      file.open(output.c_str(), ios::out | ios::trunc);
+      if (!file) {
+        throw SystemException(errno, "Unable to open " + output);
+      }
+    }
+
+    Bench bench(options);
+    Corpus corpus(directory);
+    for (Synthetic::Terrain terrain : terrains) {
+      for (size_t size : sizes) {
+        Synthetic::Options synthetic;
+        synthetic.terrain = terrain;
+
+        // The track at each stage
+        Track tracks[CLIMBS + 1];
+        Synthetic::generate(tracks[RAW], size, synthetic);
+        tracks[ANALYZED] = tracks[RAW];
+        tracks[ANALYZED].calculateSegmentGrade(100);
+        tracks[ANALYZED].calculateClimb(10);
+        tracks[ANALYZED].calculateVelocity(10);
+        tracks[CLIMBS] = tracks[ANALYZED];
+        tracks[CLIMBS].calculateClimbs(4, 0.8, 1000, 6, 100, 600, 0.35);
+
+        Track work;
+        for (const Benchmark& benchmark : benchmarks()) {
+          if (!bench.wanted(benchmark.name) ||
+              size > benchmark.maxPoints) {
+            continue;
+          }
+
+          const Track& input = tracks[benchmark.stage];
+          function<void()> setup;
+          if (benchmark.changes) {
+            setup = [&] { work = input; };
+          } else {
+            work = input;
+          }
+          bench.run(benchmark.name, Synthetic::terrainName(terrain), size,
+                    0, setup, [&] { benchmark.body(work); }, cerr);
+        }
+
+        // Write the ride in each format, then read it back from the file
+        // and from standard input
+        const string profile = Synthetic::terrainName(terrain);
+        for (const Format& format : kFormats) {
+          const string write = string(format.writer) + "::write/file";
+          const string read = string("Parse::read/") + format.suffix;
+          if (!bench.wanted(write) && !bench.wanted(read + "/file") &&
+              !bench.wanted(read + "/stdin")) {
+            continue;
+          }
+
+          const Track& input = tracks[RAW];
+          const function<void(ostream&)> body = [&](ostream& out) {
+            Synthetic::write(out, input, format.format);
+          };
+          const string name = corpus.add(profile, size, format.suffix, body);
+          const size_t bytes = Corpus::size(name);
+
+          if (bench.wanted(write)) {
+            bench.run(write, profile, size, bytes, nullptr,
+                      [&] { Corpus::write(name, body); }, cerr);
+          }
+          if (bench.wanted(read + "/file")) {
+            bench.run(read + "/file", profile, size, bytes,
+                      [&] { work = Track(); },
+                      [&] { Parse::read(name, work, format.format); }, cerr);
+          }
+          if (bench.wanted(read + "/stdin")) {
+            bench.run(read + "/stdin", profile, size, bytes, [&] {
+                work = Track();
+                redirectInput(name);
+              }, [&] { Parse::read("-", work, format.format); }, cerr);
+          }
+        }
+
+        // And each format that's only written
+        for (const Writer& writer : writers()) {
+          const string write = string(writer.name) + "::write/file";
+          if (!bench.wanted(write)) continue;
+
+          const Track& input = tracks[CLIMBS];
+          const function<void(ostream&)> body = [&](ostream& out) {
+            writer.write(out, input);
+          };
+          const string name = corpus.add(profile, size, writer.suffix, body);
+          bench.run(write, profile, size, Corpus::size(name), nullptr,
+                    [&] { Corpus::write(name, body); }, cerr);
+        }
+      }
+    }
+
+    bench.writeJSON(output.empty() ? cout : file);
+    return 0;
+
+  } catch (const std::exception& e) {
+    cerr << e.what() << endl;
+  } catch (...) {
+    cerr << "Unknown exception in main" << endl;
+  }
+
+  usage();
+  return 1;
+}
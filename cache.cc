@@ -0,0 +1,187 @@
+#include "cache.h"
+
+#include "dir.h"
+#include "exception.h"
+#include "hash.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const char kMagic[] = "TRACKCACHE1\n";
+const size_t kMagicLength = sizeof(kMagic) - 1;
+const size_t kKeyLength = 32;
+
+void appendString(string& out, const string& text) {
+  PRECONDITION(text.size() <= UINT32_MAX);
+  const uint32_t len = text.size();
+  out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+  out.append(text);
+}
+
+bool readString(const string& in, size_t& offset, string& text) {
+  uint32_t len;
+  if (in.size() - offset < sizeof(len)) return false;
+  memcpy(&len, in.data() + offset, sizeof(len));
+  offset += sizeof(len);
+  if (in.size() - offset < len) return false;
+  text.assign(in, offset, len);
+  offset += len;
+  return true;
+}
+
+bool isKey(const string& name) {
+  return name.size() == kKeyLength &&
+         name.find_first_not_of("0123456789abcdef") == string::npos;
+}
+
+struct Result {
+  string path;
+  timespec used;
+  uint64_t size;
+
+  bool operator<(const Result& other) const {
+    if (used.tv_sec != other.used.tv_sec) {
+      return used.tv_sec < other.used.tv_sec;
+    }
+    return used.tv_nsec < other.used.tv_nsec;
+  }
+};
+
+}  // namespace
+
+ResultCache::ResultCache(const string& directory, uint64_t maxBytes)
+    : dir(directory), limit(maxBytes) {
+  PRECONDITION(!directory.empty());
+
+  if (::mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST) {
+    throw SystemException(errno, "Creating cache directory " + dir);
+  }
+}
+
+string ResultCache::key(const string& input, const string& options) {
+  const uint64_t inputHash = Hash::xxh64(input.data(), input.size());
+  const uint64_t hash = Hash::xxh64(options.data(), options.size(), inputHash);
+
+  char text[kKeyLength + 1];
+  snprintf(text, sizeof(text), "%016llx%016llx",
+           static_cast<unsigned long long>(inputHash),
+           static_cast<unsigned long long>(hash));
+  return text;
+}
+
+bool ResultCache::find(const string& key, Entry& entry) const {
+  PRECONDITION(isKey(key));
+
+  const string path = Directory::createPath(dir, key);
+  ifstream in(path.c_str(), ios::in | ios::binary);
+  if (!in) return false;
+
+  const string data((istreambuf_iterator<char>(in)),
+                    istreambuf_iterator<char>());
+  if (data.compare(0, kMagicLength, kMagic) != 0) return false;
+
+  size_t offset = kMagicLength;
+  uint32_t count;
+  if (data.size() - offset < sizeof(count)) return false;
+  memcpy(&count, data.data() + offset, sizeof(count));
+  offset += sizeof(count);
+
+  Entry found;
+  if (!readString(data, offset, found.messages)) return false;
+  // Each output takes at least its length
+  if ((data.size() - offset) / sizeof(uint32_t) < count) return false;
+  found.outputs.resize(count);
+  for (string& output : found.outputs) {
+    if (!readString(data, offset, output)) return false;
+  }
+  if (offset != data.size()) return false;
+
+  // Mark it as recently used
+  ::utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+
+  entry.messages.swap(found.messages);
+  entry.outputs.swap(found.outputs);
+  return true;
+}
+
+void ResultCache::store(const string& key, const Entry& entry) const {
+  PRECONDITION(isKey(key));
+
+  string data(kMagic, kMagicLength);
+  const uint32_t count = entry.outputs.size();
+  data.append(reinterpret_cast<const char*>(&count), sizeof(count));
+  appendString(data, entry.messages);
+  for (const string& output : entry.outputs) {
+    appendString(data, output);
+  }
+  if (data.size() > limit) return;
+
+  // Write it under a name nobody else will use, so readers only ever see
+  // a complete result
+  static atomic<unsigned> sequence(0);
+  const string path = Directory::createPath(dir, key);
+  const string temporary = path + ".tmp." + to_string(::getpid()) + "." +
+                           to_string(sequence++);
+  {
+    ofstream out(temporary.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!out) {
+      throw SystemException(errno, "Unable to open " + temporary);
+    }
+    out.write(data.data(), data.size());
+    out.close();
+    if (!out) {
+      ::unlink(temporary.c_str());
+      throw Exception("Error writing " + temporary);
+    }
+  }
+
+  if (::rename(temporary.c_str(), path.c_str()) != 0) {
+    const int error = errno;
+    ::unlink(temporary.c_str());
+    throw SystemException(error, "Unable to rename " + temporary);
+  }
+
+  evict();
+}
+
+void ResultCache::evict() const {
+  vector<Result> results;
+  uint64_t total = 0;
+
+  Directory d(dir.c_str());
+  while (d.next()) {
+    if (!isKey(d.getFilename())) continue;
+
+    Result result;
+    result.path = Directory::createPath(dir, d.getFilename());
+    struct stat info;
+    if (::stat(result.path.c_str(), &info) != 0) continue;
+    result.used = info.st_mtim;
+    result.size = info.st_size;
+    total += result.size;
+    results.push_back(result);
+  }
+
+  if (total <= limit) return;
+
+  // Remove the least recently used first. Another process may be doing
+  // the same, so a result that's already gone still counts.
+  sort(results.begin(), results.end());
+  for (const Result& result : results) {
+    if (total <= limit) break;
+    ::unlink(result.path.c_str());
+    total -= result.size;
+  }
+}
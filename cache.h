@@ -0,0 +1,49 @@
+#if !defined CACHE_H
+#define      CACHE_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "util.h"
+
+// Results of running 'track', kept on disk by the content of the input
+// and the options, so a repeated request needn't read the input at all.
+//
+// Each result is a file in the cache directory, named by its key. Using
+// a result updates its modification time, and storing one removes the
+// least recently used results until the directory is within its limit.
+// Results are written to a temporary file and renamed, so several
+// processes can share a directory.
+class ResultCache : public NoCopy {
+ public:
+  struct Entry {
+    std::string messages;              // what was written to stderr
+    std::vector<std::string> outputs;  // each -o output, in order
+  };
+
+  // The directory is created if necessary (but not its parents)
+  ResultCache(const std::string& directory, uint64_t maxBytes);
+
+  // The key for the input's contents and a description of the options,
+  // which must include everything that could change the results.
+  static std::string key(const std::string& input,
+                         const std::string& options);
+
+  // Find the result for 'key'. A missing or unreadable result isn't an
+  // error; it's just not found.
+  bool find(const std::string& key, Entry& entry) const;
+
+  // Add the result for 'key', then evict results to stay within the
+  // limit. A result larger than the limit isn't kept.
+  void store(const std::string& key, const Entry& entry) const;
+
+ private:
+  void evict() const;
+
+  std::string dir;
+  uint64_t limit;
+};
+
+#endif
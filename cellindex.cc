@@ -0,0 +1,358 @@
+#include "cellindex.h"
+
+#include "exception.h"
+#include "point.h"
+#include "track.h"
+
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const char kMagic[8] = { 'T', 'R', 'A', 'C', 'K', 'C', 'I', '1' };
+const uint32_t kVersion = 1;
+
+// The resolutions of the grid: a level has 2^level columns over 360
+// degrees of longitude, and 2^level rows over 180 of latitude. At the
+// equator a cell is about 39 km wide at level 10, 4.9 km at 13, and 610 m
+// at 16 (and half that high).
+const uint8_t kLevels[] = { 10, 13, 16 };
+const int kLevelCount = sizeof(kLevels) / sizeof(kLevels[0]);
+
+// A query uses the finest level that covers its area in at most this
+// many cells
+const uint64_t kMaxQueryCells = 64;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t activities;
+  uint64_t cells;
+  uint8_t levels[8];
+};
+
+uint32_t column(double lon, int level) {
+  const double cells = 1u << level;
+  const double x = floor((lon + 180) / 360 * cells);
+  return std::min(std::max(x, 0.0), cells - 1);
+}
+
+uint32_t row(double lat, int level) {
+  const double cells = 1u << level;
+  const double y = floor((lat + 90) / 180 * cells);
+  return std::min(std::max(y, 0.0), cells - 1);
+}
+
+// Spread the low 32 bits of 'x' out to the even bits
+uint64_t spread(uint64_t x) {
+  x &= 0xffffffffULL;
+  x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+  x = (x | (x << 8)) & 0x00ff00ff00ff00ffULL;
+  x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  x = (x | (x << 2)) & 0x3333333333333333ULL;
+  x = (x | (x << 1)) & 0x5555555555555555ULL;
+  return x;
+}
+
+// The level is in the top byte, so cells of a level are together
+uint64_t cellKey(int level, uint32_t x, uint32_t y) {
+  return (static_cast<uint64_t>(level) << 56) | spread(x) | (spread(y) << 1);
+}
+
+void appendVarint(string& out, uint32_t value) {
+  while (value >= 0x80) {
+    out += static_cast<char>(value | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+// Read a varint, advancing 'p'. Throws an Exception if it runs past 'end'.
+uint32_t readVarint(const char*& p, const char* end) {
+  uint32_t value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (p == end) break;
+    const uint8_t byte = *p++;
+    value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return value;
+  }
+  throw Exception("The cell index is damaged (postings)");
+}
+
+// Decode the visits of a cell, calling 'found' with each activity and
+// run of points. Each visit is three varints: the change in activity, the
+// first point (less the previous first point if the activity is
+// unchanged), and the number of points after the first.
+template <class F>
+void decode(const char* p, size_t bytes, const F& found) {
+  const char* const end = p + bytes;
+  uint32_t activity = 0;
+  uint32_t first = 0;
+  while (p < end) {
+    const uint32_t delta = readVarint(p, end);
+    const uint32_t start = readVarint(p, end);
+    const uint32_t length = readVarint(p, end);
+    activity += delta;
+    first = delta == 0 ? first + start : start;
+    found(activity, first, first + length);
+  }
+}
+
+// The distance in meters from a position to the nearest part of a
+// rectangle, in degrees
+double distanceToRectangle(double lat, double lon,
+                           double minLat, double minLon,
+                           double maxLat, double maxLon) {
+  Point from;
+  from.lat = lat;
+  from.lon = lon;
+  Point to;
+  to.lat = std::min(std::max(lat, minLat), maxLat);
+  to.lon = std::min(std::max(lon, minLon), maxLon);
+  return from.distance(to);
+}
+
+}  // namespace
+
+CellIndex::Builder::Builder(const CellIndex& existing)
+    : count(existing.count) {
+  for (size_t i = 0; i < existing.tableSize; ++i) {
+    const Cell& cell = existing.table[i];
+    if (cell.offset > existing.postingsSize ||
+        cell.bytes > existing.postingsSize - cell.offset) {
+      throw Exception("The cell index is damaged (cells)");
+    }
+
+    Postings& postings = cells[cell.cell];
+    const char* data = existing.postings + cell.offset;
+    postings.encoded.assign(data, cell.bytes);
+    decode(data, cell.bytes, [&](uint32_t activity, uint32_t first,
+                                 uint32_t) {
+      postings.activity = activity;
+      postings.first = first;
+    });
+  }
+}
+
+uint32_t CellIndex::Builder::add(const vector<Visit>& visits) {
+  const uint32_t id = count++;
+  for (const Visit& visit : visits) {
+    PRECONDITION(visit.first <= visit.last);
+    Postings& postings = cells[visit.cell];
+    const uint32_t delta = id - postings.activity;
+    PRECONDITION(delta > 0 || visit.first >= postings.first);
+
+    appendVarint(postings.encoded, delta);
+    appendVarint(postings.encoded,
+                 delta == 0 ? visit.first - postings.first : visit.first);
+    appendVarint(postings.encoded, visit.last - visit.first);
+    postings.activity = id;
+    postings.first = visit.first;
+  }
+  return id;
+}
+
+void CellIndex::Builder::write(const string& filename) const {
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.activities = count;
+  header.cells = cells.size();
+  copy(kLevels, kLevels + kLevelCount, header.levels);
+
+  vector<Cell> table;
+  table.reserve(cells.size());
+  uint64_t offset = 0;
+  for (const auto& cell : cells) {
+    table.push_back(Cell{ cell.first, offset, cell.second.encoded.size() });
+    offset += cell.second.encoded.size();
+  }
+
+  const string temporary = filename + ".tmp." + to_string(::getpid());
+  {
+    ofstream out(temporary.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!out) {
+      throw SystemException(errno, "Unable to open " + temporary);
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(table.data()),
+              table.size() * sizeof(Cell));
+    for (const auto& cell : cells) {
+      out.write(cell.second.encoded.data(), cell.second.encoded.size());
+    }
+
+    out.close();
+    if (!out) {
+      ::unlink(temporary.c_str());
+      throw Exception("Error writing " + temporary);
+    }
+  }
+
+  if (::rename(temporary.c_str(), filename.c_str()) != 0) {
+    const int error = errno;
+    ::unlink(temporary.c_str());
+    throw SystemException(error, "Unable to rename " + temporary);
+  }
+}
+
+vector<CellIndex::Visit> CellIndex::visits(const Track& track) {
+  vector<Visit> result;
+  if (track.empty()) return result;
+
+  for (int level : kLevels) {
+    Visit visit;
+    visit.cell = cellKey(level, column(track[0].lon, level),
+                         row(track[0].lat, level));
+    visit.first = 0;
+    for (uint32_t i = 1; i < track.size(); ++i) {
+      const uint64_t cell = cellKey(level, column(track[i].lon, level),
+                                    row(track[i].lat, level));
+      if (cell == visit.cell) continue;
+
+      visit.last = i - 1;
+      result.push_back(visit);
+      visit.cell = cell;
+      visit.first = i;
+    }
+    visit.last = track.size() - 1;
+    result.push_back(visit);
+  }
+
+  return result;
+}
+
+CellIndex::CellIndex(const string& filename)
+    : file(filename), count(0), table(nullptr), tableSize(0),
+      postings(nullptr), postingsSize(0) {
+  if (file.size() == 0) return;
+
+  Header header;
+  if (file.size() < sizeof(header)) {
+    throw Exception(filename + " is not a cell index");
+  }
+  memcpy(&header, file.data(), sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    throw Exception(filename + " is not a cell index");
+  }
+  if (header.version != kVersion ||
+      !equal(kLevels, kLevels + kLevelCount, header.levels)) {
+    throw Exception(filename + " is from a different version of trackdb");
+  }
+  if (header.cells > (file.size() - sizeof(header)) / sizeof(Cell)) {
+    throw Exception(filename + " is damaged (cells)");
+  }
+
+  // The cells are checked as they're used, so opening is quick
+  count = header.activities;
+  table = reinterpret_cast<const Cell*>(file.data() + sizeof(header));
+  tableSize = header.cells;
+  postings = reinterpret_cast<const char*>(table + tableSize);
+  postingsSize = file.size() - (postings - file.data());
+}
+
+const CellIndex::Cell* CellIndex::findCell(uint64_t cell) const {
+  const Cell* const end = table + tableSize;
+  const Cell* found = lower_bound(table, end, cell,
+                                  [](const Cell& c, uint64_t key) {
+                                    return c.cell < key;
+                                  });
+  if (found == end || found->cell != cell) return nullptr;
+
+  if (found->offset > postingsSize ||
+      found->bytes > postingsSize - found->offset) {
+    throw Exception("The cell index is damaged (cells)");
+  }
+  return found;
+}
+
+vector<CellIndex::Match> CellIndex::within(double minLat, double minLon,
+                                           double maxLat,
+                                           double maxLon) const {
+  return search(minLat, minLon, maxLat, maxLon, 0, 0, 0);
+}
+
+vector<CellIndex::Match> CellIndex::near(double lat, double lon,
+                                         double meters) const {
+  PRECONDITION(meters > 0);
+
+  // A little more than a degree's worth of meters, so the rectangle is
+  // never too small
+  const double degrees = meters / 111000;
+  const double widths = degrees /
+      std::max(cos(lat * M_PI / 180), 0.01);
+  return search(lat - degrees, lon - widths, lat + degrees, lon + widths,
+                lat, lon, meters);
+}
+
+vector<CellIndex::Match> CellIndex::search(double minLat, double minLon,
+                                           double maxLat, double maxLon,
+                                           double lat, double lon,
+                                           double meters) const {
+  vector<Match> matches;
+  if (tableSize == 0 || minLat > maxLat || minLon > maxLon) return matches;
+
+  // The finest level with few enough cells, else the coarsest
+  int level = kLevels[0];
+  for (int i = kLevelCount - 1; i >= 0; --i) {
+    const uint64_t columns = column(maxLon, kLevels[i]) -
+                             column(minLon, kLevels[i]) + 1;
+    const uint64_t rows = row(maxLat, kLevels[i]) -
+                          row(minLat, kLevels[i]) + 1;
+    if (columns * rows <= kMaxQueryCells) {
+      level = kLevels[i];
+      break;
+    }
+  }
+
+  const double width = 360.0 / (1u << level);
+  const double height = 180.0 / (1u << level);
+  for (uint32_t y = row(minLat, level); y <= row(maxLat, level); ++y) {
+    for (uint32_t x = column(minLon, level); x <= column(maxLon, level);
+         ++x) {
+      if (meters > 0) {
+        const double cellLat = y * height - 90;
+        const double cellLon = x * width - 180;
+        if (distanceToRectangle(lat, lon, cellLat, cellLon,
+                                cellLat + height, cellLon + width) > meters) {
+          continue;
+        }
+      }
+
+      const Cell* cell = findCell(cellKey(level, x, y));
+      if (cell == nullptr) continue;
+
+      decode(postings + cell->offset, cell->bytes,
+             [&](uint32_t activity, uint32_t first, uint32_t last) {
+               matches.push_back(Match{ activity, first, last });
+             });
+    }
+  }
+
+  // Join the runs of each activity that overlap or touch, which come
+  // from neighboring cells
+  sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) {
+    return a.activity != b.activity ? a.activity < b.activity
+                                    : a.first < b.first;
+  });
+  size_t joined = 0;
+  for (size_t i = 0; i < matches.size(); ++i) {
+    if (joined > 0 && matches[joined - 1].activity == matches[i].activity &&
+        matches[i].first <= matches[joined - 1].last + 1) {
+      matches[joined - 1].last = std::max(matches[joined - 1].last,
+                                          matches[i].last);
+    } else {
+      matches[joined++] = matches[i];
+    }
+  }
+  matches.resize(joined);
+  return matches;
+}
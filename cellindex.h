@@ -0,0 +1,113 @@
+#if !defined CELLINDEX_H
+#define      CELLINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "util.h"
+
+class Track;
+
+// An index of where activities went: for each cell of a grid over the
+// world, the activities with points in it, and which points.
+//
+// The grid is kept at a few resolutions (see kLevels in cellindex.cc),
+// from tens of kilometers down to a few hundred meters, so a query can
+// use whichever suits the size of the area. Cells are numbered by
+// interleaving the bits of their column and row, like a quadkey, so
+// neighboring cells tend to be near each other in the file.
+//
+// Each cell has a list of visits, sorted by activity then point. A visit
+// is a run of consecutive points in the cell. The lists are delta and
+// varint encoded, typically taking a few bytes per visit. The file is
+// mapped into memory, and a query reads only the cells it needs.
+class CellIndex : public NoCopy {
+ public:
+  // A run of points, 'first' to 'last' inclusive, in one activity
+  struct Match {
+    uint32_t activity;
+    uint32_t first;
+    uint32_t last;
+  };
+
+  // A run of points in one cell of one track
+  struct Visit {
+    uint64_t cell;
+    uint32_t first;
+    uint32_t last;
+  };
+
+  // Adds activities to an index, and writes it to a file
+  class Builder : public NoCopy {
+   public:
+    // Start with the contents of 'existing'
+    explicit Builder(const CellIndex& existing);
+
+    // Add the next activity, given the result of 'visits'. Returns its id.
+    uint32_t add(const std::vector<Visit>& visits);
+
+    size_t activities() const { return count; }
+
+    // Write a new file, and rename it over 'filename'
+    void write(const std::string& filename) const;
+
+   private:
+    struct Postings {
+      std::string encoded;
+      uint32_t activity = 0;  // of the last visit encoded
+      uint32_t first = 0;
+    };
+
+    uint32_t count;
+    std::map<uint64_t, Postings> cells;
+  };
+
+  // The cells a track visits, at every level
+  static std::vector<Visit> visits(const Track& track);
+
+  // Map the index in 'filename'. A missing file is an empty index.
+  explicit CellIndex(const std::string& filename);
+
+  // The number of activities indexed. Their ids are 0 to activities() - 1.
+  size_t activities() const { return count; }
+
+  // Find the points that may be within the rectangle, in degrees. Since
+  // cells don't match the rectangle exactly, some points may be just
+  // outside it, but none inside are missed. The results are sorted, and
+  // runs that overlap or touch are joined.
+  std::vector<Match> within(double minLat, double minLon,
+                            double maxLat, double maxLon) const;
+
+  // Find the points that may be within 'meters' of a position, as
+  // 'within' does.
+  std::vector<Match> near(double lat, double lon, double meters) const;
+
+ private:
+  // A cell in the file, with its encoded visits
+  struct Cell {
+    uint64_t cell;
+    uint64_t offset;  // into 'postings'
+    uint64_t bytes;
+  };
+
+  const Cell* findCell(uint64_t cell) const;
+
+  // Find the points that may be within the rectangle. If 'meters' is
+  // positive, skip cells further than that from 'lat' and 'lon'.
+  std::vector<Match> search(double minLat, double minLon,
+                            double maxLat, double maxLon,
+                            double lat, double lon, double meters) const;
+
+  MappedFile file;
+  uint32_t count;
+  const Cell* table;
+  size_t tableSize;
+  const char* postings;
+  size_t postingsSize;
+};
+
+#endif
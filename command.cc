@@ -0,0 +1,1306 @@
+#include "command.h"
+
+#include "cache.h"
+#include "dir.h"
+#include "exception.h"
+#include "geojson.h"
+#include "gnuplot.h"
+#include "gpx.h"
+#include "json.h"
+#include "polyline.h"
+#include "profile.h"
+#include "text.h"
+
+#include <getopt.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iostream>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+void Command::usage(ostream& out) {
+  out << "Usage: track [-options] [input-files]" << endl
+      << "Options:" << endl
+      << "             -a <int> (alpha for KML line, 0..255)" << endl
+      << "             -b <lon-1>,<lon-2>,<lat-1>,<lat-2> (mask)" << endl
+      << "             -c (calculate climbs)" << endl
+      << "             -d (calculate most difficult KM)" << endl
+      << "             -e (omit start/end in KML)" << endl
+      << "             -f <input-file> " << endl
+      << "             -g (write numbers in shortest exact form)" << endl
+      << "             -h <int> (elevation decay samples)" << endl
+      << "             -i <input-format> (gpx, kml, fit, txt -- optional)"
+      << endl
+      << "             -j <name> (JSON callback function)" << endl
+      << "             -k min,max (displayed elevation range)" << endl
+      << "             -l (KML line color - BGR, eg 0xBBGGRR)" << endl
+      << "             -m (metric)" << endl
+      << "             -n <int> (average down to 'n' samples)" << endl
+      << "             -o <output-format>[:<path>] (gpx, kml, gnuplot,"
+      << endl
+      << "                txt, png, json, geojson, polyline; repeatable,"
+      << endl
+      << "                default path stdout)"
+      << endl
+      << "             -p (calculate peaks)" << endl
+      << "             -q (quiet; print nothing extra)" << endl
+      << "             -r (calculate length relative to previous points)"
+      << endl
+      << "             -s <int> (sample)" << endl
+      << "             -t <string> (gnuplot terminal)" << endl
+      << "             -u width,height (PNG image dimensions)" << endl
+      << "             -v (verbose; default)" << endl
+      << "             -w <double> (width of KML line)" << endl
+      << "             -x <meters> (resample to a point every 'n' meters)"
+      << endl
+      << "             -y (remove burrs; default true)" << endl
+      << "             -z (indicate days in PNG output; default false)" << endl
+      << "             -C <directory>[,<megabytes>] (keep results in a cache,"
+      << endl
+      << "                by input and options; default limit 1024 MB)"
+      << endl
+      << "             -B, --batch <directory> (summarize every activity"
+      << endl
+      << "                under <directory> as CSV, in parallel)" << endl
+      << "             -J, --batch-json <directory> (the same, as JSON,"
+      << endl
+      << "                one line per activity)" << endl
+      << "             -D <meters> (simplify GeoJSON and polyline paths)"
+      << endl
+      << "             -G <file> (write gnuplot data in binary, to <file>;"
+      << endl
+      << "                '-' to include it in the script)" << endl
+      << "             -L (write JSON as levels of detail)" << endl
+      << "             -O <directory> (write a PNG profile of each input"
+      << endl
+      << "                file into <directory>, in parallel; quiet)" << endl
+      << "             -S <meters>[,vw] (simplify, keeping the shape within"
+      << endl
+      << "                <meters>; Douglas-Peucker, or Visvalingam-Whyatt)"
+      << endl
+      << "             -T (time each stage, and print a table of them)"
+      << endl
+      << "             --trace <file> (with -T, also write the stages to"
+      << endl
+      << "                <file> as Chrome trace events)" << endl
+      << "             -W (write KML as a gx:Track, with timestamps)" << endl
+      << endl
+      << "The -i parameter is optional if the filename ends with" << endl
+      << "one of: .gpx, .kml, .fit or .txt" << endl;
+}
+
+
+double Command::altitude(double meters) const {
+  if (metric) {
+    return meters;
+  } else {
+    return meters * 3.2808;
+  }
+}
+
+double Command::distance(double meters) const {
+  if (metric) {
+    return meters / 1000.0;
+  } else {
+    return (meters / 1000.0) * 0.62137;
+  }
+}
+
+void Command::report(Track& track, ostream& out) const {
+  double climb = 0;
+  if (!track.empty()) {
+    climb = track.last().climb;
+  }
+
+  out << "Track:         " << track.getName() << endl;
+  out << "Climb:         " << (int) altitude(climb)
+      << (metric ? " meters" : " feet") << endl;
+  out << "Effort:        " << ((int) track.calculateDifficulty())
+      << endl;
+  out << "Moving time:   " << Util::asTime(track.calculateMovingTime())
+      << endl;
+  out << "Total time:    " << Util::asTime(track.calculateTotalTime())
+      << endl;
+  out << "Distance:      " << distance(track.getTotalDistance())
+      << (metric ? " km" : " miles")
+      << endl;
+
+  const double total_hours = track.calculateTotalTime() / 3600.0;
+  out << "Average speed: " << distance(track.getTotalDistance()) / total_hours
+      << (metric ? " kph" : " mph") << endl;
+  const double moving_hours = track.calculateMovingTime() / 3600.0;
+  out << "Moving speed:  " << distance(track.getTotalDistance()) / moving_hours
+      << (metric ? " kph" : " mph") << endl;
+  out << "Data points: " << track.size() << endl;
+}
+
+void Command::calculatePeaks(Track& track, ostream& out) const {
+  track.calculatePeaks(2000, 50);
+
+  if (!quiet) {
+    for (const Track::Peak& peak : track.getPeaks()) {
+      out << "^ at " << distance(track[peak.index].length)
+          << ", ele " << (int) altitude(track[peak.index].elevation)
+          << ", prom " << (int) altitude(peak.prominence)
+          << ", range " << distance(peak.range) << endl;
+    }
+  }
+}
+
+void Command::calculateClimbs(Track& track, ostream& out) const {
+  track.calculateClimbs(4,     // minimum grade, in percent
+                        0.8,   // ratio of grades for joining climbs
+                        1000,  // significant length in meters
+                        6,     // significant grade, in percent
+                        100,   // significant climb, in meters
+                        600,   // minimum length, in meters
+                        0.35); // maximum distance between climbs, as a ratio
+
+  if (quiet) return;
+
+  const vector<Track::Climb>& climbs(track.getClimbs());
+  for (unsigned i = 0; i < climbs.size(); ++i) {
+    const Track::Climb& climb = climbs[i];
+    out << "Climb " << i + 1 << ". From "
+        << distance(climb.getStart().length) << " to "
+        << distance(climb.getEnd().length) << " ("
+        << distance(climb.getLength())
+        << (metric ? " km" : " miles")
+        << ") grade " << climb.getGrade() << ". From "
+        << altitude(climb.getStart().elevation) << " to "
+        << altitude(climb.getEnd().elevation)
+        << " ("
+        << altitude(climb.getEnd().elevation - climb.getStart().elevation)
+        << (metric ? " meters)" : " feet)")
+        << " - " << (int) climb.getDifficulty() << endl;
+  }
+}
+
+void Command::calculateDifficult(Track& track, ostream& out) const {
+  if (track.empty()) return;
+
+  // Kept for the writers, which show the same stretch
+  track.calculateDifficultyCurve();
+
+  int start = 0;
+  int end = 0;
+  double score = 0;
+  track.mostDifficult(Track::kDifficultMeters, start, end, score);
+
+  if (quiet) return;
+
+  if (start < 0) {
+    out << "Easy ride" << endl;
+  } else {
+    double dist = track[end].length - track[start].length;
+    double ele = track[end].elevation - track[start].elevation;
+
+    out << "Most difficult KM: "
+        << distance(track[start].length)
+        << " to " << distance(track[end].length)
+        << " " << 100.0*(ele / dist) << "%, "
+        << altitude(ele) << (metric ? " m" : " ft")
+        << " of climb (" << score << ")"
+        << endl;
+  }
+}
+
+void Command::processMask(string arg) {
+  for (unsigned i = 0; i < arg.size(); i++) {
+    if (arg[i] == ',') arg[i] = ' ';
+  }
+
+  istringstream in(arg);
+  in >> maskMinLon >> maskMaxLon >> maskMinLat >> maskMaxLat;
+
+  if ((maskMinLon < -180) || (maskMinLon > 180)) {
+    throw Exception("mask min longitude must be between -180 and 180");
+  }
+
+  if ((maskMaxLon < -180) || (maskMaxLon > 180) || (maskMaxLon < maskMinLon)) {
+    throw Exception("mask max longitude must be between -180 and 180, "
+                    "and greater than min");
+  }
+
+  if ((maskMinLat < -90) || (maskMinLat > 90)) {
+    throw Exception("mask min latitude must be between -90 and 90");
+  }
+  if ((maskMaxLat < -90) || (maskMaxLat > 90) || (maskMaxLat < maskMinLat)) {
+    throw Exception("mask min latitude must be between -90 and 90, "
+                    "and greater than min");
+  }
+}
+
+// The value getopt_long returns for --trace, which has no short form
+static const int kTraceOption = 256;
+
+void Command::parse(int argc, char * argv[]) {
+  static const struct option longOptions[] = {
+    { "batch", required_argument, nullptr, 'B' },
+    { "batch-json", required_argument, nullptr, 'J' },
+    { "trace", required_argument, nullptr, kTraceOption },
+    { nullptr, 0, nullptr, 0 }
+  };
+
+  // getopt keeps its state in globals. Starting at 0 makes it start over.
+  static mutex getoptLock;
+  lock_guard<mutex> lock(getoptLock);
+  optind = 0;
+
+  while (true) {
+    const int opt = getopt_long(
+        argc, argv,
+        "a:b:cdef:gh:i:j:k:l:mn:o:pqrs:t:u:vw:x:yzB:C:D:G:J:LO:S:TW",
+        longOptions, nullptr);
+    if (opt == -1) break;
+
+    switch (opt) {
+      case 'a':
+        kmlOptions.opacity = strtol(optarg, 0, 0);
+        if (kmlOptions.opacity > 255) {
+          throw Exception("-a (opacity) must be between 0 and 255");
+        }
+        break;
+
+      case 'b':
+        doMask = true;
+        processMask(optarg);
+        break;
+
+      case 'c':
+        doClimbs = false;
+        break;
+  
+      case 'd':
+        doDifficult = false;
+        break;
+
+      case 'e':
+        kmlOptions.startAndEnd = false;
+        break;
+
+      case 'f':
+        input_filename = optarg;
+        break;
+
+      case 'g':
+        shortest_numbers = true;
+        break;
+
+      case 'h':
+        decaySamples = strtol(optarg, 0, 0);
+        if (decaySamples <= 0) {
+          throw Exception("-h (decay samples) must be positive");
+        }
+        break;
+
+      case 'i':
+        input_format = Parse::stringToFormat(optarg);
+        if (input_format == Parse::FORMAT_PNG) {
+          throw Exception("Unable to read PNG files");
+        } else if (input_format == Parse::FORMAT_JSON) {
+          throw Exception("Unable to read JSON files");
+        } else {
+          if (input_format == Parse::FORMAT_UNKNOWN) {
+            throw Exception(string("Unknown input format '") +
+                            optarg + "'");
+          }
+        }
+        break;    
+
+      case 'j':
+        jsonCallback = optarg;
+        break;
+
+      case 'k':
+        if (sscanf(optarg, "%lf,%lf", &min_elevation, &max_elevation) != 2) {
+          throw Exception("Expecting -k min,max. Example: -k 100,1000");
+        }
+        if (min_elevation > max_elevation) {
+          throw Exception("Minimum elevation must be > maximum");
+        }
+        break;
+
+      case 'l':
+        kmlOptions.color = strtol(optarg, 0, 0);
+        if (kmlOptions.color > 0xffffff) {
+          throw Exception("-l (line color) must be 0 to 0xffffff");
+        }
+        break;
+
+      case 'm':
+        metric = true;
+        break;
+
+      case 'n':
+        average = strtol(optarg, 0, 0);
+        if (average < 0) {
+          throw Exception("-n (average) must be greater than 0");
+        }
+        break;
+
+      case 'o': {
+        const string spec(optarg);
+        const string::size_type colon = spec.find(':');
+
+        Output output;
+        output.format = Parse::stringToFormat(spec.substr(0, colon));
+        if (colon != string::npos) {
+          output.path = spec.substr(colon + 1);
+          if (output.path.empty()) {
+            throw Exception("Missing path in -o " + spec);
+          }
+        }
+
+        if (output.format == Parse::FORMAT_FIT) {
+          throw Exception("Unable to write FIT files");
+        } else if (output.format == Parse::FORMAT_UNKNOWN) {
+          throw Exception(string("Unknown output format '") +
+                          optarg + "'");
+        }
+
+        for (const Output& other : outputs) {
+          if (other.path == output.path) {
+            throw Exception(output.path.empty() ?
+                            string("Only one output may go to stdout") :
+                            "Output written twice to " + output.path);
+          }
+        }
+        outputs.push_back(output);
+        break;
+      }
+
+      case 'p':
+        doPeaks = true;
+        break;
+
+      case 'q':
+        quiet = true;
+        break;
+
+      case 'r':
+        relativeLength = true;
+        break;
+
+      case 's':
+        downsample = strtol(optarg, 0, 0);
+        if (downsample < 1) {
+          throw Exception("-s (downsample) must be greater than 0");
+        }
+        break;
+
+      case 't':
+        gnuplot_terminal = optarg;
+        break;
+
+      case 'u':
+        if (sscanf(optarg, "%d,%d", &image_width, &image_height) != 2) {
+          throw Exception("Expecting -t width,height. Example: -t 800,300");
+        }
+        if (image_width <= 0 || image_height <= 0) {
+          throw Exception("Invalid image dimensions (must be > 0)");
+        }
+        break;
+
+      case 'v':
+        quiet = false;
+        break;
+
+      case 'w':
+        kmlOptions.width = strtod(optarg, 0);
+        break;
+
+      case 'x':
+        resample = strtod(optarg, 0);
+        if (resample <= 0) {
+          throw Exception("-x (resample) must be greater than 0");
+        }
+        break;
+
+      case 'y':
+        remove_burrs = !remove_burrs;
+        break;
+
+      case 'z':
+        show_days = !show_days;
+        break;
+
+      case 'C':
+        parseCache(optarg, cache_dir, cache_limit);
+        break;
+
+      case 'B':
+        batch_dir = optarg;
+        batch_json = false;
+        break;
+
+      case 'J':
+        batch_dir = optarg;
+        batch_json = true;
+        break;
+
+      case 'D':
+        path_tolerance = strtod(optarg, 0);
+        if (path_tolerance <= 0) {
+          throw Exception("-D (tolerance) must be greater than 0");
+        }
+        break;
+
+      case 'G':
+        gnuplot_data = optarg;
+        break;
+
+      case 'L':
+        json_levels = true;
+        break;
+
+      case 'O':
+        thumbnail_dir = optarg;
+        break;
+
+      case 'S': {
+        char* end = nullptr;
+        simplify = strtod(optarg, &end);
+        if (simplify <= 0) {
+          throw Exception("-S (tolerance) must be greater than 0");
+        }
+        if (strcmp(end, ",vw") == 0) {
+          simplifyMethod = Track::VISVALINGAM_WHYATT;
+        } else if (strcmp(end, "") != 0 && strcmp(end, ",dp") != 0) {
+          throw Exception(string("Unknown -S method: ") + end);
+        }
+        break;
+      }
+
+      case 'T':
+        timing = true;
+        break;
+
+      case kTraceOption:
+        trace_file = optarg;
+        break;
+
+      case 'W':
+        kmlOptions.timestamps = true;
+        break;
+
+      default:
+        throw Exception("Unknown option");
+    }
+  }
+
+  if (!trace_file.empty() && !timing) {
+    throw Exception("--trace needs -T");
+  }
+
+  if (!batch_dir.empty()) {
+    if (!outputs.empty() || !thumbnail_dir.empty()) {
+      throw Exception("-B and -J can't be combined with -o or -O");
+    }
+    if (!input_filename.empty() || optind < argc) {
+      throw Exception("-B and -J don't take input files");
+    }
+    quiet = true;
+    return;
+  }
+
+  if (!thumbnail_dir.empty()) {
+    // Any number of input files, and nothing else to write
+    if (!outputs.empty()) {
+      throw Exception("-O can't be combined with -o");
+    }
+    if (!input_filename.empty()) {
+      thumbnail_files.push_back(input_filename);
+    }
+    for ( ; optind < argc; optind++) {
+      thumbnail_files.push_back(argv[optind]);
+    }
+    if (thumbnail_files.empty()) {
+      throw Exception("No input files for -O");
+    }
+    quiet = true;
+    return;
+  }
+
+  for ( ; optind < argc; optind++) {      
+    if (input_filename.empty()) {
+      input_filename = argv[optind];
+    } else {
+      throw Exception(string("Extra parameter detected: ") +
+                      argv[optind]);
+    }
+  }
+}
+
+static string removeSuffix(const string& str) {
+  string::size_type pos = str.find_last_of('.');
+  if ((pos != string::npos) && (pos != 0)) {
+    return str.substr(0,pos);
+  } else {
+    return str;
+  }
+}
+
+void Command::load(const string& filename, Track& track) const {
+  Parse::read(filename, track, input_format);
+
+  if (track.getName().empty()) {
+    track.setName(removeSuffix(Directory::basename(filename)));
+  }
+}
+
+void Command::load(istream& in, const string& filename, Track& track) const {
+  Parse::read(in, track, (input_format != Parse::FORMAT_UNKNOWN) ?
+                         input_format : Parse::fileFormat(filename));
+
+  if (track.getName().empty()) {
+    track.setName(removeSuffix(Directory::basename(filename)));
+  }
+}
+
+// Do one stage of analyze(), timing it with -T, with the points it was
+// given and left
+template <typename Work>
+static void stage(const char* name, const Track& track, Work work) {
+  Profile::Timer timer(name);
+  const size_t before = track.size();
+  work();
+  timer.points(before, track.size());
+}
+
+void Command::analyze(Track& track, ostream& out) const {
+  if (remove_burrs) {
+    stage("RemoveBurrs", track, [&] { track.RemoveBurrs(); });
+  }
+
+  if (relativeLength) {
+    stage("CalculateLength", track, [&] { track.CalculateLength(); });
+  }
+
+  if (decaySamples > 0) {
+    stage("decayElevation", track,
+          [&] { track.decayElevation(decaySamples); });
+  }
+
+  if (average > 0) {
+    stage("ShrinkByAverage", track, [&] { track.ShrinkByAverage(average); });
+  }
+
+  if (resample > 0) {
+    stage("ResampleByDistance", track,
+          [&] { track.ResampleByDistance(resample); });
+  }
+
+  // Do some calculations
+  stage("calculateSegmentGrade", track,
+        [&] { track.calculateSegmentGrade(100); });
+  stage("calculateClimb", track, [&] { track.calculateClimb(10); });
+  stage("calculateVelocity", track, [&] { track.calculateVelocity(10); });
+
+  if (!quiet) stage("report", track, [&] { report(track, out); });
+
+  if (doMask) {
+    stage("Mask", track, [&] {
+      track.Mask(maskMinLon, maskMaxLon, maskMinLat, maskMaxLat);
+    });
+  }
+
+  if (doPeaks) {
+    stage("calculatePeaks", track, [&] { calculatePeaks(track, out); });
+  }
+  if (doClimbs) {
+    stage("calculateClimbs", track, [&] { calculateClimbs(track, out); });
+  }
+  if (doDifficult) {
+    stage("calculateDifficult", track,
+          [&] { calculateDifficult(track, out); });
+  }
+  if (downsample > 0) {
+    stage("ShrinkBySample", track, [&] { track.ShrinkBySample(downsample); });
+  }
+  if (simplify > 0) {
+    stage("Simplify", track,
+          [&] { track.Simplify(simplify, simplifyMethod); });
+  }
+}
+
+PNG::Options Command::pngOptions() const {
+  PNG::Options opt;
+  opt.metric = metric;
+  opt.climbs = doClimbs;
+  opt.difficult = doDifficult;
+  opt.days = show_days;
+  opt.minimum_elevation = min_elevation;
+  opt.maximum_elevation = max_elevation;
+  if (image_width > 0) opt.width = image_width;
+  if (image_height > 0) opt.height = image_height;
+  return opt;
+}
+
+// Write one output. This may run on several threads at once, so it
+// mustn't modify anything shared.
+void Command::writeOutput(const Track& track, Parse::Format format,
+                          ostream& out, PNG::Renderer* renderer) const {
+  if (format == Parse::FORMAT_GNUPLOT) {
+    Gnuplot::Options opt;
+    opt.metric = metric;
+    opt.shortest = shortest_numbers;
+    if (!gnuplot_terminal.empty()) {
+      opt.terminal = gnuplot_terminal;
+    }
+    if (gnuplot_data == "-") {
+      opt.data = Gnuplot::Options::BINARY;
+    } else if (!gnuplot_data.empty()) {
+      opt.data = Gnuplot::Options::BINARY_FILE;
+      opt.dataFile = gnuplot_data;
+    }
+    Gnuplot::write(out, track, opt);
+  } else if (format == Parse::FORMAT_KML) {
+    KML::Options opt = kmlOptions;
+    opt.shortest = shortest_numbers;
+    KML::write(out, track, opt);
+  } else if (format == Parse::FORMAT_GPX) {
+    GPX::Options opt;
+    opt.shortest = shortest_numbers;
+    GPX::write(out, track, opt);
+  } else if (format == Parse::FORMAT_TEXT) {
+    Text::Options opt;
+    opt.shortest = shortest_numbers;
+    Text::write(out, track, opt);
+  } else if (format == Parse::FORMAT_PNG) {
+    if (renderer != nullptr) {
+      renderer->write(out, track, pngOptions());
+    } else {
+      PNG::write(out, track, pngOptions());
+    }
+  } else if (format == Parse::FORMAT_JSON) {
+    JSON::Options opt;
+    opt.callback = jsonCallback;
+    opt.shortest = shortest_numbers;
+    if (json_levels) opt.levels = JSON::defaultLevels();
+    JSON::write(out, track, opt);
+  } else if (format == Parse::FORMAT_GEOJSON) {
+    GeoJSON::Options opt;
+    opt.climbs = doClimbs;
+    opt.tolerance = path_tolerance;
+    opt.shortest = shortest_numbers;
+    GeoJSON::write(out, track, opt);
+  } else if (format == Parse::FORMAT_POLYLINE) {
+    Polyline::Options opt;
+    opt.climbs = doClimbs;
+    opt.tolerance = path_tolerance;
+    Polyline::write(out, track, opt);
+  } else {
+    throw Exception("Unable to write that format");
+  }
+}
+
+// Have 'write' write a track in 'format' to 'out'. With -T, it's timed
+// as a stage, and the bytes it writes counted on the way through.
+static void timedWrite(const Track& track, Parse::Format format,
+                       ostream& out,
+                       const function<void(ostream&)>& write) {
+  Profile::Timer timer("write", Parse::formatToString(format));
+  if (!timer.active()) {
+    write(out);
+    return;
+  }
+
+  Profile::CountingBuffer counter(out.rdbuf());
+  ostream counted(&counter);
+  write(counted);
+  counted.flush();
+  if (!counted) out.setstate(ios::badbit);
+  timer.points(track.size(), Profile::kUnknown);
+  timer.bytes(counter.count());
+}
+
+// Write every output requested with -o to the corresponding stream. The
+// first is written on this thread, and the rest concurrently on their own
+// threads, since the track won't change any more.
+void Command::writeOutputs(const Track& track, const vector<ostream*>& out,
+                           PNG::Renderer* renderer) const {
+  PRECONDITION(out.size() == outputs.size());
+
+  Profile* const profile = Profile::current();
+  vector<exception_ptr> errors(outputs.size());
+  auto write = [&](unsigned i) {
+    Profile::Use use(profile);
+    try {
+      timedWrite(track, outputs[i].format, *out[i], [&](ostream& stream) {
+        writeOutput(track, outputs[i].format, stream,
+                    (i == 0) ? renderer : nullptr);
+      });
+      out[i]->flush();
+      if (!*out[i]) {
+        throw Exception("Error writing " +
+                        (outputs[i].path.empty() ? "stdout" : outputs[i].path));
+      }
+    } catch (...) {
+      errors[i] = current_exception();
+    }
+  };
+
+  vector<thread> threads;
+  for (unsigned i = 1; i < outputs.size(); ++i) {
+    threads.push_back(thread(write, i));
+  }
+  write(0);
+  for (thread& t : threads) {
+    t.join();
+  }
+
+  for (const exception_ptr& error : errors) {
+    if (error) rethrow_exception(error);
+  }
+}
+
+// Open the file for each output, setting 'out' to it, or to stdout. The
+// files are all opened first, so a bad path fails before anything is
+// written.
+void Command::openOutputs(vector<unique_ptr<ofstream>>& files,
+                          vector<ostream*>& out) const {
+  files.resize(outputs.size());
+  out.assign(outputs.size(), &cout);
+  for (unsigned i = 0; i < outputs.size(); ++i) {
+    if (outputs[i].path.empty()) continue;
+
+    files[i].reset(new ofstream(outputs[i].path.c_str(),
+                                ios::out | ios::binary | ios::trunc));
+    if (!*files[i]) {
+      throw SystemException(errno, "Unable to open " + outputs[i].path);
+    }
+    out[i] = files[i].get();
+  }
+}
+
+void Command::writeOutputs(const Track& track) const {
+  vector<unique_ptr<ofstream>> files;
+  vector<ostream*> out;
+  openOutputs(files, out);
+  writeOutputs(track, out, nullptr);
+}
+
+// Run 'work' on one thread per core, but no more threads than 'tasks'.
+// Each call should take tasks from a shared counter until none are left.
+// Stages are timed on every thread, if they are on this one.
+static void runWorkers(size_t tasks, const function<void()>& work) {
+  const unsigned count =
+      std::min<size_t>(max(1u, thread::hardware_concurrency()), tasks);
+  Profile* const profile = Profile::current();
+  vector<thread> threads;
+  for (unsigned i = 1; i < count; ++i) {
+    threads.push_back(thread([&] {
+      Profile::Use use(profile);
+      work();
+    }));
+  }
+  work();
+  for (thread& t : threads) {
+    t.join();
+  }
+}
+
+// Write a PNG profile of each of the thumbnail files, with one thread per
+// core. Each thread keeps a Renderer, so the canvas and label sizes are
+// reused from one image to the next. A file that fails is reported and
+// skipped. Returns the number of failures.
+unsigned Command::writeThumbnails() const {
+  const PNG::Options opt = pngOptions();
+
+  atomic<unsigned> next(0);
+  atomic<unsigned> failures(0);
+  mutex errorLock;
+
+  auto work = [&] {
+    PNG::Renderer renderer;
+    for (unsigned i = next++; i < thumbnail_files.size(); i = next++) {
+      const string& filename = thumbnail_files[i];
+      try {
+        Track track;
+        load(filename, track);
+        analyze(track, log);
+
+        const string path = Directory::createPath(
+            thumbnail_dir, removeSuffix(Directory::basename(filename)) + ".png");
+        ofstream out(path.c_str(), ios::out | ios::binary | ios::trunc);
+        if (!out) {
+          throw SystemException(errno, "Unable to open " + path);
+        }
+        timedWrite(track, Parse::FORMAT_PNG, out, [&](ostream& stream) {
+          renderer.write(stream, track, opt);
+        });
+        out.flush();
+        if (!out) {
+          throw Exception("Error writing " + path);
+        }
+      } catch (const std::exception& e) {
+        lock_guard<mutex> lock(errorLock);
+        log << filename << ": " << e.what() << endl;
+        ++failures;
+      }
+    }
+  };
+
+  runWorkers(thumbnail_files.size(), work);
+  return failures;
+}
+
+// A file found by findActivities, or a directory that couldn't be read
+struct Activity {
+  string path;
+  string error;
+};
+
+// Add every file under 'dir' with a recognized suffix, recursively, in
+// name order.
+static void findActivities(const string& dir, vector<Activity>& found) {
+  vector<string> files;
+  vector<string> subdirs;
+  try {
+    Directory d(dir.c_str());
+    while (d.next()) {
+      const string path = Directory::createPath(dir, d.getFilename());
+      if (d.isDirectory()) {
+        subdirs.push_back(path);
+      } else if (Parse::fileFormat(path) != Parse::FORMAT_UNKNOWN) {
+        files.push_back(path);
+      }
+    }
+  } catch (const std::exception& e) {
+    Activity failed;
+    failed.path = dir;
+    failed.error = e.what();
+    found.push_back(failed);
+    return;
+  }
+
+  sort(files.begin(), files.end());
+  sort(subdirs.begin(), subdirs.end());
+  for (const string& file : files) {
+    Activity activity;
+    activity.path = file;
+    found.push_back(activity);
+  }
+  for (const string& subdir : subdirs) {
+    findActivities(subdir, found);
+  }
+}
+
+static const char* const BATCH_FIELDS[] = {
+  "file", "name", "error", "climb", "effort", "moving_time", "total_time",
+  "distance", "average_speed", "moving_speed", "points", "climbs",
+  "climb_distance", "climb_elevation", "difficult_start", "difficult_end",
+  "difficult_grade", "difficult_climb", "difficult_score"
+};
+static const unsigned BATCH_FIELD_COUNT =
+    sizeof(BATCH_FIELDS) / sizeof(BATCH_FIELDS[0]);
+
+static string number(double value) {
+  if (!std::isfinite(value)) return "";
+
+  ostringstream out;
+  out << value;
+  return out.str();
+}
+
+// The values of BATCH_FIELDS for one activity, in the units of report().
+// Values that don't apply are empty.
+vector<string> Command::summarize(const string& filename) const {
+  vector<string> values(BATCH_FIELD_COUNT);
+  values[0] = filename;
+
+  Track track;
+  try {
+    load(filename, track);
+    analyze(track, log);
+  } catch (const std::exception& e) {
+    values[1] = track.getName();
+    values[2] = e.what();
+    return values;
+  }
+
+  const double total = track.calculateTotalTime();
+  const double moving = track.calculateMovingTime();
+  const double length = track.getTotalDistance();
+
+  values[1] = track.getName();
+  values[3] = to_string((int) altitude(track.empty() ? 0 : track.last().climb));
+  values[4] = to_string((long long) track.calculateDifficulty());
+  values[5] = number(moving);
+  values[6] = number(total);
+  values[7] = number(distance(length));
+  values[8] = number(distance(length) / (total / 3600.0));
+  values[9] = number(distance(length) / (moving / 3600.0));
+  values[10] = to_string(track.size());
+
+  if (doClimbs) {
+    double climbLength = 0;
+    double climbElevation = 0;
+    for (const Track::Climb& climb : track.getClimbs()) {
+      climbLength += climb.getLength();
+      climbElevation += climb.getClimb();
+    }
+    values[11] = to_string(track.getClimbs().size());
+    values[12] = number(distance(climbLength));
+    values[13] = number(altitude(climbElevation));
+  }
+
+  int start = -1;
+  int end = -1;
+  double score = 0;
+  if (doDifficult && !track.empty()) {
+    track.mostDifficult(Track::kDifficultMeters, start, end, score);
+  }
+  if (start >= 0) {
+    const double dist = track[end].length - track[start].length;
+    const double ele = track[end].elevation - track[start].elevation;
+    values[14] = number(distance(track[start].length));
+    values[15] = number(distance(track[end].length));
+    values[16] = number(100.0 * (ele / dist));
+    values[17] = number(altitude(ele));
+    values[18] = number(score);
+  }
+
+  return values;
+}
+
+static string csvField(const string& value) {
+  if (value.find_first_of(",\"\r\n") == string::npos) return value;
+
+  string quoted = "\"";
+  for (char c : value) {
+    if (c == '"') quoted += '"';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+static string jsonString(const string& value) {
+  string quoted = "\"";
+  for (unsigned char c : value) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if (c < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      quoted += escape;
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+
+// Format one activity as a CSV row, or a line of JSON. In JSON, the
+// numbers are unquoted and the empty values are left out.
+string Command::batchRow(const vector<string>& values) const {
+  string row;
+  for (unsigned i = 0; i < values.size(); ++i) {
+    if (batch_json) {
+      if (values[i].empty()) continue;
+      row += row.empty() ? "{" : ",";
+      row += jsonString(BATCH_FIELDS[i]) + ":";
+      row += (i < 3) ? jsonString(values[i]) : values[i];
+    } else {
+      if (i > 0) row += ",";
+      row += csvField(values[i]);
+    }
+  }
+  return row + (batch_json ? "}\n" : "\n");
+}
+
+// Summarize every activity under batch_dir to stdout, one row each, in
+// the order they were found. The files are read and analyzed with one
+// thread per core, and each row is written as soon as the ones before it
+// are. A file that fails has its error in the row. Returns the number of
+// failures.
+unsigned Command::writeBatch() const {
+  vector<Activity> activities;
+  findActivities(batch_dir, activities);
+
+  if (!batch_json) {
+    for (unsigned i = 0; i < BATCH_FIELD_COUNT; ++i) {
+      cout << (i > 0 ? "," : "") << BATCH_FIELDS[i];
+    }
+    cout << "\n";
+  }
+
+  vector<string> rows(activities.size());
+  vector<bool> done(activities.size(), false);
+  size_t written = 0;
+  atomic<unsigned> next(0);
+  atomic<unsigned> failures(0);
+  mutex outputLock;
+
+  auto work = [&] {
+    for (unsigned i = next++; i < activities.size(); i = next++) {
+      vector<string> values;
+      if (activities[i].error.empty()) {
+        values = summarize(activities[i].path);
+      } else {
+        values.resize(BATCH_FIELD_COUNT);
+        values[0] = activities[i].path;
+        values[2] = activities[i].error;
+      }
+      if (!values[2].empty()) ++failures;
+      string row = batchRow(values);
+
+      lock_guard<mutex> lock(outputLock);
+      rows[i].swap(row);
+      done[i] = true;
+      for ( ; written < rows.size() && done[written]; ++written) {
+        cout << rows[written];
+        string().swap(rows[written]);
+      }
+    }
+  };
+
+  runWorkers(activities.size(), work);
+  cout.flush();
+  return failures;
+}
+
+int Command::timed(const function<int()>& work) const {
+  if (!timing || Profile::current() != nullptr) return work();
+
+  Profile profile;
+  int status;
+  {
+    Profile::Use use(&profile);
+    status = work();
+  }
+
+  profile.writeTable(log);
+  if (!trace_file.empty()) {
+    ofstream trace(trace_file.c_str(), ios::out | ios::trunc);
+    profile.writeTrace(trace);
+    trace.close();
+    if (!trace) throw SystemException(errno, "Unable to write " + trace_file);
+  }
+  return status;
+}
+
+int Command::run() const {
+  return timed([&] { return execute(); });
+}
+
+void Command::run(istream& in, const vector<ostream*>& out,
+                  PNG::Renderer* renderer) const {
+  timed([&] {
+    execute(in, out, renderer);
+    return 0;
+  });
+}
+
+int Command::execute() const {
+  if (!thumbnail_dir.empty()) {
+    return (writeThumbnails() == 0) ? 0 : 1;
+  }
+  if (!batch_dir.empty()) {
+    return (writeBatch() == 0) ? 0 : 1;
+  }
+
+  if (!cache_dir.empty() && isOneTrack()) {
+    ifstream file;
+    if (!input_filename.empty() && input_filename != "-") {
+      file.open(input_filename.c_str(), ios_base::in | ios_base::binary);
+      if (!file.is_open()) {
+        throw Exception("Could not open " + input_filename);
+      }
+    }
+
+    vector<unique_ptr<ofstream>> files;
+    vector<ostream*> out;
+    openOutputs(files, out);
+    execute(file.is_open() ? file : cin, out, nullptr);
+    return 0;
+  }
+
+  // Read it
+  Track track;
+  load(input_filename, track);
+  analyze(track, log);
+
+  // Write the results, if desired
+  if (outputs.empty()) {
+    log << "Nothing to write" << endl;
+  } else {
+    writeOutputs(track);
+  }
+
+  return 0;
+}
+
+void Command::execute(istream& in, const vector<ostream*>& out,
+                      PNG::Renderer* renderer) const {
+  PRECONDITION(isOneTrack());
+  PRECONDITION(out.size() == outputs.size());
+
+  if (cache_dir.empty()) {
+    Track track;
+    load(in, input_filename, track);
+    process(track, log, out, renderer);
+    return;
+  }
+
+  const string input((istreambuf_iterator<char>(in)),
+                     istreambuf_iterator<char>());
+  ResultCache cache(cache_dir, cache_limit);
+  const string key = ResultCache::key(input, describe());
+
+  ResultCache::Entry entry;
+  bool found;
+  {
+    Profile::Timer timer("cache", "find");
+    found = cache.find(key, entry) && entry.outputs.size() == outputs.size();
+  }
+  if (!found) {
+    // Do the work, keeping everything it writes
+    ostringstream messages;
+    vector<unique_ptr<ostringstream>> results;
+    vector<ostream*> streams;
+    for (unsigned i = 0; i < outputs.size(); ++i) {
+      results.push_back(unique_ptr<ostringstream>(new ostringstream));
+      streams.push_back(results.back().get());
+    }
+
+    Track track;
+    istringstream data(input);
+    load(data, input_filename, track);
+    process(track, messages, streams, renderer);
+
+    entry.messages = messages.str();
+    entry.outputs.clear();
+    for (const unique_ptr<ostringstream>& result : results) {
+      entry.outputs.push_back(result->str());
+    }
+
+    try {
+      Profile::Timer timer("cache", "store");
+      cache.store(key, entry);
+    } catch (const std::exception&) {
+      // A cache that can't be written (a full disk, say) only makes the
+      // next request slower
+    }
+  }
+
+  log << entry.messages;
+  for (unsigned i = 0; i < outputs.size(); ++i) {
+    out[i]->write(entry.outputs[i].data(), entry.outputs[i].size());
+    out[i]->flush();
+    if (!*out[i]) {
+      throw Exception("Error writing " +
+                      (outputs[i].path.empty() ? "stdout" : outputs[i].path));
+    }
+  }
+}
+
+void Command::process(Track& track, ostream& messages,
+                      const vector<ostream*>& out,
+                      PNG::Renderer* renderer) const {
+  analyze(track, messages);
+
+  if (outputs.empty()) {
+    messages << "Nothing to write" << endl;
+  } else {
+    writeOutputs(track, out, renderer);
+  }
+}
+
+string Command::describe() const {
+  // Change this whenever the same options could give different results,
+  // so a cache doesn't return results from an earlier version.
+  static const char* const kVersion = "track-results-1";
+
+  const Parse::Format format = (input_format != Parse::FORMAT_UNKNOWN) ?
+                               input_format : Parse::fileFormat(input_filename);
+
+  ostringstream out;
+  out.precision(17);
+  out << kVersion << "\n"
+      << "input " << format << " "
+      << removeSuffix(Directory::basename(input_filename)) << "\n"
+      << "outputs";
+  for (const Output& output : outputs) {
+    out << " " << output.format;
+  }
+  out << "\n"
+      << "analysis " << doClimbs << doPeaks << doDifficult << remove_burrs
+      << relativeLength << " " << downsample << " " << average << " "
+      << resample << " " << simplify << " " << simplifyMethod << " "
+      << decaySamples << "\n"
+      << "mask " << doMask << " " << maskMinLat << " " << maskMinLon << " "
+      << maskMaxLat << " " << maskMaxLon << "\n"
+      << "report " << quiet << metric << "\n"
+      << "numbers " << shortest_numbers << " " << path_tolerance << "\n"
+      << "png " << show_days << " " << min_elevation << " " << max_elevation
+      << " " << image_width << " " << image_height << "\n"
+      << "gnuplot " << gnuplot_terminal << "\n" << gnuplot_data << "\n"
+      << "json " << json_levels << " " << jsonCallback << "\n"
+      << "kml " << kmlOptions.startAndEnd << kmlOptions.timestamps << " "
+      << kmlOptions.width << " " << kmlOptions.color << " "
+      << kmlOptions.opacity << "\n";
+  return out.str();
+}
+
+void Command::read(const string& filename, Track& track) const {
+  load(filename, track);
+  analyze(track, log);
+}
+
+void Command::setCache(const string& directory, uint64_t limit) {
+  PRECONDITION(!directory.empty());
+  PRECONDITION(limit > 0);
+  cache_dir = directory;
+  cache_limit = limit;
+}
+
+void Command::parseCache(const string& arg, string& directory,
+                         uint64_t& limit) {
+  // A trailing ",<megabytes>" is the limit, otherwise it's all the
+  // directory
+  directory = arg;
+  const string::size_type comma = directory.rfind(',');
+  if (comma != string::npos) {
+    char* end = nullptr;
+    const double megabytes = strtod(directory.c_str() + comma + 1, &end);
+    if (end != directory.c_str() + comma + 1 && *end == 0) {
+      if (megabytes <= 0) {
+        throw Exception("-C (cache limit) must be greater than 0");
+      }
+      limit = megabytes * 1024 * 1024;
+      directory.erase(comma);
+    }
+  }
+  if (directory.empty()) {
+    throw Exception("-C needs a cache directory");
+  }
+}
+
+bool Command::isSingleTrack() const {
+  // A trace or a cache would be written where this runs, which mightn't
+  // be here
+  return isOneTrack() && trace_file.empty() && cache_dir.empty();
+}
+
+bool Command::isOneTrack() const {
+  // A gnuplot data file is written besides the outputs
+  return thumbnail_dir.empty() && batch_dir.empty() &&
+         (gnuplot_data.empty() || gnuplot_data == "-");
+}
@@ -0,0 +1,202 @@
+#if !defined COMMAND_H
+#define      COMMAND_H
+
+#include <stdint.h>
+
+#include <cfloat>
+#include <fstream>
+#include <functional>
+#include <iosfwd>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kml.h"
+#include "parse.h"
+#include "png.h"
+#include "track.h"
+#include "util.h"
+
+// The 'track' command: its options, and reading, analyzing and writing
+// tracks with them. Nothing is shared between Commands, so several may
+// run at once on different threads (as in trackd).
+class Command : public NoCopy {
+ public:
+  // The most the -C cache holds, unless it says otherwise
+  static const uint64_t kDefaultCacheLimit = 1024 * 1024 * 1024;
+
+  // Each -o option: a format, and a path (empty for stdout)
+  struct Output {
+    Parse::Format format;
+    std::string path;
+  };
+
+  // Messages (the report, climbs, and so on) are written to 'messages'
+  explicit Command(std::ostream& messages = std::cerr) : log(messages) {}
+
+  // Describe the options
+  static void usage(std::ostream& out);
+
+  // Set the options from the command line. Throws an Exception for
+  // anything invalid. This may be called from any thread.
+  void parse(int argc, char* argv[]);
+
+  // Do whatever the command line asked, returning the exit status. With
+  // -T, a table of the time each stage took follows the messages.
+  int run() const;
+
+  // Read the track from 'in', rather than the input file (whose name is
+  // still used for the format and the track's name), analyze it, and
+  // write each of the outputs to the corresponding stream in 'out'. A
+  // renderer, if given, is used for a PNG written on this thread.
+  //
+  // With -C, the results come from the cache if the same input has been
+  // seen with the same options, and the track isn't read at all.
+  void run(std::istream& in, const std::vector<std::ostream*>& out,
+           PNG::Renderer* renderer = nullptr) const;
+
+  // Read the track in 'filename' and analyze it, as the options say
+  void read(const std::string& filename, Track& track) const;
+
+  // Whether this is a single track that run(in, out) can process: not
+  // a batch or thumbnails, and nothing written besides the outputs, not
+  // even a trace or a cache, so another process, like trackd, could run
+  // it.
+  bool isSingleTrack() const;
+
+  // Keep the results in 'directory', up to 'limit' bytes, as -C does.
+  // For trackd, which has its own cache.
+  void setCache(const std::string& directory, uint64_t limit);
+
+  // Split a -C argument, "<directory>[,<megabytes>]", into the directory
+  // and the limit in bytes, which is left alone if not given. Throws an
+  // Exception for anything invalid.
+  static void parseCache(const std::string& arg, std::string& directory,
+                         uint64_t& limit);
+
+  const std::string& getInputFilename() const { return input_filename; }
+  const std::vector<Output>& getOutputs() const { return outputs; }
+
+ private:
+  double altitude(double meters) const;
+  double distance(double meters) const;
+
+  // These write any messages to 'out'
+  void report(Track& track, std::ostream& out) const;
+  void calculatePeaks(Track& track, std::ostream& out) const;
+  void calculateClimbs(Track& track, std::ostream& out) const;
+  void calculateDifficult(Track& track, std::ostream& out) const;
+
+  void processMask(std::string arg);
+
+  // Read a track, naming it after the file if it doesn't have a name
+  void load(const std::string& filename, Track& track) const;
+  void load(std::istream& in, const std::string& filename,
+            Track& track) const;
+
+  // Apply the adjustments and calculations from the command line
+  void analyze(Track& track, std::ostream& out) const;
+
+  PNG::Options pngOptions() const;
+
+  void writeOutput(const Track& track, Parse::Format format,
+                   std::ostream& out, PNG::Renderer* renderer) const;
+  void writeOutputs(const Track& track,
+                    const std::vector<std::ostream*>& out,
+                    PNG::Renderer* renderer) const;
+  void writeOutputs(const Track& track) const;
+  void openOutputs(std::vector<std::unique_ptr<std::ofstream>>& files,
+                   std::vector<std::ostream*>& out) const;
+
+  // Analyze the track, then write the outputs
+  void process(Track& track, std::ostream& messages,
+               const std::vector<std::ostream*>& out,
+               PNG::Renderer* renderer) const;
+
+  // Run 'work' and return its status, timing its stages with -T (unless
+  // they're already being timed), and writing the table of them to the
+  // messages, and the trace to --trace.
+  int timed(const std::function<int()>& work) const;
+
+  // Whether execute(in, out) can process this: isSingleTrack(), except
+  // that timed() may write a trace around it
+  bool isOneTrack() const;
+
+  // run() and run(in, out), untimed
+  int execute() const;
+  void execute(std::istream& in, const std::vector<std::ostream*>& out,
+               PNG::Renderer* renderer) const;
+
+  // Everything besides the input that could change the results of
+  // run(in, out), for the cache key. Every new option must be added.
+  // -T only adds messages after the results, so it isn't.
+  std::string describe() const;
+
+  unsigned writeThumbnails() const;
+
+  std::vector<std::string> summarize(const std::string& filename) const;
+  std::string batchRow(const std::vector<std::string>& values) const;
+  unsigned writeBatch() const;
+
+  std::ostream& log;
+
+  std::string input_filename;
+  Parse::Format input_format = Parse::FORMAT_UNKNOWN;
+
+  std::vector<Output> outputs;
+
+  // With -O, a PNG is written to this directory for each of the input files
+  std::string thumbnail_dir;
+  std::vector<std::string> thumbnail_files;
+
+  // With -B or -J, every activity under this directory is summarized
+  std::string batch_dir;
+  bool batch_json = false;
+
+  // With -C, results are kept in this directory
+  std::string cache_dir;
+  uint64_t cache_limit = kDefaultCacheLimit;
+
+  bool doClimbs     = true;
+  bool doPeaks      = false;
+  bool doDifficult  = true;
+  int  downsample   = 0;
+  bool quiet        = false;
+  bool metric       = false;
+  bool show_days    = false;
+  int  average      = 0;
+  double resample   = 0;
+  double simplify   = 0;
+  Track::SimplifyMethod simplifyMethod = Track::DOUGLAS_PEUCKER;
+  std::string jsonCallback;
+  bool json_levels = false;
+  double path_tolerance = 0;
+  bool remove_burrs  = true;
+  bool relativeLength = false;
+  int decaySamples  = 0;
+  bool shortest_numbers = false;
+
+  // With -T, the stages are timed, and also written as a trace to this
+  // file if it isn't empty
+  bool timing = false;
+  std::string trace_file;
+
+  bool doMask       = false;
+  double maskMinLat = 0;
+  double maskMinLon = 0;
+  double maskMaxLat = 0;
+  double maskMaxLon = 0;
+
+  double min_elevation = DBL_MAX;
+  double max_elevation = DBL_MIN;
+
+  int image_width = 0;
+  int image_height = 0;
+  std::string gnuplot_terminal;
+  std::string gnuplot_data;
+
+  KML::Options kmlOptions;
+};
+
+#endif
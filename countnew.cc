@@ -0,0 +1,55 @@
+// Replaces the global operator new and delete with ones that count each
+// allocation (see allocations.h). Only linked into a build that asks for
+// it, since every allocation pays for the count.
+
+#include "allocations.h"
+
+#include <stdlib.h>
+
+#include <new>
+
+namespace {
+
+void* allocate(size_t size) {
+  Allocations::add(size);
+  while (true) {
+    void* memory = malloc(size == 0 ? 1 : size);
+    if (memory != nullptr) return memory;
+
+    std::new_handler handler = std::get_new_handler();
+    if (handler == nullptr) throw std::bad_alloc();
+    handler();
+  }
+}
+
+void* allocate(size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return allocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+const bool enabled = (Allocations::enable(), true);
+
+}  // namespace
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+
+void* operator new(size_t size, const std::nothrow_t& tag) noexcept {
+  return allocate(size, tag);
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+  return allocate(size, tag);
+}
+
+void operator delete(void* memory) noexcept { free(memory); }
+void operator delete[](void* memory) noexcept { free(memory); }
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+  free(memory);
+}
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+  free(memory);
+}
@@ -4,6 +4,7 @@
 #include <string>
 
 #include <errno.h>
+#include <sys/stat.h>
 
 using namespace std;
 
@@ -11,12 +12,17 @@ Directory::Directory(const char* dirname, const bool skipDots)
     : skip(skipDots) {
   PRECONDITION(dirname != 0);
 
+  path = dirname;
   directory = ::opendir(dirname);
   if (directory == 0) {
-    throw SystemException(errno, "Opening directory");
+    throw SystemException(errno, "Opening directory " + path);
   }
 }
 
+Directory::~Directory() {
+  ::closedir(directory);
+}
+
 bool Directory::next() {
   while (true) {
     entry = readdir(directory);
@@ -30,6 +36,21 @@ bool Directory::next() {
   }
 }
 
+bool Directory::isDirectory() const {
+  PRECONDITION(entry != nullptr);
+
+  if (entry->d_type != DT_UNKNOWN) {
+    return entry->d_type == DT_DIR;
+  }
+
+  // Not every filesystem fills in d_type
+  struct stat info;
+  if (::lstat(createPath(path, name).c_str(), &info) != 0) {
+    return false;
+  }
+  return S_ISDIR(info.st_mode);
+}
+
 std::string Directory::createPath(const std::string& path,
                                   const std::string& filename) {
   if (!path.empty() && (path[path.size()-1] != '/')) {
@@ -4,10 +4,12 @@
 #include <dirent.h>
 #include <string>
 
+#include "util.h"
 
-class Directory {
+class Directory : public NoCopy {
 public:
   Directory(const char* dir, bool skipDots = true);
+  ~Directory();
 
   bool next();
 
@@ -15,12 +17,17 @@ public:
   // valid after a successful call to next().
   const std::string& getFilename() const { return name; }
 
+  // Whether the current entry is a directory. Symbolic links aren't
+  // followed, so a link to a directory is not.
+  bool isDirectory() const;
+
   static std::string createPath(const std::string& directory,
                                 const std::string& filename);
 
   static std::string basename(const std::string& path);
 
 private:
+  std::string path;
   DIR* directory;
   dirent* entry;
 
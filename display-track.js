@@ -30,6 +30,26 @@
   expressed as indexes. The score is an arbitrary number, but scores <= 0
   mean there was no climb detected.
 
+  With 'track -L', the output instead holds several levels of detail,
+  each a subset of the points chosen to keep the shape of the profile:
+
+  {
+    "scale": { "length": 1, "elevation": 10 },
+    "levels": [
+    { "size": 3,
+      "length": [13523,64487,43461],
+      "elevation": [2019,-383,1373],
+      "climbs": [{ "start": 1, "end": 2 }],
+      "difficult": { "start": 2, "end": 2, "score": 47.8583 } },
+    ...]
+  }
+
+  "length" and "elevation" are integers, each the difference from the
+  previous value (the first is the value itself), and divided by the
+  "scale" they give meters. Indexes in "climbs" and "difficult" refer to
+  the points in that level. Levels are in increasing size, and the
+  smallest with at least as many points as the canvas is wide is used.
+
   html-example.html shows how to use this.
 */
 
@@ -463,8 +483,39 @@ function loadTrackDataGPX(canvasId, url, metric) {
 
 // JSON methods
 
+// Choose the level of detail for a canvas of the given width, and decode
+// it into the same form as the plain JSON output.
+function decodeLevel(data, width) {
+    var level = data.levels[data.levels.length - 1];
+    for (var i = 0; i < data.levels.length; i++) {
+        if (data.levels[i].size >= width) {
+            level = data.levels[i];
+            break;
+        }
+    }
+
+    var points = new Array();
+    var length = 0;
+    var elevation = 0;
+    for (var i = 0; i < level.length.length; i++) {
+        length += level.length[i];
+        elevation += level.elevation[i];
+        points.push([ length / data.scale.length,
+                      elevation / data.scale.elevation ]);
+    }
+
+    return { points: points,
+             climbs: level.climbs,
+             difficult: level.difficult };
+}
+
 function displayTrackDataJSON(canvasId, points, metric) {
 
+    if (points.levels) {
+        var canvas = document.getElementById(canvasId);
+        points = decodeLevel(points, canvas.width);
+    }
+
     var track = new TrackData(points.points,
                               points.climbs,
                               points.difficult,
@@ -0,0 +1,475 @@
+#include "dtoa.h"
+
+#include "exception.h"
+
+#include <limits>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace std;
+
+namespace {
+
+// Shortest representation: Grisu2, after Florian Loitsch, "Printing
+// Floating-Point Numbers Quickly and Accurately with Integers" (2010).
+// The output always reads back as the same double, and is almost always
+// the shortest such text.
+
+// A floating point number f * 2^e, with a 64-bit significand.
+struct DiyFp {
+  DiyFp(uint64_t fIn, int eIn) : f(fIn), e(eIn) {}
+
+  uint64_t f;
+  int e;
+};
+
+// x - y, where both have the same exponent and x >= y.
+DiyFp subtract(const DiyFp& x, const DiyFp& y) {
+  return DiyFp(x.f - y.f, x.e);
+}
+
+// x * y, rounded to 64 bits.
+DiyFp multiply(const DiyFp& x, const DiyFp& y) {
+  const unsigned __int128 p = static_cast<unsigned __int128>(x.f) * y.f;
+  const uint64_t h = static_cast<uint64_t>(p >> 64);
+  const uint64_t round = static_cast<uint64_t>(p >> 63) & 1;
+  return DiyFp(h + round, x.e + y.e + 64);
+}
+
+DiyFp normalize(DiyFp x) {
+  while ((x.f >> 63) == 0) {
+    x.f <<= 1;
+    x.e--;
+  }
+  return x;
+}
+
+DiyFp normalizeTo(const DiyFp& x, int e) {
+  return DiyFp(x.f << (x.e - e), e);
+}
+
+// The value 'w' of a double, and the boundaries 'minus' and 'plus' of
+// the interval of reals that round to it, normalized to the same exponent.
+struct Boundaries {
+  Boundaries(DiyFp wIn, DiyFp minusIn, DiyFp plusIn)
+      : w(wIn), minus(minusIn), plus(plusIn) {}
+
+  DiyFp w;
+  DiyFp minus;
+  DiyFp plus;
+};
+
+Boundaries computeBoundaries(double value) {
+  const int kBias = 1023 + 52;
+  const uint64_t kHiddenBit = 1ULL << 52;
+
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint64_t exponent = (bits >> 52) & 0x7ff;
+  const uint64_t fraction = bits & (kHiddenBit - 1);
+
+  const DiyFp v = (exponent == 0)
+      ? DiyFp(fraction, 1 - kBias)
+      : DiyFp(fraction + kHiddenBit, static_cast<int>(exponent) - kBias);
+
+  // The lower boundary is closer if the fraction is zero, since the
+  // next lower double has a smaller exponent.
+  const bool lowerCloser = (fraction == 0 && exponent > 1);
+  const DiyFp plus(2 * v.f + 1, v.e - 1);
+  const DiyFp minus = lowerCloser ? DiyFp(4 * v.f - 1, v.e - 2)
+                                  : DiyFp(2 * v.f - 1, v.e - 1);
+
+  const DiyFp normalPlus = normalize(plus);
+  return Boundaries(normalize(v), normalizeTo(minus, normalPlus.e),
+                    normalPlus);
+}
+
+// Normalized powers of ten, 10^k ~= f * 2^e, for every 8th k from -300
+// to 324, rounded to nearest.
+struct CachedPower {
+  uint64_t f;
+  int e;
+  int k;
+};
+
+const CachedPower kCachedPowers[] = {
+  { 0xAB70FE17C79AC6CA, -1060, -300 },
+  { 0xFF77B1FCBEBCDC4F, -1034, -292 },
+  { 0xBE5691EF416BD60C, -1007, -284 },
+  { 0x8DD01FAD907FFC3C,  -980, -276 },
+  { 0xD3515C2831559A83,  -954, -268 },
+  { 0x9D71AC8FADA6C9B5,  -927, -260 },
+  { 0xEA9C227723EE8BCB,  -901, -252 },
+  { 0xAECC49914078536D,  -874, -244 },
+  { 0x823C12795DB6CE57,  -847, -236 },
+  { 0xC21094364DFB5637,  -821, -228 },
+  { 0x9096EA6F3848984F,  -794, -220 },
+  { 0xD77485CB25823AC7,  -768, -212 },
+  { 0xA086CFCD97BF97F4,  -741, -204 },
+  { 0xEF340A98172AACE5,  -715, -196 },
+  { 0xB23867FB2A35B28E,  -688, -188 },
+  { 0x84C8D4DFD2C63F3B,  -661, -180 },
+  { 0xC5DD44271AD3CDBA,  -635, -172 },
+  { 0x936B9FCEBB25C996,  -608, -164 },
+  { 0xDBAC6C247D62A584,  -582, -156 },
+  { 0xA3AB66580D5FDAF6,  -555, -148 },
+  { 0xF3E2F893DEC3F126,  -529, -140 },
+  { 0xB5B5ADA8AAFF80B8,  -502, -132 },
+  { 0x87625F056C7C4A8B,  -475, -124 },
+  { 0xC9BCFF6034C13053,  -449, -116 },
+  { 0x964E858C91BA2655,  -422, -108 },
+  { 0xDFF9772470297EBD,  -396, -100 },
+  { 0xA6DFBD9FB8E5B88F,  -369,  -92 },
+  { 0xF8A95FCF88747D94,  -343,  -84 },
+  { 0xB94470938FA89BCF,  -316,  -76 },
+  { 0x8A08F0F8BF0F156B,  -289,  -68 },
+  { 0xCDB02555653131B6,  -263,  -60 },
+  { 0x993FE2C6D07B7FAC,  -236,  -52 },
+  { 0xE45C10C42A2B3B06,  -210,  -44 },
+  { 0xAA242499697392D3,  -183,  -36 },
+  { 0xFD87B5F28300CA0E,  -157,  -28 },
+  { 0xBCE5086492111AEB,  -130,  -20 },
+  { 0x8CBCCC096F5088CC,  -103,  -12 },
+  { 0xD1B71758E219652C,   -77,   -4 },
+  { 0x9C40000000000000,   -50,    4 },
+  { 0xE8D4A51000000000,   -24,   12 },
+  { 0xAD78EBC5AC620000,     3,   20 },
+  { 0x813F3978F8940984,    30,   28 },
+  { 0xC097CE7BC90715B3,    56,   36 },
+  { 0x8F7E32CE7BEA5C70,    83,   44 },
+  { 0xD5D238A4ABE98068,   109,   52 },
+  { 0x9F4F2726179A2245,   136,   60 },
+  { 0xED63A231D4C4FB27,   162,   68 },
+  { 0xB0DE65388CC8ADA8,   189,   76 },
+  { 0x83C7088E1AAB65DB,   216,   84 },
+  { 0xC45D1DF942711D9A,   242,   92 },
+  { 0x924D692CA61BE758,   269,  100 },
+  { 0xDA01EE641A708DEA,   295,  108 },
+  { 0xA26DA3999AEF774A,   322,  116 },
+  { 0xF209787BB47D6B85,   348,  124 },
+  { 0xB454E4A179DD1877,   375,  132 },
+  { 0x865B86925B9BC5C2,   402,  140 },
+  { 0xC83553C5C8965D3D,   428,  148 },
+  { 0x952AB45CFA97A0B3,   455,  156 },
+  { 0xDE469FBD99A05FE3,   481,  164 },
+  { 0xA59BC234DB398C25,   508,  172 },
+  { 0xF6C69A72A3989F5C,   534,  180 },
+  { 0xB7DCBF5354E9BECE,   561,  188 },
+  { 0x88FCF317F22241E2,   588,  196 },
+  { 0xCC20CE9BD35C78A5,   614,  204 },
+  { 0x98165AF37B2153DF,   641,  212 },
+  { 0xE2A0B5DC971F303A,   667,  220 },
+  { 0xA8D9D1535CE3B396,   694,  228 },
+  { 0xFB9B7CD9A4A7443C,   720,  236 },
+  { 0xBB764C4CA7A44410,   747,  244 },
+  { 0x8BAB8EEFB6409C1A,   774,  252 },
+  { 0xD01FEF10A657842C,   800,  260 },
+  { 0x9B10A4E5E9913129,   827,  268 },
+  { 0xE7109BFBA19C0C9D,   853,  276 },
+  { 0xAC2820D9623BF429,   880,  284 },
+  { 0x80444B5E7AA7CF85,   907,  292 },
+  { 0xBF21E44003ACDD2D,   933,  300 },
+  { 0x8E679C2F5E44FF8F,   960,  308 },
+  { 0xD433179D9C8CB841,   986,  316 },
+  { 0x9E19DB92B4E31BA9,  1013,  324 },
+};
+
+const int kCachedPowersMinDecExp = -300;
+const int kCachedPowersDecStep = 8;
+
+// The scaled binary exponent is kept in [kAlpha, kGamma], so that the
+// integral part of the scaled value fits in 32 bits.
+const int kAlpha = -60;
+const int kGamma = -32;
+
+// Return a cached power c = 10^-k such that the exponent of w * c is in
+// [kAlpha, kGamma], where 'e' is the exponent of w.
+const CachedPower& cachedPowerFor(int e) {
+  const int f = kAlpha - e - 1;
+  // 78913 / 2^18 ~= log10(2)
+  const int k = (f * 78913) / (1 << 18) + (f > 0);
+  const int index = (-kCachedPowersMinDecExp + k + (kCachedPowersDecStep - 1))
+                    / kCachedPowersDecStep;
+  ASSERTION(index >= 0 &&
+            index < static_cast<int>(sizeof(kCachedPowers) /
+                                     sizeof(kCachedPowers[0])));
+  const CachedPower& cached = kCachedPowers[index];
+  ASSERTION(kAlpha <= cached.e + e + 64 && cached.e + e + 64 <= kGamma);
+  return cached;
+}
+
+// Return the number of decimal digits in 'n', and set 'pow10' to the
+// largest power of ten <= n.
+int largestPow10(uint32_t n, uint32_t& pow10) {
+  pow10 = 1;
+  int digits = 1;
+  while (digits < 10 && n / pow10 >= 10) {
+    pow10 *= 10;
+    digits++;
+  }
+  return digits;
+}
+
+// Move the last digit down while that brings the result closer to w.
+void roundWeed(char* buffer, int length, uint64_t distance, uint64_t delta,
+               uint64_t rest, uint64_t tenK) {
+  while (rest < distance && delta - rest >= tenK &&
+         (rest + tenK < distance ||
+          distance - rest > rest + tenK - distance)) {
+    buffer[length - 1]--;
+    rest += tenK;
+  }
+}
+
+// Generate the digits of w, within (minus, plus), all scaled by a cached
+// power so the exponent is in [kAlpha, kGamma].
+void generateDigits(char* buffer, int& length, int& decimalExponent,
+                    const DiyFp& minus, const DiyFp& w, const DiyFp& plus) {
+  uint64_t delta = subtract(plus, minus).f;
+  uint64_t distance = subtract(plus, w).f;
+
+  const DiyFp one(1ULL << -plus.e, plus.e);
+
+  uint32_t p1 = static_cast<uint32_t>(plus.f >> -one.e);  // integral part
+  uint64_t p2 = plus.f & (one.f - 1);                     // fractional part
+
+  uint32_t pow10;
+  int n = largestPow10(p1, pow10);
+
+  while (n > 0) {
+    const uint32_t d = p1 / pow10;
+    p1 %= pow10;
+    buffer[length++] = static_cast<char>('0' + d);
+    n--;
+
+    const uint64_t rest = (static_cast<uint64_t>(p1) << -one.e) + p2;
+    if (rest <= delta) {
+      decimalExponent += n;
+      roundWeed(buffer, length, distance, delta, rest,
+                static_cast<uint64_t>(pow10) << -one.e);
+      return;
+    }
+    pow10 /= 10;
+  }
+
+  int m = 0;
+  while (true) {
+    p2 *= 10;
+    const uint64_t d = p2 >> -one.e;
+    p2 &= one.f - 1;
+    buffer[length++] = static_cast<char>('0' + d);
+    m++;
+
+    delta *= 10;
+    distance *= 10;
+    if (p2 <= delta) break;
+  }
+
+  decimalExponent -= m;
+  roundWeed(buffer, length, distance, delta, p2, one.f);
+}
+
+// Set 'digits' to the shortest digits of 'value' (> 0, finite), such
+// that value ~= digits * 10^decimalExponent.
+void grisu2(double value, char* digits, int& length, int& decimalExponent) {
+  const Boundaries b = computeBoundaries(value);
+  const CachedPower& cached = cachedPowerFor(b.plus.e);
+  const DiyFp c(cached.f, cached.e);
+
+  const DiyFp w = multiply(b.w, c);
+  const DiyFp minus = multiply(b.minus, c);
+  const DiyFp plus = multiply(b.plus, c);
+
+  // The products may each be off by one, so shrink the interval to be
+  // sure everything in it rounds back to 'value'.
+  length = 0;
+  decimalExponent = -cached.k;
+  generateDigits(digits, length, decimalExponent,
+                 DiyFp(minus.f + 1, minus.e), w, DiyFp(plus.f - 1, plus.e));
+}
+
+// Write an exponent as printf does: a sign, and at least two digits.
+int writeExponent(int exponent, char* out) {
+  char* p = out;
+  *p++ = 'e';
+  if (exponent < 0) {
+    *p++ = '-';
+    exponent = -exponent;
+  } else {
+    *p++ = '+';
+  }
+  if (exponent >= 100) {
+    *p++ = static_cast<char>('0' + exponent / 100);
+    exponent %= 100;
+  }
+  *p++ = static_cast<char>('0' + exponent / 10);
+  *p++ = static_cast<char>('0' + exponent % 10);
+  return p - out;
+}
+
+// Write 'length' digits, whose first digit is in the 10^exponent place,
+// either as a plain decimal or with an exponent. Trailing zeros in
+// 'digits' must already have been removed.
+int formatDigits(const char* digits, int length, int exponent,
+                 bool scientific, char* out) {
+  char* p = out;
+
+  if (scientific) {
+    *p++ = digits[0];
+    if (length > 1) {
+      *p++ = '.';
+      memcpy(p, digits + 1, length - 1);
+      p += length - 1;
+    }
+    p += writeExponent(exponent, p);
+  } else if (exponent >= 0) {
+    const int integral = exponent + 1;
+    if (length <= integral) {
+      memcpy(p, digits, length);
+      p += length;
+      memset(p, '0', integral - length);
+      p += integral - length;
+    } else {
+      memcpy(p, digits, integral);
+      p += integral;
+      *p++ = '.';
+      memcpy(p, digits + integral, length - integral);
+      p += length - integral;
+    }
+  } else {
+    *p++ = '0';
+    *p++ = '.';
+    memset(p, '0', -exponent - 1);
+    p += -exponent - 1;
+    memcpy(p, digits, length);
+    p += length;
+  }
+
+  return p - out;
+}
+
+// Exact powers of ten, for scaling in the fixed-precision fast path. Any
+// 10^k up to 10^27 fits in a 64-bit significand.
+long double powerOfTen(int k) {
+  static const long double kPowers[] = {
+    1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L,
+    1e10L, 1e11L, 1e12L, 1e13L, 1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L,
+    1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L,
+  };
+  return kPowers[k];
+}
+
+// Return 'value' * 10^k, with a single rounding.
+long double scale(double value, int k) {
+  if (k >= 0) {
+    return value * powerOfTen(k);
+  } else {
+    return value / powerOfTen(-k);
+  }
+}
+
+}  // namespace
+
+int Dtoa::shortest(double value, char* buffer) {
+  PRECONDITION(buffer != 0);
+
+  if (!isfinite(value)) {
+    return snprintf(buffer, kBufferSize, "%g", value);
+  }
+
+  char* p = buffer;
+  if (signbit(value)) {
+    *p++ = '-';
+    value = -value;
+  }
+
+  if (value == 0) {
+    *p++ = '0';
+    return p - buffer;
+  }
+
+  char digits[32];
+  int length = 0;
+  int decimalExponent = 0;
+  grisu2(value, digits, length, decimalExponent);
+  while (length > 1 && digits[length - 1] == '0') {
+    length--;
+    decimalExponent++;
+  }
+
+  const int exponent = length + decimalExponent - 1;
+  const bool scientific = (exponent < -5 || exponent > 16);
+  return (p - buffer) + formatDigits(digits, length, exponent, scientific, p);
+}
+
+int Dtoa::significant(double value, int precision, char* buffer) {
+  PRECONDITION(buffer != 0);
+  PRECONDITION(precision >= 0 && precision <= 40);
+
+  if (precision == 0) precision = 1;
+
+  const double magnitude = fabs(value);
+
+  // The fast path scales the value to an integer of 'precision' digits
+  // in a long double, then rounds. It needs a 64-bit significand to be
+  // sure of the rounding, and only covers the usual ranges; anything
+  // else goes to printf.
+  if (numeric_limits<long double>::digits < 64 || precision > 17 ||
+      !(magnitude >= 1e-5 && magnitude < 1e16)) {
+    if (value == 0) {
+      char* p = buffer;
+      if (signbit(value)) *p++ = '-';
+      *p++ = '0';
+      return p - buffer;
+    }
+    return snprintf(buffer, kBufferSize, "%.*g", precision, value);
+  }
+
+  // Estimate the decimal exponent from the binary one. The estimate is
+  // never too high, and at most one too low.
+  int binaryExponent;
+  frexp(magnitude, &binaryExponent);
+  int exponent = static_cast<int>(floor((binaryExponent - 1) *
+                                        0.30102999566398120));
+
+  long double scaled = scale(magnitude, precision - 1 - exponent);
+  if (scaled >= powerOfTen(precision)) {
+    exponent++;
+    scaled = scale(magnitude, precision - 1 - exponent);
+  }
+
+  // The scaled value is below 2^57, so its error is under 2^-7. If it's
+  // that close to a rounding boundary, let printf decide.
+  const long double whole = floorl(scaled);
+  const long double fraction = scaled - whole;
+  if (fabsl(fraction - 0.5L) < 0.01L) {
+    return snprintf(buffer, kBufferSize, "%.*g", precision, value);
+  }
+
+  uint64_t n = static_cast<uint64_t>(whole) + (fraction > 0.5L ? 1 : 0);
+  if (n >= static_cast<uint64_t>(powerOfTen(precision))) {
+    // Rounded up to another digit, eg 9.99 -> 10.0
+    n /= 10;
+    exponent++;
+  }
+
+  // The digits of 'n', without trailing zeros.
+  char digits[24];
+  for (int i = precision - 1; i >= 0; --i) {
+    digits[i] = static_cast<char>('0' + n % 10);
+    n /= 10;
+  }
+  int length = precision;
+  while (length > 1 && digits[length - 1] == '0') length--;
+
+  char* p = buffer;
+  if (value < 0) *p++ = '-';
+
+  // As printf's %g: an exponent is used if it's less than -4, or not less
+  // than the precision.
+  const bool scientific = (exponent < -4 || exponent >= precision);
+  return (p - buffer) + formatDigits(digits, length, exponent, scientific, p);
+}
@@ -0,0 +1,23 @@
+#if !defined DTOA_H
+#define      DTOA_H
+
+// Conversion of doubles to text, without going through iostreams or
+// printf in the common cases.
+class Dtoa {
+ public:
+  // Buffers passed to the methods below must be at least this long.
+  static const int kBufferSize = 64;
+
+  // Write the shortest text that reads back (eg with strtod) as exactly
+  // 'value', using the Grisu2 algorithm. Numbers with a decimal exponent
+  // from -5 to 16 are written without an exponent. Returns the length;
+  // the text is not null-terminated.
+  static int shortest(double value, char* buffer);
+
+  // Write 'value' with at most 'digits' significant digits, exactly as
+  // printf's "%.*g" (and so an ostream with that precision) would.
+  // Returns the length; the text is not null-terminated.
+  static int significant(double value, int digits, char* buffer);
+};
+
+#endif
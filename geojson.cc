@@ -0,0 +1,108 @@
+#include "geojson.h"
+
+#include "output.h"
+#include "track.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <math.h>
+#include <stdio.h>
+
+using namespace std;
+
+namespace {
+
+// Write a JSON string, with quotes and escapes
+void writeString(OutputBuffer& out, const string& text) {
+  out << '"';
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      out << buffer;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+void writeFeature(OutputBuffer& out, const Track& track,
+                  unsigned start, unsigned end,
+                  const Track::Climb* climb, const GeoJSON::Options& options) {
+  out << "{\"type\":\"Feature\",\"properties\":{\"climb\":";
+  if (climb != nullptr) {
+    out << "true,\"grade\":";
+    out.appendDouble(round(climb->getGrade() * 10) / 10, 6);
+  } else {
+    out << "false";
+  }
+  out << "},\n\"geometry\":{\"type\":\"LineString\",\"coordinates\":[";
+
+  bool first = true;
+  auto writePoint = [&](const Point& point) {
+    if (!first) out << ",";
+    first = false;
+    out.precision(12);
+    out << "\n[" << point.lon << "," << point.lat << ",";
+    out.precision(6);
+    out << point.elevation << "]";
+  };
+
+  if (options.tolerance > 0) {
+    for (unsigned i : track.significantPoints(start, end,
+                                              options.tolerance)) {
+      writePoint(track[i]);
+    }
+  } else {
+    for (unsigned i = start; i <= end; ++i) {
+      writePoint(track[i]);
+    }
+  }
+
+  out << "]}}";
+}
+
+}  // unnamed namespace
+
+void GeoJSON::write(ostream& stream, const Track& track, Options options) {
+  OutputBuffer out(stream);
+  out.shortest(options.shortest);
+
+  out << "{\"type\":\"FeatureCollection\",\"name\":";
+  writeString(out, track.getName());
+  out << ",\"features\":[\n";
+
+  if (!track.empty()) {
+    unsigned last_point = 0;
+    bool first = true;
+
+    if (options.climbs) {
+      for (const Track::Climb& climb : track.getClimbs()) {
+        if (climb.getStartIndex() > last_point) {
+          if (!first) out << ",\n";
+          writeFeature(out, track, last_point, climb.getStartIndex(),
+                       nullptr, options);
+          first = false;
+        }
+        if (!first) out << ",\n";
+        writeFeature(out, track, climb.getStartIndex(), climb.getEndIndex(),
+                     &climb, options);
+        first = false;
+        last_point = climb.getEndIndex();
+      }
+    }
+
+    if (first || last_point < track.size() - 1) {
+      if (!first) out << ",\n";
+      writeFeature(out, track, last_point, track.size() - 1, nullptr,
+                   options);
+    }
+  }
+
+  out << "\n]}\n";
+}
@@ -0,0 +1,26 @@
+#if !defined GEOJSON_H
+#define      GEOJSON_H
+
+#include <iosfwd>
+
+class Track;
+
+// Writes a track as a GeoJSON FeatureCollection of LineStrings, with
+// [lon, lat, elevation] coordinates. Like KML, the track is split into
+// a feature for each climb, and features for the flats in between. Each
+// feature has a "climb" property, and climbs have their "grade".
+class GeoJSON {
+public:
+  struct Options {
+    Options() {}
+
+    bool climbs = true;      // split into features at the climbs
+    double tolerance = 0;    // simplify to within this many meters; 0 = off
+    bool shortest = false;   // shortest exact numbers, not fixed precision
+  };
+
+  static void write(std::ostream& out, const Track& track,
+                    Options options = Options());
+};
+
+#endif
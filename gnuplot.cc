@@ -1,9 +1,13 @@
 #include "gnuplot.h"
 
 #include "exception.h"
+#include "output.h"
 #include "point.h"
 #include "track.h"
 
+#include <fstream>
+#include <vector>
+
 using namespace std;
 
 namespace {
@@ -34,110 +38,161 @@ string axes(bool metric) {
   return string(xaxis(metric)) + ":" + yaxis(metric);
 }
 
+// In the binary formats, each point is a record of these values
+struct Record {
+  double length;
+  double elevation;
+  double grade;
+};
+
+const char* BINARY_FORMAT =
+    " format='%float64%float64%float64'";
+
+// One element of the plot: a range of points, and how to draw them
+struct Series {
+  Series(unsigned s, unsigned c, bool g, const string& u)
+      : start(s), count(c), grade(g), usage(u) {}
+
+  unsigned start;
+  unsigned count;
+  bool grade;     // true for length & grade, false for length & elevation
+  string usage;   // what follows "using"
+};
+
+void writeRecord(OutputBuffer& out, const Point& point) {
+  Record record;
+  record.length = point.length;
+  record.elevation = point.elevation;
+  record.grade = point.grade;
+  out.append(reinterpret_cast<const char*>(&record), sizeof(record));
+}
+
 }  // namespace
 
-void Gnuplot::write(ostream& out, const Track& track, Options options) {
+void Gnuplot::write(ostream& stream, const Track& track, Options options) {
   PRECONDITION(!options.terminal.empty());
+  PRECONDITION(options.data != Options::BINARY_FILE ||
+               !options.dataFile.empty());
+
+  if (options.dataFile.find('\'') != string::npos) {
+    throw Exception("Can't refer to a gnuplot data file with a quote: " +
+                    options.dataFile);
+  }
+
+  OutputBuffer out(stream);
+  out.shortest(options.shortest);
 
   // Is there a 'difficult' section of the ride?
   int start = 0;
   int end = 0;
   double score = 0;
-  track.mostDifficult(1000, start, end, score);
+  track.mostDifficult(Track::kDifficultMeters, start, end, score);
   const bool difficult = options.difficult && (start >= 0);
 
-  out << "set grid" << endl
-      << "set y2tics" << endl
+  out << "set grid\n"
+      << "set y2tics\n"
       << "set xlabel 'Distance "
-      << (options.metric ? "(km)'" : "(miles)'") << endl
+      << (options.metric ? "(km)'\n" : "(miles)'\n")
       << "set ylabel 'Elevation "
-      << (options.metric ? "(meters)'" : "(feet)'") << endl
-      << "set y2label 'Grade (%)'" << endl
-      << "set terminal " << options.terminal << endl
-      << "set style line 1 linewidth 2 linecolor rgb '#60b060'" << endl
-      << "set style line 2 linewidth 1 linecolor rgb '#b06060'" << endl
-      << "set style line 3 linewidth 2 linecolor rgb '#707030'" << endl
-      << "set style line 4 linewidth 2 linecolor rgb '#a02020'" << endl
+      << (options.metric ? "(meters)'\n" : "(feet)'\n")
+      << "set y2label 'Grade (%)'\n"
+      << "set terminal " << options.terminal << "\n"
+      << "set style line 1 linewidth 2 linecolor rgb '#60b060'\n"
+      << "set style line 2 linewidth 1 linecolor rgb '#b06060'\n"
+      << "set style line 3 linewidth 2 linecolor rgb '#707030'\n"
+      << "set style line 4 linewidth 2 linecolor rgb '#a02020'\n"
       << "set object 1 rectangle from graph 0, graph 0 to"
       << " graph 1, graph 1 behind"
-      << " fillcolor rgb '#f0ffff' fillstyle solid 1.0" << endl;
+      << " fillcolor rgb '#f0ffff' fillstyle solid 1.0\n";
 
-  out << "plot ";
-  bool plotted = false;
+  // In the text format the grade is the second column, but in a binary
+  // record it's the third.
+  const string grade = (options.data == Options::TEXT) ? "$2" : "$3";
 
-  if (options.grade) {
-    out << (plotted ? "," : "");
-    plotted = true;
+  vector<Series> series;
 
+  if (options.grade) {
     // Show the grade, but mask out negative grades
-    out << "'-' using " << xaxis(options.metric) << ":(($2 > 0) ? $2 : 0)"
-        << " with filledcurves above x1 fill solid 0.6 border linestyle 2"
-        << " axis x1y2 title 'Grade (%)'";
+    series.push_back(Series(
+        0, track.size(), true,
+        string(xaxis(options.metric)) + ":((" + grade + " > 0) ? " + grade +
+        " : 0) with filledcurves above x1 fill solid 0.6 border linestyle 2"
+        " axis x1y2 title 'Grade (%)'"));
   }
 
   if (options.elevation) {
-    out << (plotted ? "," : "");
-    plotted = true;
-
-    out << "'-' using " << axes(options.metric)
-        << " with filledcurves above x1 fill transparent solid 0.8"
-        << " border linestyle 1 title 'Elevation'";
+    series.push_back(Series(
+        0, track.size(), false,
+        axes(options.metric) + " with filledcurves above x1 fill transparent"
+        " solid 0.8 border linestyle 1 title 'Elevation'"));
   }
 
   // Highlight each of the climbs
-  if (options.climbs && !track.getClimbs().empty()) {
-    for (unsigned i = 0; i < track.getClimbs().size(); ++i) {
-      out << (plotted ? "," : "");
-      plotted = true;
-
-      out << "'-' using " << axes(options.metric)
-          << " with lines linestyle 3 notitle";
+  if (options.climbs) {
+    for (const Track::Climb& climb : track.getClimbs()) {
+      series.push_back(Series(
+          climb.getStart().seq, climb.getEnd().seq - climb.getStart().seq,
+          false, axes(options.metric) + " with lines linestyle 3 notitle"));
     }
   }
 
   // Highlight the most difficult KM
   if (options.difficult && difficult) {
-    out << (plotted ? "," : "");
-    plotted = true;
+    series.push_back(Series(
+        start, end - start + 1, false,
+        axes(options.metric) + " with lines linestyle 4 notitle"));
+  }
 
-    out << "'-' using " << axes(options.metric)
-        << " with lines linestyle 4 notitle";
+  out << "plot ";
+  for (unsigned i = 0; i < series.size(); ++i) {
+    const Series& s = series[i];
+    if (i > 0) out << ",";
+
+    if (options.data == Options::TEXT) {
+      out << "'-'";
+    } else if (options.data == Options::BINARY) {
+      out << "'-' binary record=" << s.count << BINARY_FORMAT;
+    } else {
+      out << "'" << options.dataFile << "' binary skip="
+          << s.start * unsigned(sizeof(Record)) << " record=" << s.count
+          << BINARY_FORMAT;
+    }
+    out << " using " << s.usage;
   }
-  out << endl;
+  out << "\n";
 
   // Now write all the data
-  streamsize prev = out.precision();
-  out.precision(8);
-
-  if (options.grade) {
-    for (const Point& point : track) {
-      out << point.length << " " << point.grade << endl;
+  if (options.data == Options::BINARY_FILE) {
+    ofstream file(options.dataFile.c_str(),
+                  ios::out | ios::binary | ios::trunc);
+    if (!file) {
+      throw SystemException(errno, "Unable to open " + options.dataFile);
     }
-    out << "e" << endl;
-  }
 
-  if (options.elevation) {
+    OutputBuffer data(file);
     for (const Point& point : track) {
-      out << point.length << " " << point.elevation << endl;
+      writeRecord(data, point);
     }
-    out << "e" << endl;
+    data.flush();
+    if (!file) {
+      throw Exception("Error writing " + options.dataFile);
+    }
+    return;
   }
 
-  if (options.climbs) {
-    for (const Track::Climb& climb : track.getClimbs()) {
-      for (int i = climb.getStart().seq; i < climb.getEnd().seq; ++i) {
-        out << track[i].length << " " << track[i].elevation << endl;
+  out.precision(8);
+
+  for (const Series& s : series) {
+    for (unsigned i = s.start; i < s.start + s.count; ++i) {
+      if (options.data == Options::BINARY) {
+        writeRecord(out, track[i]);
+      } else {
+        out << track[i].length << " "
+            << (s.grade ? track[i].grade : track[i].elevation) << "\n";
       }
-      out << "e" << endl;
     }
-  }
-
-  if (options.difficult && difficult) {
-    for (int i = start; i <= end; ++i) {
-      out << track[i].length << " " << track[i].elevation << endl;
+    if (options.data == Options::TEXT) {
+      out << "e\n";
     }
-    out << "e" << endl;
   }
-
-  out.precision(prev);
 }
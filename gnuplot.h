@@ -20,6 +20,15 @@ public:
     bool elevation = true;
     bool climbs = true;
     bool difficult = true;
+    bool shortest = false;  // shortest exact numbers, not fixed precision
+
+    // How the data is included: as text after the script; inline after
+    // the script, in gnuplot's binary format; or in the binary file
+    // 'dataFile', written once, with each plot element referring to its
+    // range of points. The binary formats are native doubles.
+    enum Data { TEXT, BINARY, BINARY_FILE };
+    Data data = TEXT;
+    std::string dataFile;
   };
 
   // Create a gnuplot script, based on the track
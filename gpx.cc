@@ -1,5 +1,6 @@
 #include "document.h"
 #include "gpx.h"
+#include "output.h"
 #include "track.h"
 
 #include <string>
@@ -20,27 +21,6 @@ static double toDouble(const char* val) {
   return d;
 }
 
-// Set the timezone, but reset it on exit
-class TimezoneReset {
-public:
-  TimezoneReset(const std::string& zone) {
-    const char* oldTZ = getenv("TZ");
-    if (oldTZ != 0) tz = oldTZ;
-    setenv("TZ", zone.c_str(), 1);
-  }
-
-  ~TimezoneReset() {
-    if (tz.empty()) {
-      unsetenv("TZ");
-    } else {
-      setenv("TZ", tz.c_str(), 1);
-    }
-  }
-
-private:
-  std::string tz;
-};
-
 static void processDoc(const Document& doc, Track& points) {
   const xml_node<>* trk = doc.getTop().first_node()->first_node("trk");
   if (trk == nullptr) throw GPXError("No <trk> element");
@@ -50,9 +30,6 @@ static void processDoc(const Document& doc, Track& points) {
     points.setName(name->value());
   }
 
-  // I need mktime() to work in UTC
-  TimezoneReset tzreset("UTC");
-
   for (xml_node<>* trkseg = trk->first_node();
        trkseg != nullptr;
        trkseg = trkseg->next_sibling()) {    
@@ -78,9 +55,11 @@ static void processDoc(const Document& doc, Track& points) {
 
         const xml_node<>* ts = trkpt->first_node("time");
         if (ts != nullptr) {
-          struct tm time;
+          // timegm, unlike mktime, works in UTC without changing TZ,
+          // which isn't safe with other threads reading tracks
+          struct tm time = {};
           strptime(ts->value(), "%Y-%m-%dT%H:%M:%S.000Z", &time);
-          current.timestamp = mktime(&time);
+          current.timestamp = timegm(&time);
         }
 
         const xml_node<>* ext = trkpt->first_node("extensions");
@@ -117,15 +96,18 @@ void GPX::read(istream& in, Track& points) {
   processDoc(doc, points);
 }
 
-static string toString(const time_t& t) {
-  struct tm time;
-  gmtime_r(&t, &time);
-  char buffer[100];
-  strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S.000Z", &time);
-  return string(buffer);
+static void writeTime(OutputBuffer& out, TimestampFormatter& formatter,
+                      time_t t) {
+  const char* text = formatter.format(t);
+  out.append(text, formatter.length());
 }
 
-void GPX::write(ostream& out, const Track& track) {
+void GPX::write(ostream& stream, const Track& track, Options options) {
+  OutputBuffer out(stream);
+  out.shortest(options.shortest);
+
+  TimestampFormatter formatter(options.milliseconds);
+
   const char* header =
 "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
 "<gpx version=\"1.1\" creator=\"Track Tools\"\n"
@@ -137,41 +119,44 @@ void GPX::write(ostream& out, const Track& track) {
   out << header;
   out << "<metadata>";
   if (!track.empty()) {
-    out << "<time>" << toString(track.first().timestamp) << "</time>";
+    out << "<time>";
+    writeTime(out, formatter, track.first().timestamp);
+    out << "</time>";
   }
-  out << "</metadata>" << endl;
+  out << "</metadata>\n";
 
-  out << "<trk>" << endl;
+  out << "<trk>\n";
   if (!track.getName().empty()) {
-    out << "<name>" << track.getName() << "</name>" << endl;
+    out << "<name>" << track.getName() << "</name>\n";
   }
-  out << "<trkseg>" << endl;
+  out << "<trkseg>\n";
   for (unsigned i = 0; i < track.size(); i++) {
     out.precision(12);
     out << "<trkpt lon=\"" << track[i].lon << "\" lat=\""
-        << track[i].lat << "\">" << endl;
+        << track[i].lat << "\">\n";
     out.precision(7);
-    out << "<ele>" << track[i].elevation << "</ele>" << endl;
+    out << "<ele>" << track[i].elevation << "</ele>\n";
 
     if (track[i].timestamp != 0) {
-      out << "<time>" << toString(track[i].timestamp) << "</time>"
-          << endl;
+      out << "<time>";
+      writeTime(out, formatter, track[i].timestamp);
+      out << "</time>\n";
     }
 
     if ((track[i].hr > 0) || track[i].validTemp()) {
-      out << "<extensions><gpxtpx:TrackPointExtension>" << endl;
+      out << "<extensions><gpxtpx:TrackPointExtension>\n";
       if (track[i].hr > 0) {
-        out << "<gpxtpx:hr>" << track[i].hr << "</gpxtpx:hr>" << endl;
+        out << "<gpxtpx:hr>" << track[i].hr << "</gpxtpx:hr>\n";
       }
       if (track[i].validTemp()) {
-        out << "<gpxtpx:atemp>" << track[i].atemp << "</gpxtpx:atemp>"
-            << endl;
+        out << "<gpxtpx:atemp>" << track[i].atemp
+            << "</gpxtpx:atemp>\n";
       }
-      out << "</gpxtpx:TrackPointExtension></extensions>" << endl;
+      out << "</gpxtpx:TrackPointExtension></extensions>\n";
     }
-    out << "</trkpt>" << endl;
+    out << "</trkpt>\n";
   }
-  out << "</trkseg>" << endl;
-  out << "</trk>" << endl;
-  out << "</gpx>" << endl;
+  out << "</trkseg>\n";
+  out << "</trk>\n";
+  out << "</gpx>\n";
 }
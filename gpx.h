@@ -11,10 +11,18 @@ class Track;
 // Methods for reading and writing GPX files
 class GPX {
 public:
+  struct Options {
+    Options() {}
+
+    bool shortest = false;     // shortest exact numbers, not fixed precision
+    bool milliseconds = true;  // write times as hh:mm:ss.000, not hh:mm:ss
+  };
+
   static void read(std::istream& in, Track& out);
   static void read(const std::string& filename, Track& out);
 
-  static void write(std::ostream& out, const Track& track);
+  static void write(std::ostream& out, const Track& track,
+                    Options options = Options());
 };
 
 class GPXError : public Exception {
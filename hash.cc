@@ -0,0 +1,94 @@
+#include "hash.h"
+
+#include <string.h>
+
+namespace {
+
+const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotate(uint64_t x, int bits) {
+  return (x << bits) | (x >> (64 - bits));
+}
+
+inline uint64_t read64(const unsigned char* p) {
+  uint64_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline uint32_t read32(const unsigned char* p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline uint64_t mix(uint64_t acc, uint64_t input) {
+  acc += input * kPrime2;
+  return rotate(acc, 31) * kPrime1;
+}
+
+inline uint64_t merge(uint64_t hash, uint64_t lane) {
+  hash ^= mix(0, lane);
+  return hash * kPrime1 + kPrime4;
+}
+
+}  // namespace
+
+uint64_t Hash::xxh64(const void* data, size_t len, uint64_t seed) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  const unsigned char* const end = p + len;
+  uint64_t hash;
+
+  if (len >= 32) {
+    uint64_t v1 = seed + kPrime1 + kPrime2;
+    uint64_t v2 = seed + kPrime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - kPrime1;
+
+    const unsigned char* const limit = end - 32;
+    do {
+      v1 = mix(v1, read64(p));
+      v2 = mix(v2, read64(p + 8));
+      v3 = mix(v3, read64(p + 16));
+      v4 = mix(v4, read64(p + 24));
+      p += 32;
+    } while (p <= limit);
+
+    hash = rotate(v1, 1) + rotate(v2, 7) + rotate(v3, 12) + rotate(v4, 18);
+    hash = merge(hash, v1);
+    hash = merge(hash, v2);
+    hash = merge(hash, v3);
+    hash = merge(hash, v4);
+  } else {
+    hash = seed + kPrime5;
+  }
+
+  hash += len;
+
+  for ( ; p + 8 <= end; p += 8) {
+    hash ^= mix(0, read64(p));
+    hash = rotate(hash, 27) * kPrime1 + kPrime4;
+  }
+
+  if (p + 4 <= end) {
+    hash ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+    hash = rotate(hash, 23) * kPrime2 + kPrime3;
+    p += 4;
+  }
+
+  for ( ; p < end; ++p) {
+    hash ^= *p * kPrime5;
+    hash = rotate(hash, 11) * kPrime1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
@@ -0,0 +1,16 @@
+#if !defined HASH_H
+#define      HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fast, non-cryptographic hashing
+class Hash {
+ public:
+  // The 64-bit xxHash (XXH64) of 'len' bytes, which reads eight bytes at
+  // a time in four independent lanes. It matches the reference
+  // implementation on little-endian machines.
+  static uint64_t xxh64(const void* data, size_t len, uint64_t seed = 0);
+};
+
+#endif
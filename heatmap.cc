@@ -0,0 +1,238 @@
+#include "heatmap.h"
+
+#include "exception.h"
+#include "track.h"
+
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+
+#include "gd.h"
+
+using namespace std;
+
+namespace {
+
+// The latitude at which the Web Mercator world is square
+const double kMaxLatitude = 85.0511287798;
+
+int writeTo(void* context, const char* buffer, int len) {
+  static_cast<ostream*>(context)->write(buffer, len);
+  return len;
+}
+
+// The colors of an image, from index 1 (the fewest) to kColors - 1 (the
+// most); 0 is the background. A palette image takes a quarter of the
+// memory of a true color one, and compresses faster.
+const int kColors = 256;
+
+// The red, green and blue of a color from dark red through yellow to
+// white, for 't' from 0 to 1
+void heatColor(double t, int rgb[3]) {
+  const double level = 0.2 + 0.8 * t;
+  for (int i = 0; i < 3; ++i) {
+    rgb[i] = 255 * min(max(3 * level - i, 0.0), 1.0);
+  }
+}
+
+}  // namespace
+
+double Heatmap::worldX(double lon, int zoom) {
+  PRECONDITION(zoom >= 0 && zoom <= kMaxZoom);
+  const double size = static_cast<double>(kTileSize) * (1u << zoom);
+  return (lon + 180) / 360 * size;
+}
+
+double Heatmap::worldY(double lat, int zoom) {
+  PRECONDITION(zoom >= 0 && zoom <= kMaxZoom);
+  const double size = static_cast<double>(kTileSize) * (1u << zoom);
+  const double radians = max(min(lat, kMaxLatitude), -kMaxLatitude) *
+                         M_PI / 180;
+  return (0.5 - log(tan(M_PI / 4 + radians / 2)) / (2 * M_PI)) * size;
+}
+
+Heatmap::Path Heatmap::project(const Track& track, int zoom) {
+  const int32_t last = kTileSize * (1 << zoom) - 1;
+
+  Path path;
+  for (const Point& point : track) {
+    Path::Pixel pixel;
+    pixel.x = min<double>(max(floor(worldX(point.lon, zoom)), 0.0), last);
+    pixel.y = min<double>(max(floor(worldY(point.lat, zoom)), 0.0), last);
+    if (!path.pixels.empty() && path.pixels.back().x == pixel.x &&
+        path.pixels.back().y == pixel.y) {
+      continue;
+    }
+
+    if (path.pixels.empty()) {
+      path.minX = path.maxX = pixel.x;
+      path.minY = path.maxY = pixel.y;
+    } else {
+      path.minX = min(path.minX, pixel.x);
+      path.maxX = max(path.maxX, pixel.x);
+      path.minY = min(path.minY, pixel.y);
+      path.maxY = max(path.maxY, pixel.y);
+    }
+    path.pixels.push_back(pixel);
+  }
+
+  path.pixels.shrink_to_fit();
+  return path;
+}
+
+Heatmap::Heatmap(int32_t l, int32_t t, int w, int h)
+    : left(l), top(t), width(w), height(h),
+      grid(static_cast<size_t>(w) * h, 0) {
+  PRECONDITION(w > 0 && h > 0);
+}
+
+void Heatmap::add(const Path& path) {
+  if (path.pixels.empty() ||
+      path.maxX < left || path.minX >= left + width ||
+      path.maxY < top || path.minY >= top + height) {
+    return;
+  }
+
+  const vector<Path::Pixel>& pixels = path.pixels;
+  if (pixels.size() == 1) {
+    line(pixels[0].x - left, pixels[0].y - top,
+         pixels[0].x - left, pixels[0].y - top, false);
+    return;
+  }
+
+  // Most segments of a long path are often outside the window, so skip
+  // those entirely to one side before clipping
+  const int32_t right = left + width;
+  const int32_t bottom = top + height;
+  for (size_t i = 1; i < pixels.size(); ++i) {
+    const Path::Pixel& from = pixels[i - 1];
+    const Path::Pixel& to = pixels[i];
+    if ((from.x < left && to.x < left) ||
+        (from.x >= right && to.x >= right) ||
+        (from.y < top && to.y < top) ||
+        (from.y >= bottom && to.y >= bottom)) {
+      continue;
+    }
+    line(from.x - left, from.y - top, to.x - left, to.y - top, i > 1);
+  }
+}
+
+void Heatmap::line(double x0, double y0, double x1, double y1,
+                   bool skipFirst) {
+  // Clip to the window (Liang-Barsky)
+  const double dx = x1 - x0;
+  const double dy = y1 - y0;
+  double t0 = 0;
+  double t1 = 1;
+  auto clip = [&](double p, double q) {
+    if (p == 0) return q >= 0;
+    const double r = q / p;
+    if (p < 0) {
+      if (r > t1) return false;
+      t0 = max(t0, r);
+    } else {
+      if (r < t0) return false;
+      t1 = min(t1, r);
+    }
+    return true;
+  };
+  if (!clip(-dx, x0) || !clip(dx, width - 1 - x0) ||
+      !clip(-dy, y0) || !clip(dy, height - 1 - y0)) {
+    return;
+  }
+  if (t0 > 0) skipFirst = false;
+
+  // Then step from one pixel to the next (Bresenham)
+  int x = lround(x0 + t0 * dx);
+  int y = lround(y0 + t0 * dy);
+  const int endX = lround(x0 + t1 * dx);
+  const int endY = lround(y0 + t1 * dy);
+  const int stepX = x < endX ? 1 : -1;
+  const int stepY = y < endY ? 1 : -1;
+  const int distanceX = abs(endX - x);
+  const int distanceY = -abs(endY - y);
+  int error = distanceX + distanceY;
+
+  while (true) {
+    if (!skipFirst) ++grid[static_cast<size_t>(y) * width + x];
+    skipFirst = false;
+    if (x == endX && y == endY) break;
+
+    const int twice = 2 * error;
+    if (twice >= distanceY) {
+      error += distanceY;
+      x += stepX;
+    }
+    if (twice <= distanceX) {
+      error += distanceX;
+      y += stepY;
+    }
+  }
+}
+
+void Heatmap::merge(const Heatmap& other) {
+  PRECONDITION(other.width == width && other.height == height);
+
+  uint32_t* const to = grid.data();
+  const uint32_t* const from = other.grid.data();
+  for (size_t i = 0; i < grid.size(); ++i) {
+    to[i] += from[i];
+  }
+}
+
+void Heatmap::reset(int32_t l, int32_t t) {
+  left = l;
+  top = t;
+  fill(grid.begin(), grid.end(), 0);
+}
+
+uint32_t Heatmap::maximum(int x, int y, int w, int h) const {
+  PRECONDITION(x >= 0 && y >= 0 && x + w <= width && y + h <= height);
+
+  uint32_t most = 0;
+  for (int row = y; row < y + h; ++row) {
+    const uint32_t* const counts = &grid[static_cast<size_t>(row) * width];
+    for (int column = x; column < x + w; ++column) {
+      most = max(most, counts[column]);
+    }
+  }
+  return most;
+}
+
+void Heatmap::write(ostream& out, int x, int y, int w, int h,
+                    Options opt) const {
+  PRECONDITION(x >= 0 && y >= 0 && w > 0 && h > 0);
+  PRECONDITION(x + w <= width && y + h <= height);
+
+  const uint32_t saturation =
+      opt.saturation > 0 ? opt.saturation : maximum(x, y, w, h);
+  const double scale = 1 / log1p(max<uint32_t>(saturation, 1));
+
+  gdImagePtr image = gdImageCreate(w, h);
+  POSTCONDITION(image != nullptr);
+
+  // The first color allocated is the background
+  const int background = gdImageColorAllocate(image, 0, 0, 0);
+  if (opt.transparent) gdImageColorTransparent(image, background);
+  for (int i = 1; i < kColors; ++i) {
+    int rgb[3];
+    heatColor((i - 1) / (kColors - 2.0), rgb);
+    gdImageColorAllocate(image, rgb[0], rgb[1], rgb[2]);
+  }
+
+  for (int row = 0; row < h; ++row) {
+    const uint32_t* const counts =
+        &grid[static_cast<size_t>(y + row) * width + x];
+    for (int column = 0; column < w; ++column) {
+      if (counts[column] == 0) continue;
+      const double t = min(log1p(counts[column]) * scale, 1.0);
+      gdImageSetPixel(image, column, row, 1 + lround(t * (kColors - 2)));
+    }
+  }
+
+  gdSink sink;
+  sink.context = &out;
+  sink.sink = writeTo;
+  gdImagePngToSink(image, &sink);
+  gdImageDestroy(image);
+}
@@ -0,0 +1,110 @@
+#if !defined HEATMAP_H
+#define      HEATMAP_H
+
+#include <stdint.h>
+
+#include <iosfwd>
+#include <vector>
+
+#include "util.h"
+
+class Track;
+
+// Counts how many times tracks pass through each pixel of a window of
+// the world, and writes the counts as a PNG.
+//
+// Pixels are those of the Web Mercator projection used by map tiles: at
+// a zoom level the world is 256 * 2^zoom pixels square, with (0, 0) at
+// the north-west corner. Tracks are first projected to Paths at the
+// window's zoom, which are drawn one line segment at a time. A Heatmap
+// isn't thread-safe, but several (one per thread, say) can draw into
+// windows of the same size, and be merged.
+class Heatmap : public NoCopy {
+ public:
+  static const int kMaxZoom = 22;
+  static const int kTileSize = 256;
+
+  struct Options {
+    Options() {}
+
+    // The count that gets the brightest color; 0 for the most in the
+    // image. Set it to make several images (like tiles) match.
+    uint32_t saturation = 0;
+
+    // Leave pixels that no track passes through transparent, rather than
+    // black
+    bool transparent = false;
+  };
+
+  // A track's points as pixels at one zoom level, with consecutive
+  // points on the same pixel removed
+  struct Path {
+    struct Pixel {
+      int32_t x;
+      int32_t y;
+    };
+
+    std::vector<Pixel> pixels;
+
+    // The bounds of 'pixels', inclusive. Only valid if there are any.
+    int32_t minX = 0;
+    int32_t minY = 0;
+    int32_t maxX = 0;
+    int32_t maxY = 0;
+  };
+
+  // The position in world pixels of a longitude or latitude at 'zoom'.
+  // Latitudes beyond about 85 degrees are clamped, as on map tiles.
+  static double worldX(double lon, int zoom);
+  static double worldY(double lat, int zoom);
+
+  static Path project(const Track& track, int zoom);
+
+  // The window 'width' by 'height' pixels from 'left' and 'top', in world
+  // pixels, with all its counts 0
+  Heatmap(int32_t left, int32_t top, int width, int height);
+
+  int32_t getLeft() const { return left; }
+  int32_t getTop() const { return top; }
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+
+  // Count each pixel the path passes through, within the window. The
+  // pixel where one segment ends and the next begins counts once.
+  void add(const Path& path);
+
+  // Add the counts of 'other', which must be the same size
+  void merge(const Heatmap& other);
+
+  // Set all the counts to 0, and move the window
+  void reset(int32_t left, int32_t top);
+
+  uint32_t count(int x, int y) const { return grid[y * width + x]; }
+
+  // The largest count in the part of the window 'w' by 'h' from 'x', 'y'
+  uint32_t maximum(int x, int y, int w, int h) const;
+  uint32_t maximum() const { return maximum(0, 0, width, height); }
+
+  // Write the part of the window 'w' by 'h' pixels from 'x' and 'y' as a
+  // PNG, with the counts mapped to colors on a log scale from dark red
+  // through yellow to white.
+  void write(std::ostream& out, int x, int y, int w, int h,
+             Options opt = Options()) const;
+  void write(std::ostream& out, Options opt = Options()) const {
+    write(out, 0, 0, width, height, opt);
+  }
+
+ private:
+  // Count the pixels from (x0, y0) to (x1, y1), relative to the window,
+  // after clipping to it. The first is skipped if 'skipFirst' and it
+  // wasn't clipped.
+  void line(double x0, double y0, double x1, double y1, bool skipFirst);
+
+  int32_t left;
+  int32_t top;
+  int width;
+  int height;
+  std::vector<uint32_t> grid;  // row by row
+};
+
+#endif
@@ -0,0 +1,371 @@
+// heatmap: draws where many activities went, brighter where more passed,
+// as one PNG or as map tiles.
+//
+// Each file is read and projected to pixels once, on one thread per core.
+// For one image, each thread then counts a share of the tracks in its own
+// copy of the image, and the copies are added up; a large image is done
+// on fewer threads, to bound the memory. For tiles, each thread
+// takes a block of tiles at a time, so only a block per thread is ever in
+// memory, however large the area.
+
+#include "dir.h"
+#include "exception.h"
+#include "heatmap.h"
+#include "parse.h"
+#include "track.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// The most pixels in one image; larger areas should be tiles
+const uint64_t kMaxPixels = 64 << 20;
+
+// The most memory for the copies of one image, one per thread, in bytes.
+// A large image is counted on fewer threads, down to one.
+const uint64_t kMaxCopyBytes = 1 << 30;
+
+// Tiles are drawn in square blocks of this many tiles across
+const int kBlockTiles = 8;
+
+// Space around the tracks in an image, in pixels
+const int kMargin = 16;
+
+void usage() {
+  cerr << "Usage: heatmap [-z <zoom>] [-b <min-lat>,<min-lon>,<max-lat>,"
+       << "<max-lon>]" << endl
+       << "               [-s <count>] [-a] [-o <file> | -t <dir>]"
+       << " <files...>" << endl
+       << "Options:" << endl
+       << "             -z <zoom> (map zoom level, 0 to "
+       << Heatmap::kMaxZoom << "; default 12)" << endl
+       << "             -b <box> (the area to draw; default all the tracks)"
+       << endl
+       << "             -s <count> (the count to draw brightest; default"
+       << " the most in" << endl
+       << "                each image. Set it so tiles match.)" << endl
+       << "             -a (transparent where no track passes)" << endl
+       << "             -o <file> (write a PNG; default stdout)" << endl
+       << "             -t <dir> (write <dir>/<zoom>/<x>/<y>.png tiles)"
+       << endl
+       << "             A file named - means read file names from stdin"
+       << endl;
+}
+
+// Run 'work' on one thread per core, but no more than 'tasks'. If any
+// throws, the first exception is thrown once they've all finished.
+void runWorkers(size_t tasks, const function<void()>& work) {
+  exception_ptr error;
+  mutex errorLock;
+  auto run = [&] {
+    try {
+      work();
+    } catch (...) {
+      lock_guard<mutex> lock(errorLock);
+      if (!error) error = current_exception();
+    }
+  };
+
+  const unsigned count =
+      std::min<size_t>(max(1u, thread::hardware_concurrency()),
+                       max<size_t>(1, tasks));
+  vector<thread> threads;
+  for (unsigned i = 1; i < count; ++i) {
+    threads.push_back(thread(run));
+  }
+  run();
+  for (thread& t : threads) {
+    t.join();
+  }
+  if (error) rethrow_exception(error);
+}
+
+// Read and project each file. A file that fails is reported and skipped.
+vector<Heatmap::Path> readPaths(const vector<string>& files, int zoom,
+                                unsigned& failures) {
+  vector<Heatmap::Path> paths(files.size());
+  atomic<size_t> next(0);
+  atomic<unsigned> failed(0);
+  mutex errorLock;
+
+  runWorkers(files.size(), [&] {
+    for (size_t i = next++; i < files.size(); i = next++) {
+      try {
+        Track track;
+        Parse::read(files[i], track);
+        paths[i] = Heatmap::project(track, zoom);
+      } catch (const std::exception& e) {
+        ++failed;
+        lock_guard<mutex> lock(errorLock);
+        cerr << files[i] << ": " << e.what() << endl;
+      }
+    }
+  });
+
+  failures = failed;
+  return paths;
+}
+
+void makeDirectory(const string& path) {
+  if (::mkdir(path.c_str(), 0777) != 0 && errno != EEXIST) {
+    throw SystemException(errno, "Creating directory " + path);
+  }
+}
+
+// Add each path to a copy of the window per thread, as many threads as
+// kMaxCopyBytes allows, then add up the copies
+void writeImage(const vector<Heatmap::Path>& paths, int32_t left,
+                int32_t top, int width, int height,
+                const Heatmap::Options& opt, ostream& out) {
+  vector<unique_ptr<Heatmap>> copies;
+  mutex copiesLock;
+  atomic<size_t> next(0);
+
+  const uint64_t copyBytes =
+      static_cast<uint64_t>(width) * height * sizeof(uint32_t);
+  const size_t threads = max<uint64_t>(1, kMaxCopyBytes / copyBytes);
+
+  runWorkers(min(paths.size(), threads), [&] {
+    unique_ptr<Heatmap> heatmap(new Heatmap(left, top, width, height));
+    for (size_t i = next++; i < paths.size(); i = next++) {
+      heatmap->add(paths[i]);
+    }
+    lock_guard<mutex> lock(copiesLock);
+    copies.push_back(std::move(heatmap));
+  });
+
+  for (size_t i = 1; i < copies.size(); ++i) {
+    copies[0]->merge(*copies[i]);
+  }
+  copies[0]->write(out, opt);
+}
+
+// Write the tiles from 'minX', 'minY' to 'maxX', 'maxY' (inclusive) that
+// any path passes through. Returns the number written.
+unsigned writeTiles(const vector<Heatmap::Path>& paths, int zoom,
+                    int32_t minX, int32_t minY, int32_t maxX, int32_t maxY,
+                    const Heatmap::Options& opt, const string& dir) {
+  // Blocks are aligned, so each tile is in one
+  const int32_t firstColumn = minX / kBlockTiles;
+  const int32_t firstRow = minY / kBlockTiles;
+  const int32_t columns = maxX / kBlockTiles - firstColumn + 1;
+  const int32_t rows = maxY / kBlockTiles - firstRow + 1;
+  const size_t blocks = static_cast<size_t>(columns) * rows;
+
+  const string zoomDir = Directory::createPath(dir, to_string(zoom));
+  makeDirectory(dir);
+  makeDirectory(zoomDir);
+
+  atomic<size_t> next(0);
+  atomic<unsigned> written(0);
+  const int size = kBlockTiles * Heatmap::kTileSize;
+
+  runWorkers(blocks, [&] {
+    Heatmap heatmap(0, 0, size, size);
+    for (size_t b = next++; b < blocks; b = next++) {
+      const int32_t blockX = (firstColumn + b % columns) * kBlockTiles;
+      const int32_t blockY = (firstRow + b / columns) * kBlockTiles;
+      heatmap.reset(blockX * Heatmap::kTileSize,
+                    blockY * Heatmap::kTileSize);
+      for (const Heatmap::Path& path : paths) {
+        heatmap.add(path);
+      }
+
+      for (int32_t x = max(blockX, minX);
+           x < blockX + kBlockTiles && x <= maxX; ++x) {
+        string columnDir;
+        for (int32_t y = max(blockY, minY);
+             y < blockY + kBlockTiles && y <= maxY; ++y) {
+          const int offsetX = (x - blockX) * Heatmap::kTileSize;
+          const int offsetY = (y - blockY) * Heatmap::kTileSize;
+          if (heatmap.maximum(offsetX, offsetY, Heatmap::kTileSize,
+                              Heatmap::kTileSize) == 0) {
+            continue;
+          }
+
+          if (columnDir.empty()) {
+            columnDir = Directory::createPath(zoomDir, to_string(x));
+            makeDirectory(columnDir);
+          }
+          const string filename =
+              Directory::createPath(columnDir, to_string(y) + ".png");
+          ofstream out(filename.c_str(),
+                       ios::out | ios::binary | ios::trunc);
+          if (!out) {
+            throw SystemException(errno, "Unable to open " + filename);
+          }
+          heatmap.write(out, offsetX, offsetY, Heatmap::kTileSize,
+                        Heatmap::kTileSize, opt);
+          ++written;
+        }
+      }
+    }
+  });
+
+  return written;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  try {
+    int zoom = 12;
+    vector<double> box;
+    Heatmap::Options options;
+    string output;
+    string tileDir;
+
+    while (true) {
+      const int opt = getopt(argc, argv, "z:b:s:ao:t:");
+      if (opt == -1) break;
+
+      switch (opt) {
+        case 'z':
+          zoom = strtol(optarg, 0, 0);
+          if (zoom < 0 || zoom > Heatmap::kMaxZoom) {
+            throw Exception("-z (zoom) must be from 0 to " +
+                            to_string(Heatmap::kMaxZoom));
+          }
+          break;
+
+        case 'b': {
+          const char* p = optarg;
+          while (box.size() < 4) {
+            char* end = nullptr;
+            box.push_back(strtod(p, &end));
+            if (end == p) break;
+            p = *end == ',' ? end + 1 : end;
+          }
+          if (box.size() != 4 || *p != 0 || box[0] > box[2] ||
+              box[1] > box[3]) {
+            throw Exception("-b (box) must be <min-lat>,<min-lon>,"
+                            "<max-lat>,<max-lon>");
+          }
+          break;
+        }
+
+        case 's':
+          options.saturation = strtoul(optarg, 0, 0);
+          if (options.saturation < 1) {
+            throw Exception("-s (saturation) must be positive");
+          }
+          break;
+
+        case 'a':
+          options.transparent = true;
+          break;
+
+        case 'o':
+          output = optarg;
+          break;
+
+        case 't':
+          tileDir = optarg;
+          break;
+
+        default:
+          throw Exception("Unknown option");
+      }
+    }
+
+    if (!output.empty() && !tileDir.empty()) {
+      throw Exception("Expecting one of -o (file) and -t (tiles)");
+    }
+
+    vector<string> files;
+    for (int i = optind; i < argc; ++i) {
+      if (string(argv[i]) == "-") {
+        string line;
+        while (getline(cin, line)) {
+          if (!line.empty()) files.push_back(line);
+        }
+      } else {
+        files.push_back(argv[i]);
+      }
+    }
+    if (files.empty()) throw Exception("No input files");
+
+    unsigned failures = 0;
+    const vector<Heatmap::Path> paths = readPaths(files, zoom, failures);
+
+    // The area to draw, in world pixels, inclusive
+    int32_t minX, minY, maxX, maxY;
+    const int32_t last = Heatmap::kTileSize * (1 << zoom) - 1;
+    if (!box.empty()) {
+      minX = max(Heatmap::worldX(box[1], zoom), 0.0);
+      maxX = min<double>(Heatmap::worldX(box[3], zoom), last);
+      minY = max(Heatmap::worldY(box[2], zoom), 0.0);  // north is up
+      maxY = min<double>(Heatmap::worldY(box[0], zoom), last);
+    } else {
+      bool found = false;
+      for (const Heatmap::Path& path : paths) {
+        if (path.pixels.empty()) continue;
+        minX = found ? min(minX, path.minX) : path.minX;
+        minY = found ? min(minY, path.minY) : path.minY;
+        maxX = found ? max(maxX, path.maxX) : path.maxX;
+        maxY = found ? max(maxY, path.maxY) : path.maxY;
+        found = true;
+      }
+      if (!found) throw Exception("No points to draw");
+    }
+
+    if (!tileDir.empty()) {
+      const unsigned written =
+          writeTiles(paths, zoom, minX / Heatmap::kTileSize,
+                     minY / Heatmap::kTileSize, maxX / Heatmap::kTileSize,
+                     maxY / Heatmap::kTileSize, options, tileDir);
+      cerr << "Wrote " << written << " tiles" << endl;
+    } else {
+      if (box.empty()) {
+        minX = max(minX - kMargin, 0);
+        minY = max(minY - kMargin, 0);
+        maxX = min(maxX + kMargin, last);
+        maxY = min(maxY + kMargin, last);
+      }
+      const uint64_t width = maxX - minX + 1;
+      const uint64_t height = maxY - minY + 1;
+      if (width * height > kMaxPixels) {
+        throw Exception("The image would be " + to_string(width) + " by " +
+                        to_string(height) + "; use a lower zoom (-z), or "
+                        "tiles (-t)");
+      }
+
+      if (output.empty()) {
+        writeImage(paths, minX, minY, width, height, options, cout);
+      } else {
+        ofstream out(output.c_str(), ios::out | ios::binary | ios::trunc);
+        if (!out) {
+          throw SystemException(errno, "Unable to open " + output);
+        }
+        writeImage(paths, minX, minY, width, height, options, out);
+      }
+    }
+
+    return failures == 0 ? 0 : 1;
+
+  } catch (const std::exception& e) {
+    cerr << e.what() << endl;
+  } catch (...) {
+    cerr << "Unknown exception in main" << endl;
+  }
+
+  usage();
+  return 1;
+}
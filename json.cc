@@ -1,38 +1,220 @@
 #include "json.h"
+#include <algorithm>
 #include <iostream>
+#include <math.h>
+#include "exception.h"
+#include "output.h"
 #include "track.h"
 
 using namespace std;
 
-void JSON::write(ostream& out, const Track& track, JSON::Options opt) {
+namespace {
+
+// Lengths are written in meters, and elevations in decimeters
+const double LENGTH_SCALE = 1;
+const double ELEVATION_SCALE = 10;
+
+// Choose 'count' points from the profile (length vs elevation) with
+// Largest-Triangle-Three-Buckets: after the first point, the points are
+// divided into buckets, and from each bucket we pick the point forming
+// the largest triangle with the previous pick and the average of the
+// next bucket. That keeps the peaks and valleys that a plain sample
+// would miss. Returns the indexes of the points, in order.
+vector<unsigned> largestTriangles(const Track& track, unsigned count) {
+  vector<unsigned> picked;
+  const unsigned size = track.size();
+
+  if (count >= size || count < 3) {
+    for (unsigned i = 0; i < size; ++i) picked.push_back(i);
+    return picked;
+  }
+
+  const double every = double(size - 2) / (count - 2);
+
+  unsigned a = 0;
+  picked.push_back(a);
+
+  for (unsigned bucket = 0; bucket < count - 2; ++bucket) {
+    // The average of the next bucket (or the last point)
+    const unsigned nextStart = unsigned((bucket + 1) * every) + 1;
+    const unsigned nextEnd =
+        std::min(unsigned((bucket + 2) * every) + 1, size);
+    double avgX = 0;
+    double avgY = 0;
+    for (unsigned i = nextStart; i < nextEnd; ++i) {
+      avgX += track[i].length;
+      avgY += track[i].elevation;
+    }
+    const unsigned nextCount = nextEnd - nextStart;
+    if (nextCount > 0) {
+      avgX /= nextCount;
+      avgY /= nextCount;
+    } else {
+      avgX = track.last().length;
+      avgY = track.last().elevation;
+    }
+
+    // The point in this bucket with the largest triangle
+    const unsigned start = unsigned(bucket * every) + 1;
+    const unsigned end = nextStart;
+    const double ax = track[a].length;
+    const double ay = track[a].elevation;
+
+    double largest = -1;
+    unsigned chosen = start;
+    for (unsigned i = start; i < end; ++i) {
+      const double area = fabs((ax - avgX) * (track[i].elevation - ay) -
+                               (ax - track[i].length) * (avgY - ay));
+      if (area > largest) {
+        largest = area;
+        chosen = i;
+      }
+    }
+
+    picked.push_back(chosen);
+    a = chosen;
+  }
+
+  picked.push_back(size - 1);
+  return picked;
+}
+
+// Return the position of 'index' in 'picked', which must contain it
+int positionOf(const vector<unsigned>& picked, int index) {
+  if (index < 0) return index;
+
+  auto found = lower_bound(picked.begin(), picked.end(), unsigned(index));
+  POSTCONDITION(found != picked.end() && *found == unsigned(index));
+  return found - picked.begin();
+}
+
+// Write 'values', scaled and rounded, as differences from the previous
+// value (the first is relative to zero).
+void writeDeltas(OutputBuffer& out, const vector<double>& values,
+                 double scale) {
+  long long previous = 0;
+  for (unsigned i = 0; i < values.size(); ++i) {
+    const long long value = llround(values[i] * scale);
+    if (i > 0) out << ",";
+    out << value - previous;
+    previous = value;
+  }
+}
+
+void writeLevels(OutputBuffer& out, const Track& track,
+                 const JSON::Options& opt) {
+  int difficultStart = -1;
+  int difficultEnd = -1;
+  double score = 0;
+  if (!track.empty()) {
+    track.mostDifficult(Track::kDifficultMeters, difficultStart, difficultEnd,
+                        score);
+  }
+
+  // Points every level must keep, so the climbs and the most difficult
+  // km can refer to them
+  vector<unsigned> required;
+  for (const Track::Climb& climb : track.getClimbs()) {
+    required.push_back(climb.getStartIndex());
+    required.push_back(climb.getEndIndex());
+  }
+  if (difficultStart >= 0) {
+    required.push_back(difficultStart);
+    required.push_back(difficultEnd);
+  }
+  sort(required.begin(), required.end());
+
+  vector<unsigned> counts(opt.levels);
+  sort(counts.begin(), counts.end());
+  counts.erase(unique(counts.begin(), counts.end()), counts.end());
+
+  out << "{ \"scale\": { \"length\": " << LENGTH_SCALE
+      << ", \"elevation\": " << ELEVATION_SCALE << " },\n"
+      << "\"levels\": [";
+
+  for (unsigned level = 0; level < counts.size(); ++level) {
+    const vector<unsigned> sampled = largestTriangles(track, counts[level]);
+    vector<unsigned> picked;
+    set_union(sampled.begin(), sampled.end(), required.begin(),
+              required.end(), back_inserter(picked));
+    picked.erase(unique(picked.begin(), picked.end()), picked.end());
+
+    vector<double> lengths;
+    vector<double> elevations;
+    for (unsigned i : picked) {
+      lengths.push_back(track[i].length);
+      elevations.push_back(track[i].elevation);
+    }
+
+    if (level > 0) out << ",";
+    out << "\n{ \"size\": " << unsigned(picked.size())
+        << ",\n\"length\": [";
+    writeDeltas(out, lengths, LENGTH_SCALE);
+    out << "],\n\"elevation\": [";
+    writeDeltas(out, elevations, ELEVATION_SCALE);
+    out << "],\n\"climbs\": [";
+    for (unsigned i = 0; i < track.getClimbs().size(); i++) {
+      const Track::Climb& climb(track.getClimbs()[i]);
+      if (i > 0) out << ", ";
+      out << "{ \"start\": " << positionOf(picked, climb.getStartIndex())
+          << ", \"end\": " << positionOf(picked, climb.getEndIndex())
+          << " }";
+    }
+    out << "],\n\"difficult\": { \"start\": "
+        << positionOf(picked, difficultStart)
+        << ", \"end\": " << positionOf(picked, difficultEnd)
+        << ", \"score\": " << score << " } }";
+
+    // Any more levels would just repeat the whole track
+    if (picked.size() == track.size()) break;
+  }
+  out << "]\n}\n";
+}
+
+}  // namespace
+
+vector<unsigned> JSON::defaultLevels() {
+  return vector<unsigned>{ 250, 500, 1000, 2000, 4000 };
+}
+
+void JSON::write(ostream& stream, const Track& track, JSON::Options opt) {
+  OutputBuffer out(stream);
+  out.shortest(opt.shortest);
+
   if (!opt.callback.empty()) {
     out << opt.callback << "(";
   }
+  if (!opt.levels.empty()) {
+    writeLevels(out, track, opt);
+    if (!opt.callback.empty()) {
+      out << ");\n";
+    }
+    return;
+  }
   out << "{ \"points\": [";
   for (unsigned i = 0; i < track.size(); i++) {
-    if (i > 0) out << "," << endl;
+    if (i > 0) out << ",\n";
     out << "[" << track[i].length << "," << track[i].elevation << "]";
   }
-  out << "]," << endl;
-  out << "\"climbs\": [" << endl;
+  out << "],\n";
+  out << "\"climbs\": [\n";
   for (unsigned i = 0; i < track.getClimbs().size(); i++) {
     const Track::Climb & climb(track.getClimbs()[i]);
-    if (i > 0) out << "," << endl;
+    if (i > 0) out << ",\n";
     out << "{ \"start\": " << climb.getStart().seq
         << ", \"end\": " << climb.getEnd().seq << " }";
   }
-  out << "]," << endl;
+  out << "],\n";
   {
     int start = 0;
     int end = 0;
     double score = 0;
-    track.mostDifficult(1000, start, end, score);
+    track.mostDifficult(Track::kDifficultMeters, start, end, score);
     out << "\"difficult\": { \"start\": " << start
-        << ", \"end\": " << end << ", \"score\": " << score << "}"
-        << endl;
+        << ", \"end\": " << end << ", \"score\": " << score << "}\n";
   }
-  out << "}" << endl;
+  out << "}\n";
   if (!opt.callback.empty()) {
-    out << ");" << endl;
+    out << ");\n";
   }
 }
@@ -3,15 +3,26 @@
 
 #include <iosfwd>
 #include <string>
+#include <vector>
 
 class Track;
 
 class JSON {
 public:
   struct Options {
+    Options() {}
+
     std::string callback;
+    bool shortest = false;  // shortest exact numbers, not fixed precision
+
+    // If not empty, write a level of detail for each of these point
+    // counts, instead of every point. See display-track.js.
+    std::vector<unsigned> levels;
   };
 
+  // Levels of detail suited to canvases up to a few thousand pixels wide
+  static std::vector<unsigned> defaultLevels();
+
   static void write(std::ostream& out, const Track& track,
                     Options option = Options());
 };
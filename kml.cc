@@ -12,6 +12,7 @@
 #include "document.h"
 #include "track.h"
 #include "kml.h"
+#include "output.h"
 
 using namespace std;
 using namespace rapidxml;
@@ -120,16 +121,24 @@ void processDoc(Document& doc, Track& track) {
           for (const auto* gx_track = multitrack->first_node("gx:Track");
                gx_track != nullptr;
                gx_track = gx_track->next_sibling("gx:Track")) {
-            time_t last_timestamp = 0;
+            // The schema puts every <when> before the first <gx:coord>,
+            // but some files interleave them. Either way, the nth <when>
+            // belongs to the nth <gx:coord>.
+            vector<time_t> timestamps;
+            vector<const char*> coords;
             for (const auto* node = gx_track->first_node();
                  node != nullptr;
                  node = node->next_sibling()) {
               if (string("when") == node->name()) {
-                last_timestamp = parseTimestamp(node->value());
+                timestamps.push_back(parseTimestamp(node->value()));
               } else if (string("gx:coord") == node->name()) {
-                parseCoord(node->value(), last_timestamp, track);
+                coords.push_back(node->value());
               }
             }
+            for (unsigned i = 0; i < coords.size(); ++i) {
+              parseCoord(coords[i],
+                         i < timestamps.size() ? timestamps[i] : 0, track);
+            }
           }
         }
       }
@@ -137,41 +146,71 @@ void processDoc(Document& doc, Track& track) {
   }
 }
 
-void writePoint(ostream& out, const Point& point) {
+void writePoint(OutputBuffer& out, const Point& point) {
   out.precision(12);
   out << point.lon << "," << point.lat << ",";
   out.precision(6);
-  out << point.elevation << endl;
+  out << point.elevation << "\n";
+}
+
+void writeGxCoord(OutputBuffer& out, const Point& point) {
+  out.precision(12);
+  out << "<gx:coord>" << point.lon << " " << point.lat << " ";
+  out.precision(6);
+  out << point.elevation << "</gx:coord>\n";
 }
 
-void WriteSegment(ostream& out, const Track& track, int start, int end,
-                  const string& style, const string& name, const string& desc) {
-  out << "<Placemark>" << endl
-      << "<name>" << name << "</name>" << endl
-      << "<description>" << desc << "</description>" << endl
-      << "<styleUrl>" << style << "</styleUrl>" << endl
-      << "<LineString>" << endl
-      << "<extrude>false</extrude>" << endl
-      << "<tessellate>true</tessellate>" << endl
-      << "<altitudeMode>clampToGround</altitudeMode>" << endl
-      << "<coordinates>" << endl;
+void WriteSegment(OutputBuffer& out, const Track& track, int start, int end,
+                  const string& style, const string& name, const string& desc,
+                  const KML::Options& options) {
+  out << "<Placemark>\n"
+      << "<name>" << name << "</name>\n"
+      << "<description>" << desc << "</description>\n"
+      << "<styleUrl>" << style << "</styleUrl>\n";
+
+  if (options.timestamps) {
+    out << "<gx:MultiTrack><gx:Track>\n"
+        << "<altitudeMode>clampToGround</altitudeMode>\n";
+
+    TimestampFormatter formatter;
+    for (int i = start; i <= end; ++i) {
+      const char* when = formatter.format(track[i].timestamp);
+      out << "<when>";
+      out.append(when, formatter.length());
+      out << "</when>\n";
+    }
+    for (int i = start; i <= end; ++i) {
+      writeGxCoord(out, track[i]);
+    }
+
+    out << "</gx:Track></gx:MultiTrack></Placemark>\n";
+    return;
+  }
+
+  out << "<LineString>\n"
+      << "<extrude>false</extrude>\n"
+      << "<tessellate>true</tessellate>\n"
+      << "<altitudeMode>clampToGround</altitudeMode>\n"
+      << "<coordinates>\n";
 
   for (int i = start; i <= end; ++i) {
     writePoint(out, track[i]);
   }
 
-  out << "</coordinates></LineString></Placemark>" << endl;
+  out << "</coordinates></LineString></Placemark>\n";
 }
 
-void WriteFlat(ostream& out, const Track& track, unsigned start, unsigned end) {
-  WriteSegment(out, track, start, end, "#FlatStyle", "", "");
+void WriteFlat(OutputBuffer& out, const Track& track,
+               unsigned start, unsigned end, const KML::Options& options) {
+  WriteSegment(out, track, start, end, "#FlatStyle", "", "", options);
 }
 
-void WriteClimb(ostream& out, const Track& track, const Track::Climb& climb) {
+void WriteClimb(OutputBuffer& out, const Track& track,
+                const Track::Climb& climb, const KML::Options& options) {
   char desc[100];
   snprintf(desc, sizeof(desc), "%0.1lf%% average grade", climb.getGrade());
   WriteSegment(out, track, climb.getStartIndex(), climb.getEndIndex(),
-               "#ClimbStyle", "Climb", string(desc));
+               "#ClimbStyle", "Climb", string(desc), options);
 }
 
 }  // unnamed namespace
@@ -189,14 +228,19 @@ void KML::read(istream& in, Track& track) {
   processDoc(doc, track);
 }
 
-void KML::write(ostream& out, const Track& track, Options options) {
-  streamsize precision = out.precision();
+void KML::write(ostream& stream, const Track& track, Options options) {
+  OutputBuffer out(stream);
+  out.shortest(options.shortest);
 
   string name(track.getName());
   if (name.empty()) name = "Path";
 
-  out << R"(<?xml version="1.0" encoding="UTF-8"?>
-<kml xmlns="http://earth.google.com/kml/2.2">
+  out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      << "<kml xmlns=\"http://earth.google.com/kml/2.2\"";
+  if (options.timestamps) {
+    out << " xmlns:gx=\"http://www.google.com/kml/ext/2.2\"";
+  }
+  out << R"(>
 <Document>
 <name>)" << name << R"(</name>
 <Style id="FlatStyle">
@@ -206,7 +250,7 @@ void KML::write(ostream& out, const Track& track, Options options) {
   snprintf(buffer, sizeof(buffer), "%02x%06x", options.opacity, options.color);
 
   out << buffer << "</color><width>" << options.width
-      << "</width></LineStyle></Style>" << endl;
+      << "</width></LineStyle></Style>\n";
   out << R"(<Style id="ClimbStyle">
 <LineStyle><color>ff0000bb</color><width>2</width></LineStyle></Style>
 )";
@@ -215,13 +259,13 @@ void KML::write(ostream& out, const Track& track, Options options) {
   unsigned last_point = 0;
   for (const Track::Climb& climb : climbs) {
     if (climb.getStartIndex() > last_point) {
-      WriteFlat(out, track, last_point, climb.getStartIndex());
+      WriteFlat(out, track, last_point, climb.getStartIndex(), options);
     }
-    WriteClimb(out, track, climb);
+    WriteClimb(out, track, climb, options);
     last_point = climb.getEndIndex();
   }
   if (last_point <= (track.size() - 1)) {
-    WriteFlat(out, track, last_point, track.size() - 1);
+    WriteFlat(out, track, last_point, track.size() - 1, options);
   }
 
   if (options.startAndEnd && !track.empty()) {
@@ -236,7 +280,7 @@ void KML::write(ostream& out, const Track& track, Options options) {
     out << track.first().lon << "," << track.first().lat << ",";
     out.precision(6);
     out << track.first().elevation
-	<< "</coordinates></Point></Placemark>" << endl;
+	<< "</coordinates></Point></Placemark>\n";
         
     out << R"(<Placemark><name>End</name>
 <Style><IconStyle><scale>1.3</scale><Icon>
@@ -249,10 +293,8 @@ void KML::write(ostream& out, const Track& track, Options options) {
     out << track.last().lon << "," << track.last().lat << ",";
     out.precision(6);
     out << track.last().elevation
-	<< "</coordinates></Point></Placemark>" << endl;
+	<< "</coordinates></Point></Placemark>\n";
   }
 
-  out << "</Document>" << endl << "</kml>" << endl;
-
-  out.precision(precision);
+  out << "</Document>\n</kml>\n";
 }
@@ -22,6 +22,8 @@ public:
     double width = 2.0;        // width of the line
     uint32_t color = 0xbb0000; // color, as bgr (eg 0x0000ff == red)
     uint32_t opacity = 0xff;   // alpha of line: 0 (transparent) to 255 (opaque)
+    bool shortest = false;     // shortest exact numbers, not fixed precision
+    bool timestamps = false;   // write a gx:Track with <when>, not LineStrings
   };
 
   static void read(std::istream& in, Track& out);
@@ -0,0 +1,163 @@
+#include "output.h"
+
+#include "dtoa.h"
+#include "exception.h"
+
+#include <iostream>
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace std;
+
+OutputBuffer::OutputBuffer(ostream& o, size_t size)
+    : out(o), buffer(new char[size]), capacity(size), used(0),
+      digits(o.precision()), exact(false) {
+  PRECONDITION(size >= Dtoa::kBufferSize);
+}
+
+OutputBuffer::~OutputBuffer() {
+  flush();
+}
+
+void OutputBuffer::drain() {
+  if (used > 0) {
+    out.write(buffer.get(), used);
+    used = 0;
+  }
+}
+
+void OutputBuffer::flush() {
+  drain();
+  out.flush();
+}
+
+bool OutputBuffer::reserve(size_t len) {
+  if (capacity - used < len) drain();
+  return len <= capacity;
+}
+
+void OutputBuffer::append(const char* text, size_t len) {
+  if (reserve(len)) {
+    memcpy(buffer.get() + used, text, len);
+    used += len;
+  } else {
+    // Too big to buffer at all
+    out.write(text, len);
+  }
+}
+
+void OutputBuffer::append(const char* text) {
+  append(text, strlen(text));
+}
+
+void OutputBuffer::appendUnsigned(unsigned long long value) {
+  // Write the digits backwards into a scratch area, then copy
+  char scratch[24];
+  char* p = scratch + sizeof(scratch);
+  do {
+    *--p = '0' + (value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  append(p, (scratch + sizeof(scratch)) - p);
+}
+
+void OutputBuffer::appendInt(long long value) {
+  if (value < 0) {
+    append('-');
+    // Negate as unsigned, so the most negative value works
+    appendUnsigned(0ULL - static_cast<unsigned long long>(value));
+  } else {
+    appendUnsigned(value);
+  }
+}
+
+void OutputBuffer::appendDouble(double value, int precision) {
+  // An ostream with the default floatfield uses "%.*g", which is what
+  // Dtoa::significant matches. The buffer is always big enough to
+  // format straight into it.
+  reserve(Dtoa::kBufferSize);
+  used += Dtoa::significant(value, precision, buffer.get() + used);
+}
+
+void OutputBuffer::appendShortest(double value) {
+  reserve(Dtoa::kBufferSize);
+  used += Dtoa::shortest(value, buffer.get() + used);
+}
+
+// Offsets into the formatted text, "YYYY-MM-DDTHH:MM:SS.mmmZ"
+static const int kHourOffset = 11;
+static const int kMinuteOffset = 14;
+static const int kSecondOffset = 17;
+static const int kSuffixOffset = 19;
+
+static void writeTwoDigits(char* p, int value) {
+  p[0] = '0' + value / 10;
+  p[1] = '0' + value % 10;
+}
+
+TimestampFormatter::TimestampFormatter(bool milliseconds)
+    : withMillis(milliseconds), cached(false), dayStart(0), minuteStart(0),
+      len(0) {
+  text[0] = 0;
+}
+
+const char* TimestampFormatter::format(time_t t, int millis) {
+  PRECONDITION(millis >= 0 && millis < 1000);
+
+  if (!cached || t < dayStart || t >= dayStart + 86400) {
+    // A new day, so start over
+    struct tm time;
+    gmtime_r(&t, &time);
+    const int year = time.tm_year + 1900;
+
+    if (year < 0 || year > 9999) {
+      // Doesn't fit the fixed layout, so don't cache it
+      cached = false;
+      if (withMillis) {
+        len = snprintf(text, sizeof(text),
+                       "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+                       year, time.tm_mon + 1, time.tm_mday, time.tm_hour,
+                       time.tm_min, time.tm_sec, millis);
+      } else {
+        len = snprintf(text, sizeof(text), "%04d-%02d-%02dT%02d:%02d:%02dZ",
+                       year, time.tm_mon + 1, time.tm_mday, time.tm_hour,
+                       time.tm_min, time.tm_sec);
+      }
+      return text;
+    }
+
+    snprintf(text, sizeof(text), "%04d-%02d-%02dT",
+             year, time.tm_mon + 1, time.tm_mday);
+    text[kHourOffset + 2] = ':';
+    text[kMinuteOffset + 2] = ':';
+    if (withMillis) {
+      memcpy(text + kSuffixOffset, ".000Z", 6);
+      len = kSuffixOffset + 5;
+    } else {
+      memcpy(text + kSuffixOffset, "Z", 2);
+      len = kSuffixOffset + 1;
+    }
+
+    cached = true;
+    dayStart = t - (time.tm_hour * 3600 + time.tm_min * 60 + time.tm_sec);
+    minuteStart = dayStart - 60;  // Not this day, so it's rewritten below
+  }
+
+  if (t < minuteStart || t >= minuteStart + 60) {
+    const int seconds = t - dayStart;
+    minuteStart = t - seconds % 60;
+    writeTwoDigits(text + kHourOffset, seconds / 3600);
+    writeTwoDigits(text + kMinuteOffset, (seconds % 3600) / 60);
+  }
+
+  writeTwoDigits(text + kSecondOffset, t - minuteStart);
+
+  if (withMillis) {
+    text[kSuffixOffset + 1] = '0' + millis / 100;
+    writeTwoDigits(text + kSuffixOffset + 2, millis % 100);
+  }
+
+  return text;
+}
@@ -0,0 +1,124 @@
+#if !defined OUTPUT_H
+#define      OUTPUT_H
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+#include <stddef.h>
+#include <time.h>
+
+#include "util.h"
+
+// Collects text in a large buffer, and writes it to a stream only when
+// the buffer fills or on an explicit flush(). Unlike writing 'endl' to a
+// stream, ending a line doesn't flush anything.
+//
+// The << operators format values exactly as an ostream would, with
+// doubles written at the current precision() (like "%.*g"), unless
+// shortest() is set.
+class OutputBuffer : public NoCopy {
+ public:
+  static const size_t kDefaultCapacity = 64 * 1024;
+
+  explicit OutputBuffer(std::ostream& out,
+                        size_t capacity = kDefaultCapacity);
+
+  // Flushes anything remaining
+  ~OutputBuffer();
+
+  // Write the buffered text to the stream, and flush the stream.
+  void flush();
+
+  void append(const char* text, size_t len);
+  void append(const char* text);
+  void append(const std::string& text) { append(text.data(), text.size()); }
+  void append(char c) {
+    if (used == capacity) drain();
+    buffer[used++] = c;
+  }
+
+  void appendInt(long long value);
+  void appendUnsigned(unsigned long long value);
+
+  // Append a double with 'digits' significant digits, as an ostream with
+  // precision 'digits' would.
+  void appendDouble(double value, int digits);
+
+  // Append the shortest text that reads back as exactly 'value'.
+  void appendShortest(double value);
+
+  // The number of significant digits used by operator<< for doubles.
+  int precision() const { return digits; }
+  void precision(int d) { digits = d; }
+
+  // If true, operator<< writes doubles in the shortest exact form, and
+  // ignores precision().
+  bool shortest() const { return exact; }
+  void shortest(bool s) { exact = s; }
+
+  OutputBuffer& operator<<(const char* text) { append(text); return *this; }
+  OutputBuffer& operator<<(const std::string& text) {
+    append(text);
+    return *this;
+  }
+  OutputBuffer& operator<<(char c) { append(c); return *this; }
+  OutputBuffer& operator<<(int v) { appendInt(v); return *this; }
+  OutputBuffer& operator<<(long v) { appendInt(v); return *this; }
+  OutputBuffer& operator<<(long long v) { appendInt(v); return *this; }
+  OutputBuffer& operator<<(unsigned v) { appendUnsigned(v); return *this; }
+  OutputBuffer& operator<<(unsigned long v) {
+    appendUnsigned(v);
+    return *this;
+  }
+  OutputBuffer& operator<<(double v) {
+    if (exact) {
+      appendShortest(v);
+    } else {
+      appendDouble(v, digits);
+    }
+    return *this;
+  }
+
+ private:
+  // Write the buffered text to the stream, but don't flush the stream.
+  void drain();
+
+  // Make sure there's room for 'len' more characters, draining if
+  // necessary. Returns false if 'len' is larger than the whole buffer.
+  bool reserve(size_t len);
+
+  std::ostream& out;
+  std::unique_ptr<char[]> buffer;
+  size_t capacity;
+  size_t used;
+  int digits;
+  bool exact;
+};
+
+// Formats UTC timestamps as ISO 8601, like 2014-05-14T16:00:01Z, or
+// 2014-05-14T16:00:01.000Z with milliseconds. The date is kept from the
+// previous call, so timestamps on the same day (and particularly in the
+// same minute) only rewrite the time fields, without calling gmtime_r.
+// The text matches strftime's "%Y-%m-%dT%H:%M:%S".
+class TimestampFormatter {
+ public:
+  explicit TimestampFormatter(bool milliseconds = false);
+
+  // Format 't', with the given milliseconds if enabled. The result is
+  // null-terminated, and valid until the next call.
+  const char* format(time_t t, int millis = 0);
+
+  // The length of the last result
+  int length() const { return len; }
+
+ private:
+  bool withMillis;
+  bool cached;        // whether dayStart and minuteStart are valid
+  time_t dayStart;    // first second of the cached date
+  time_t minuteStart; // first second of the cached minute
+  int len;
+  char text[40];
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include "fit.h"
 #include "gpx.h"
 #include "kml.h"
+#include "profile.h"
 #include "text.h"
 #include "track.h"
 #include "util.h"
@@ -14,16 +15,8 @@
 using namespace std;
 
 void Parse::read(const std::string& filename, Track& track, Format format) {
-  if ((format == FORMAT_UNKNOWN) && !filename.empty()) {
-    if (Util::endsWith(filename, ".gpx")) {
-      format = FORMAT_GPX;
-    } else if (Util::endsWith(filename, ".fit")) {
-      format = FORMAT_FIT;
-    } else if (Util::endsWith(filename, ".kml")) {
-      format = FORMAT_KML;
-    } else if (Util::endsWith(filename, ".txt")) {
-      format = FORMAT_TEXT;
-    }
+  if (format == FORMAT_UNKNOWN) {
+    format = fileFormat(filename);
   }
 
   if (format == FORMAT_UNKNOWN) {
@@ -43,16 +36,65 @@ void Parse::read(const std::string& filename, Track& track, Format format) {
   }
   POSTCONDITION(in != 0);
 
+  read(*in, track, format);
+}
+
+void Parse::read(istream& in, Track& track, Format format) {
+  Profile::Timer timer("read", formatToString(format));
+  const size_t before = track.size();
+
+  // The bytes read, where the stream can tell. The readers may seek, so
+  // they aren't counted as they go.
+  const streampos start = timer.active() ? in.tellg() : streampos(-1);
+
   if (format == FORMAT_GPX) {
-    GPX::read(*in, track);
+    GPX::read(in, track);
   } else if (format == FORMAT_FIT) {
-    Fit::read(*in, track);
+    Fit::read(in, track);
   } else if (format == FORMAT_KML) {
-    KML::read(*in, track);
+    KML::read(in, track);
   } else if (format == FORMAT_TEXT) {
-    Text::read(*in, track);
+    Text::read(in, track);
+  } else {
+    throw Exception("Could not deduce input file format");
+  }
+
+  if (timer.active()) {
+    timer.points(Profile::kUnknown, track.size() - before);
+    if (start != streampos(-1)) {
+      in.clear();
+      const streampos end = in.tellg();
+      if (end != streampos(-1)) timer.bytes(end - start);
+    }
+  }
+}
+
+Parse::Format Parse::fileFormat(const std::string& filename) {
+  if (Util::endsWith(filename, ".gpx")) {
+    return FORMAT_GPX;
+  } else if (Util::endsWith(filename, ".fit")) {
+    return FORMAT_FIT;
+  } else if (Util::endsWith(filename, ".kml")) {
+    return FORMAT_KML;
+  } else if (Util::endsWith(filename, ".txt")) {
+    return FORMAT_TEXT;
   } else {
-    ASSERTION(false);
+    return FORMAT_UNKNOWN;
+  }
+}
+
+const char* Parse::formatToString(Format format) {
+  switch (format) {
+    case FORMAT_GPX: return "gpx";
+    case FORMAT_KML: return "kml";
+    case FORMAT_FIT: return "fit";
+    case FORMAT_TEXT: return "txt";
+    case FORMAT_PNG: return "png";
+    case FORMAT_JSON: return "json";
+    case FORMAT_GNUPLOT: return "gnuplot";
+    case FORMAT_GEOJSON: return "geojson";
+    case FORMAT_POLYLINE: return "polyline";
+    default: return "unknown";
   }
 }
 
@@ -71,6 +113,10 @@ Parse::Format Parse::stringToFormat(const std::string& format) {
     return FORMAT_JSON;
   } else if (format == "gnuplot") {
     return FORMAT_GNUPLOT;
+  } else if (format == "geojson") {
+    return FORMAT_GEOJSON;
+  } else if (format == "polyline") {
+    return FORMAT_POLYLINE;
   } else {
     return FORMAT_UNKNOWN;
   }
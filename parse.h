@@ -1,6 +1,7 @@
 #if !defined PARSE_H
 #define      PARSE_H
 
+#include <iosfwd>
 #include <string>
 
 class Track;
@@ -16,13 +17,24 @@ public:
     FORMAT_PNG,
     FORMAT_JSON,
     FORMAT_GNUPLOT,
+    FORMAT_GEOJSON,
+    FORMAT_POLYLINE,
     FORMAT_UNKNOWN
   };
 
   static void read(const std::string& filename, Track& track,
                    Format format = FORMAT_UNKNOWN);
 
+  // Read a track in the given format (which must be known) from 'in'
+  static void read(std::istream& in, Track& track, Format format);
+
   static Format stringToFormat(const std::string& format);
+
+  // The name stringToFormat takes for 'format', or "unknown"
+  static const char* formatToString(Format format);
+
+  // The input format implied by the filename's suffix, or FORMAT_UNKNOWN
+  static Format fileFormat(const std::string& filename);
 };
 
 #endif
@@ -2,7 +2,11 @@
 #include "track.h"
 #include "exception.h"
 
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
 #include <stdio.h>
 #include <math.h>
 
@@ -15,19 +19,87 @@ const double PI = 3.14159265359;
 const double MILES_PER_KM = 0.62137;
 const double FEET_PER_METER = 3.2808;
 
+// Sets up fontconfig and GD's font cache, once. GD would set up the
+// cache when it's first used, but not safely from several threads.
+static void setupFonts() {
+  static once_flag once;
+  call_once(once, [] {
+    gdFTUseFontConfig(1);
+    if (gdFontCacheSetup() != 0) {
+      throw Exception("Unable to set up the GD font cache");
+    }
+  });
+}
+
+// Remembers the bounds of text measured with gdImageStringFT, since each
+// measurement goes through FreeType. Most labels (tic values, axis
+// titles) are the same from one image to the next.
+class TextBounds {
+ public:
+  void measure(char* font, double pt, double angle, const char* text,
+               int rect[8]) {
+    char size[64];
+    snprintf(size, sizeof(size), "%g/%g/", pt, angle);
+    const string key = string(font) + "/" + size + text;
+
+    auto found = bounds.find(key);
+    if (found != bounds.end()) {
+      copy(found->second.begin(), found->second.end(), rect);
+      return;
+    }
+
+    const char* error = gdImageStringFT(nullptr, rect, 0, font, pt, angle,
+                                        0, 0, const_cast<char*>(text));
+    if (error == nullptr) {
+      if (bounds.size() >= kMaxEntries) bounds.clear();
+      copy(rect, rect + 8, bounds[key].begin());
+    }
+  }
+
+ private:
+  static const size_t kMaxEntries = 4096;
+
+  unordered_map<string, array<int, 8>> bounds;
+};
+
 class Image {
 public:
-  Image(PNG::Options inOpts) : ptr(0), options(inOpts) {
+  // Draw on a new image
+  explicit Image(PNG::Options inOpts)
+      : ptr(0), options(inOpts), owned(true), textBounds(nullptr) {
     top = left = bottom = right = 0;
     min = max = incr = subIncr = length = 0;
 
     ptr = gdImageCreateTrueColor(options.width, options.height);
     POSTCONDITION(ptr != 0);
 
-    gdFTUseFontConfig(1);
+    setupFonts();
   }
 
-  ~Image() { if (!ptr) gdImageDestroy(ptr); }
+  // Draw on an existing image of the right size, which this doesn't
+  // own, measuring text through 'bounds'
+  Image(PNG::Options inOpts, gdImagePtr canvas, TextBounds* bounds)
+      : ptr(canvas), options(inOpts), owned(false), textBounds(bounds) {
+    PRECONDITION(gdImageSX(canvas) == options.width);
+    PRECONDITION(gdImageSY(canvas) == options.height);
+
+    top = left = bottom = right = 0;
+    min = max = incr = subIncr = length = 0;
+
+    setupFonts();
+  }
+
+  ~Image() { if (ptr && owned) gdImageDestroy(ptr); }
+
+  // Fill 'rect' with the bounds of 'text', as gdImageStringFT would
+  void measure(double pt, double angle, const char* text, int rect[8]) const {
+    if (textBounds != nullptr) {
+      textBounds->measure(font(), pt, angle, text, rect);
+    } else {
+      gdImageStringFT(nullptr, rect, 0, font(), pt, angle, 0, 0,
+                      const_cast<char*>(text));
+    }
+  }
 
   // Return a non-const string to accommodate GD's general non-constness.
   char* font() const { return const_cast<char*>(options.font.c_str()); }
@@ -69,6 +141,9 @@ public:
   // Total length in meters.
   double length;
 
+  bool owned;               // whether to destroy 'ptr'
+  TextBounds* textBounds;   // may be null
+
   // Return the X position (in pixels) of a given data value
   int getX(double pos_in_meters) const {
     return (pos_in_meters / length) * (right - left) + left;
@@ -104,97 +179,140 @@ int intensity(int easy, int hard, double actual) {
   return (int) (easy * (1 - actual) + hard * actual);
 }
 
-void graphGrade(const Image& img, const Track& track, bool grade) {
-  if (track.empty()) return;
+// The points of a track that map to a single pixel column of the graph.
+// The graph is drawn from these, rather than from the points themselves,
+// so the cost of drawing depends on the width of the image, not the
+// length of the track.
+struct Column {
+  int x;
+  unsigned first;         // index of the first point in the column
+  unsigned count;         // number of points in the column
+  double totalElevation;  // for the average
+  double maxElevation;
+  double lastElevation;
+  double maxGrade;
+};
+
+// Reduce the track to the columns it occupies, from left to right.
+vector<Column> findColumns(const Image& img, const Track& track) {
+  vector<Column> columns;
+
+  for (unsigned i = 0; i < track.size(); ++i) {
+    const Point& point = track[i];
+    const int x = img.getX(point.length);
+
+    if (columns.empty() || columns.back().x != x) {
+      Column column;
+      column.x = x;
+      column.first = i;
+      column.count = 1;
+      column.totalElevation = point.elevation;
+      column.maxElevation = point.elevation;
+      column.lastElevation = point.elevation;
+      column.maxGrade = point.grade;
+      columns.push_back(column);
+    } else {
+      Column& column = columns.back();
+      ++column.count;
+      column.totalElevation += point.elevation;
+      column.maxElevation = std::max(column.maxElevation, point.elevation);
+      column.lastElevation = point.elevation;
+      column.maxGrade = std::max(column.maxGrade, point.grade);
+    }
+  }
+
+  return columns;
+}
+
+// Return the color that indicates the given grade
+int gradeColor(const Image& img, double grade) {
+  const int easy[3] = { 0x50, 0xb0, 0x50 };
+  const int hard[3] = { 0xff, 0x00, 0x00 };
+
+  // We're going to pick a color between "easy" and "hard". We'll
+  // arbitrarily set "easy" to < 1% grade, and "hard" to 12% or more.
+  // Grade is non-linear, so I'm going to square it (again,
+  // arbitrarily).  But since this makes lower-grade climbs
+  // indistinguishable from 'easy' in color, we're going to shift the
+  // numbers up in the color space.
+
+  const double MAXGRADE = 12;
+  double h = grade;
 
-  int prevX = 0;
-  int prevY = 0;
+  if (h < 1) h = 0;
+  if (h > MAXGRADE) h = MAXGRADE;
 
-  // Calculate the first point
-  prevX = img.left;
-  prevY = img.getY(track[0].elevation);
+  h = ((h+6) * (h+6)) / ((MAXGRADE+6)*(MAXGRADE+6));
+
+  POSTCONDITION(h >= 0);
+  POSTCONDITION(h <= 100);
+
+  // Now we choose a color some distance betwen "easy" and "hard"
+  return gdImageColorResolve(img.ptr,
+                             intensity(easy[0], hard[0], h),
+                             intensity(easy[1], hard[1], h),
+                             intensity(easy[2], hard[2], h));
+}
+
+void graphGrade(const Image& img, const Track& track,
+                const vector<Column>& columns, bool grade) {
+  if (columns.empty()) return;
+
+  // Start from the first point
+  int prevX = img.left;
+  int prevY = img.getY(track[0].elevation);
 
   gdPoint points[4];
 
-  int color = gdImageColorResolve(img.ptr, 0x50, 0xb0, 0x50);
-  int easy[3] = { 0x50, 0xb0, 0x50 };
-  int hard[3] = { 0xff, 0x00, 0x00 };
+  const int plain = gdImageColorResolve(img.ptr, 0x50, 0xb0, 0x50);
 
-  for (unsigned i = 0; i < track.size(); i++) {
-    int x = img.getX(track[i].length);
-    int y = img.getY(track[i].elevation);
+  for (const Column& column : columns) {
+    // Fill the area under the line from the previous column to the
+    // first point of this one
+    const Point& first = track[column.first];
+    const int y = img.getY(first.elevation);
 
     points[0].x = prevX;
     points[0].y = prevY;
 
-    points[1].x = x;
+    points[1].x = column.x;
     points[1].y = y;
 
-    points[2].x = x;
+    points[2].x = column.x;
     points[2].y = img.bottom;
 
     points[3].x = prevX;
     points[3].y = img.bottom;
 
-    if (grade) {
-      // We're going to pick a color between "easy" and "hard". We'll
-      // arbitrarily set "easy" to < 1% grade, and "hard" to 12% or more.
-      // Grade is non-linear, so I'm going to square it (again,
-      // arbitrarily).  But since this makes lower-grade climbs
-      // indistinguishable from 'easy' in color, we're going to shift the
-      // numbers up in the color space.
-
-      const double MAXGRADE = 12;
-      double h = track[i].grade;
-
-      if (h < 1) h = 0;
-      if (h > MAXGRADE) h = MAXGRADE;
-            
-      h = ((h+6) * (h+6)) / ((MAXGRADE+6)*(MAXGRADE+6));
-
-      POSTCONDITION(h >= 0);
-      POSTCONDITION(h <= 100);
-
-      // Now we choose a color some distance betwen "easy" and "hard"
-      color = gdImageColorResolve(img.ptr,
-                                  intensity(easy[0], hard[0], h),
-                                  intensity(easy[1], hard[1], h),
-                                  intensity(easy[2], hard[2], h));
-    }
+    gdImageFilledPolygon(img.ptr, points, 4,
+                         grade ? gradeColor(img, first.grade) : plain);
 
-    gdImageFilledPolygon(img.ptr, points, 4, color);
+    // Any other points in the column fill it from the highest point
+    // down, colored by the steepest grade.
+    if (column.count > 1) {
+      gdImageLine(img.ptr,
+                  column.x, img.getY(column.maxElevation),
+                  column.x, img.bottom,
+                  grade ? gradeColor(img, column.maxGrade) : plain);
+    }
 
-    prevX = x;
-    prevY = y;
+    prevX = column.x;
+    prevY = img.getY(column.lastElevation);
   }
 }
 
-void graphElevation(const Image& img, const Track& track,
-                    unsigned start, unsigned end, int color) {
-  PRECONDITION(start >= 0);
-  PRECONDITION(start < track.size());
-  PRECONDITION(end >= start);
-  PRECONDITION(end <= track.size());
-
+// Draw a line through the average elevation of each column
+void graphElevation(const Image& img, const vector<Column>& columns,
+                    int color) {
   gdImageSetThickness(img.ptr, 2);
   gdImageSetAntiAliased(img.ptr, color);
 
   int prev_x = -1;
   int prev_y = -1;
 
-  unsigned point = start;
-  while (point <= end) {
-    const int x = img.getX(track[point].length);
-    // Determine the average elevation of all points that map to x
-    double running_elevation = track[point].elevation;
-    int elevation_points = 1;
-    ++point;
-    while (point <= end && img.getX(track[point].length) == x) {
-      running_elevation += track[point].elevation;
-      ++elevation_points;
-      ++point;
-    }
-    const int y = img.getY(running_elevation / elevation_points);
+  for (const Column& column : columns) {
+    const int x = column.x;
+    const int y = img.getY(column.totalElevation / column.count);
 
     if (prev_x >= 0) {
       gdImageLine(img.ptr, prev_x, prev_y, x, y, gdAntiAliased);
@@ -246,7 +364,7 @@ void drawTicsY(const Image & img) {
     char buffer[100];
     snprintf(buffer, sizeof(buffer), "%g", ele);
 
-    gdImageStringFT(nullptr, rect, dark, img.font(), pt, 0, 0, 0, buffer);
+    img.measure(pt, 0, buffer, rect);
   
     gdImageStringFT(img.ptr, 0, dark, img.font(), pt, 0,
                     (img.left - rect[LRX_INDEX]) - 5,
@@ -263,8 +381,7 @@ void drawTicsY(const Image & img) {
     label = "elevation (meters)";
   }
 
-  gdImageStringFT(nullptr, rect, 0, img.font(), pt, PI/2,
-                  0, 0, const_cast<char*>(label));
+  img.measure(pt, PI/2, label, rect);
 
   gdImageStringFT(img.ptr, 0, dark, img.font(), pt, PI/2,
                   rect[LLX_INDEX] - rect[URX_INDEX],
@@ -295,7 +412,7 @@ void drawTicsX(const Image & img) {
     char buffer[100];
     snprintf(buffer, sizeof(buffer), "%g", tic);
 
-    gdImageStringFT(nullptr, rect, dark, img.font(), pt, 0, 0, 0, buffer);
+    img.measure(pt, 0, buffer, rect);
 
     const int x = (tic / length) * (img.right - img.left) + img.left;
     const int y = img.bottom + 6 - rect[URY_INDEX];
@@ -313,8 +430,7 @@ void drawTicsX(const Image & img) {
     label = "distance (kilometers)";
   }
 
-  gdImageStringFT(nullptr, rect, dark, img.font(), pt, 0, 0, 0,
-                  const_cast<char*>(label));
+  img.measure(pt, 0, label, rect);
 
   gdImageStringFT(img.ptr, 0, dark, img.font(), pt, 0,
                   (img.right + img.left) / 2 - rect[LRX_INDEX] / 2,
@@ -327,7 +443,7 @@ void drawDifficult(const Image& img, const Track& track) {
   int start = 0;
   int end = 0;
   double score = 0;
-  track.mostDifficult(1000, start, end, score);
+  track.mostDifficult(Track::kDifficultMeters, start, end, score);
 
   if (score > 0) {
     const int left_x = img.getX(track[start].length);
@@ -374,12 +490,11 @@ int calculateLeftBorder(const Image& img) {
   for (int tic = img.min; tic <= img.max; tic += img.incr) {
     char buffer[100];
     snprintf(buffer, sizeof(buffer), "%d", tic);
-    gdImageStringFT(0, rect, 0, img.font(), pt, 0, 0, 0, buffer);
+    img.measure(pt, 0, buffer, rect);
     right = std::max(right, rect[LRX_INDEX]);
   }
 
-  gdImageStringFT(nullptr, rect, 0, img.font(), pt, PI/2,
-                  0, 0, const_cast<char*>("elevation (meters)"));
+  img.measure(pt, PI/2, "elevation (meters)", rect);
 
   POSTCONDITION(rect[URX_INDEX] < 0);
   // Length of longest tic + height of label + buffers on both sides
@@ -391,25 +506,169 @@ int calculateBottomBorder(const Image& img) {
   const double pt = img.options.pointSize;
 
   // This is just a sample, assuming all the distance labels would be similar.
-  char* text = const_cast<char*>("10");
+  const char* text = "10";
 
-  gdImageStringFT(nullptr, rect, 0, img.font(), pt, 0, 0, 0, text);
+  img.measure(pt, 0, text, rect);
   POSTCONDITION(rect[URY_INDEX] < 0);
 
   const int border = rect[LLY_INDEX] - rect[URY_INDEX];
 
-  text = const_cast<char*>("distance (miles)");
-  gdImageStringFT(nullptr, rect, 0, img.font(), pt, 0, 0, 0, text);
+  text = "distance (miles)";
+  img.measure(pt, 0, text, rect);
 
   // tic height + label height + buffers on both sides
   return border + 5 + (rect[LLY_INDEX] - rect[URY_INDEX]) + 5;
 }
 
+// Colors for the tracks on a map, cycled if there are more tracks
+const int MAP_COLORS[][3] = {
+  { 0x94, 0x00, 0xd3 }, { 0x00, 0x9e, 0x73 }, { 0x56, 0xb4, 0xe9 },
+  { 0xe6, 0x9f, 0x00 }, { 0xf0, 0xe4, 0x42 }, { 0x00, 0x72, 0xb2 },
+  { 0xe5, 0x1e, 0x10 }, { 0x40, 0x40, 0x40 },
+};
+const int MAP_COLOR_COUNT = sizeof(MAP_COLORS) / sizeof(MAP_COLORS[0]);
+
+// Draws 'track' as a line, skipping any point that lands on the same
+// pixel as the last one drawn.
+void drawPath(gdImagePtr ptr, const Track& track, int color,
+              double minLon, double maxLat, double scaleX, double scaleY) {
+  int prev_x = -1;
+  int prev_y = -1;
+
+  for (const Point& p : track) {
+    const int x = (p.lon - minLon) * scaleX;
+    const int y = (maxLat - p.lat) * scaleY;
+    if (x == prev_x && y == prev_y) continue;
+
+    if (prev_x >= 0) {
+      gdImageLine(ptr, prev_x, prev_y, x, y, color);
+    }
+    prev_x = x;
+    prev_y = y;
+  }
+}
+
 }  // namespace
 
-void PNG::write(ostream& out, const Track& track, Options opt) {
+void PNG::writeMap(ostream& out, const vector<const Track*>& tracks,
+                   MapOptions mapOpt) {
+  PRECONDITION(mapOpt.width > 0 && mapOpt.height > 0);
+
+  PNG::Options opt;
+  opt.width = mapOpt.width;
+  opt.height = mapOpt.height;
+  opt.pointSize = mapOpt.pointSize;
+  opt.font = mapOpt.font;
   Image img(opt);
 
+  const int white = gdImageColorResolve(img.ptr, 0xFF, 0xFF, 0xFF);
+  gdImageFilledRectangle(img.ptr, 0, 0, opt.width - 1, opt.height - 1, white);
+
+  // Find the bounds of all the tracks
+  bool found = false;
+  double minLon = 0, maxLon = 0, minLat = 0, maxLat = 0;
+  for (const Track* track : tracks) {
+    if (track->empty()) continue;
+
+    double lon0, lon1, lat0, lat1;
+    track->getBounds(lon0, lon1, lat0, lat1);
+    if (!found) {
+      minLon = lon0;
+      maxLon = lon1;
+      minLat = lat0;
+      maxLat = lat1;
+      found = true;
+    } else {
+      minLon = std::min(minLon, lon0);
+      maxLon = std::max(maxLon, lon1);
+      minLat = std::min(minLat, lat0);
+      maxLat = std::max(maxLat, lat1);
+    }
+  }
+
+  if (found) {
+    // Leave a 5% margin (and avoid a zero-sized area), and keep the aspect
+    // ratio by shrinking longitude degrees according to the latitude.
+    const double margin =
+        std::max(0.05 * std::max(maxLon - minLon, maxLat - minLat), 0.001);
+    minLon -= margin;
+    maxLon += margin;
+    minLat -= margin;
+    maxLat += margin;
+
+    const double aspect = cos((minLat + maxLat) / 2 * PI / 180);
+    const double scale =
+        std::min((opt.width - 1) / ((maxLon - minLon) * aspect),
+                 (opt.height - 1) / (maxLat - minLat));
+
+    gdImageSetThickness(img.ptr, 2);
+    for (unsigned i = 0; i < tracks.size(); ++i) {
+      const int* rgb = MAP_COLORS[i % MAP_COLOR_COUNT];
+      const int color = gdImageColorResolve(img.ptr, rgb[0], rgb[1], rgb[2]);
+      drawPath(img.ptr, *tracks[i], color, minLon, maxLat,
+               scale * aspect, scale);
+    }
+    gdImageSetThickness(img.ptr, 1);
+  }
+
+  // Draw the legend in the top left corner
+  int rect[8];
+  int y = 10;
+  for (unsigned i = 0; i < tracks.size(); ++i) {
+    const int* rgb = MAP_COLORS[i % MAP_COLOR_COUNT];
+    const int color = gdImageColorResolve(img.ptr, rgb[0], rgb[1], rgb[2]);
+    char* name = const_cast<char*>(tracks[i]->getName().c_str());
+
+    img.measure(opt.pointSize, 0, name, rect);
+    y += rect[LLY_INDEX] - rect[URY_INDEX] + 4;
+    gdImageStringFT(img.ptr, 0, color, img.font(), opt.pointSize, 0,
+                    10, y, name);
+  }
+
+  gdSink sink;
+  sink.context = &out;
+  sink.sink = writeTo;
+
+  gdImagePngToSink(img.ptr, &sink);
+}
+
+// What a Renderer keeps from one image to the next
+struct PNG::Renderer::State {
+  State() : canvas(nullptr) {}
+  ~State() { if (canvas) gdImageDestroy(canvas); }
+
+  // Return a canvas of the given size, reusing the last one if possible.
+  // Every image is painted over completely, so it needn't be cleared.
+  gdImagePtr getCanvas(int width, int height) {
+    if (canvas != nullptr &&
+        (gdImageSX(canvas) != width || gdImageSY(canvas) != height)) {
+      gdImageDestroy(canvas);
+      canvas = nullptr;
+    }
+    if (canvas == nullptr) {
+      canvas = gdImageCreateTrueColor(width, height);
+      POSTCONDITION(canvas != nullptr);
+    }
+    return canvas;
+  }
+
+  gdImagePtr canvas;
+  TextBounds bounds;
+};
+
+PNG::Renderer::Renderer() : state(new State) {}
+
+PNG::Renderer::~Renderer() {}
+
+void PNG::write(ostream& out, const Track& track, Options opt) {
+  Renderer renderer;
+  renderer.write(out, track, opt);
+}
+
+void PNG::Renderer::write(ostream& out, const Track& track,
+                          const Options& opt) {
+  Image img(opt, state->getCanvas(opt.width, opt.height), &state->bounds);
+
   const int white = gdImageColorResolve(img.ptr, 0xFF, 0xFF, 0xFF);
   gdImageFilledRectangle(img.ptr,
                          0, 0, img.options.width - 1, img.options.height - 1,
@@ -475,10 +734,12 @@ void PNG::write(ostream& out, const Track& track, Options opt) {
     drawDifficult(img, track);
   }
 
-  graphGrade(img, track, opt.grade);
+  const vector<Column> columns = findColumns(img, track);
+
+  graphGrade(img, track, columns, opt.grade);
 
   const int elevationLine = gdImageColorResolve(img.ptr, 0x30, 0x50, 0x30);
-  graphElevation(img, track, 0, track.size() - 1, elevationLine);
+  graphElevation(img, columns, elevationLine);
 
   if (opt.climbs) {
     // Above we marked the climbs with an area "behind" the grade. In this
@@ -504,8 +765,7 @@ void PNG::write(ostream& out, const Track& track, Options opt) {
                grade);
 
       int rect[8];
-      gdImageStringFT(nullptr, rect, 0, img.font(),
-                      8, 0, 0, 0, buffer);
+      img.measure(8, 0, buffer, rect);
 
       // Mid-point of the climb - half width of the text
       const int x =
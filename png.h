@@ -3,7 +3,11 @@
 
 #include <cfloat>
 #include <iosfwd>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include "util.h"
 
 class Track;
 
@@ -32,8 +36,42 @@ public:
     std::string font = "helvetica";
   };
 
+  struct MapOptions {
+    MapOptions() {}
+
+    int width = 2000;
+    int height = 2000;
+    double pointSize = 12;  // Font size for the legend
+
+    std::string font = "helvetica";
+  };
+
   static void write(std::ostream& out, const Track& track,
                     Options opt = Options());
+
+  // Writes one profile after another, like write(), but keeps the canvas
+  // (while the image size stays the same) and the measurements of the
+  // labels from one image to the next. Use a Renderer per thread to
+  // write images in parallel.
+  class Renderer : public NoCopy {
+   public:
+    Renderer();
+    ~Renderer();
+
+    void write(std::ostream& out, const Track& track, const Options& opt);
+
+   private:
+    struct State;
+    std::unique_ptr<State> state;
+  };
+
+  // Draw the paths of the tracks on a plain map, each in its own color,
+  // with a legend of track names. The bounds are calculated from the
+  // tracks. Each track is reduced to the image's resolution as it's
+  // drawn, so the cost depends on the image size, not the track size.
+  static void writeMap(std::ostream& out,
+                       const std::vector<const Track*>& tracks,
+                       MapOptions opt = MapOptions());
 };
 
 #endif
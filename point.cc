@@ -1,5 +1,7 @@
 #include "point.h"
 
+#include "dtoa.h"
+
 #include <math.h>
 
 using namespace std;
@@ -34,20 +36,31 @@ bool Point::operator< (const Point & p) const {
   return (length < p.length);
 }
 
+namespace {
+
+// Write a double as an ostream with precision 16 would.
+void writeDouble(ostream& out, double value) {
+  char buffer[Dtoa::kBufferSize];
+  out.write(buffer, Dtoa::significant(value, 16, buffer));
+}
+
+}  // unnamed namespace
+
 ostream & operator << (ostream & out, const Point & p) {
-  streamsize s = out.precision();
-  out.precision(16);
-  out << p.lat << " "
-      << p.lon << " "
-      << p.elevation << " "
-      << p.timestamp << " "
-      << p.seq << " "
-      << p.hr << " "
-      << p.atemp << " "
-      << p.length << " "
-      << p.grade << " "
-      << p.velocity << " "
-      << p.climb;
-  out.precision(s);
+  writeDouble(out, p.lat);
+  out << " ";
+  writeDouble(out, p.lon);
+  out << " ";
+  writeDouble(out, p.elevation);
+  out << " " << p.timestamp << " " << p.seq << " " << p.hr << " ";
+  writeDouble(out, p.atemp);
+  out << " ";
+  writeDouble(out, p.length);
+  out << " ";
+  writeDouble(out, p.grade);
+  out << " ";
+  writeDouble(out, p.velocity);
+  out << " ";
+  writeDouble(out, p.climb);
   return out;
 }
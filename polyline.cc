@@ -0,0 +1,97 @@
+#include "polyline.h"
+
+#include "exception.h"
+#include "output.h"
+#include "track.h"
+
+#include <iostream>
+#include <vector>
+
+#include <math.h>
+
+using namespace std;
+
+namespace {
+
+// Append one signed value: zig-zag encoded, then in 5-bit chunks from the
+// lowest, each offset by 63, with 0x20 set on all but the last.
+void encode(OutputBuffer& out, long long value) {
+  unsigned long long bits = static_cast<unsigned long long>(value) << 1;
+  if (value < 0) bits = ~bits;
+  while (bits >= 0x20) {
+    out << static_cast<char>((0x20 | (bits & 0x1f)) + 63);
+    bits >>= 5;
+  }
+  out << static_cast<char>(bits + 63);
+}
+
+void writePolyline(OutputBuffer& out, const Track& track,
+                   unsigned start, unsigned end,
+                   const Polyline::Options& options) {
+  const double scale = pow(10, options.precision);
+  long long prevLat = 0;
+  long long prevLon = 0;
+
+  auto writePoint = [&](const Point& point) {
+    const long long lat = llround(point.lat * scale);
+    const long long lon = llround(point.lon * scale);
+    encode(out, lat - prevLat);
+    encode(out, lon - prevLon);
+    prevLat = lat;
+    prevLon = lon;
+  };
+
+  if (options.tolerance > 0) {
+    for (unsigned i : track.significantPoints(start, end,
+                                              options.tolerance)) {
+      writePoint(track[i]);
+    }
+  } else {
+    for (unsigned i = start; i <= end; ++i) {
+      writePoint(track[i]);
+    }
+  }
+  out << "\n";
+}
+
+void writeFlat(OutputBuffer& out, const Track& track,
+               unsigned start, unsigned end,
+               const Polyline::Options& options) {
+  out << "flat ";
+  writePolyline(out, track, start, end, options);
+}
+
+void writeClimb(OutputBuffer& out, const Track& track,
+                const Track::Climb& climb, const Polyline::Options& options) {
+  out << "climb ";
+  out.appendDouble(round(climb.getGrade() * 10) / 10, 6);
+  out << " ";
+  writePolyline(out, track, climb.getStartIndex(), climb.getEndIndex(),
+                options);
+}
+
+}  // unnamed namespace
+
+void Polyline::write(ostream& stream, const Track& track, Options options) {
+  PRECONDITION(options.precision >= 0 && options.precision <= 7);
+
+  OutputBuffer out(stream);
+  if (track.empty()) return;
+
+  if (!options.climbs) {
+    writePolyline(out, track, 0, track.size() - 1, options);
+    return;
+  }
+
+  unsigned last_point = 0;
+  for (const Track::Climb& climb : track.getClimbs()) {
+    if (climb.getStartIndex() > last_point) {
+      writeFlat(out, track, last_point, climb.getStartIndex(), options);
+    }
+    writeClimb(out, track, climb, options);
+    last_point = climb.getEndIndex();
+  }
+  if (last_point < track.size() - 1 || track.getClimbs().empty()) {
+    writeFlat(out, track, last_point, track.size() - 1, options);
+  }
+}
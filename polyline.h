@@ -0,0 +1,33 @@
+#if !defined POLYLINE_H
+#define      POLYLINE_H
+
+#include <iosfwd>
+
+class Track;
+
+// Writes a track in Google's encoded polyline format: the latitude and
+// longitude of each point, as a difference from the previous point,
+// encoded in printable characters.
+//
+// By default the track is split like KML, with one line for each climb
+// and each flat section between them:
+//
+//   flat <polyline>
+//   climb <grade> <polyline>
+//
+// Without 'climbs', the output is just the polyline for the whole track.
+class Polyline {
+public:
+  struct Options {
+    Options() {}
+
+    bool climbs = true;      // a line for each climb and flat section
+    double tolerance = 0;    // simplify to within this many meters; 0 = off
+    int precision = 5;       // decimal places of the degrees; 6 for polyline6
+  };
+
+  static void write(std::ostream& out, const Track& track,
+                    Options options = Options());
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include "profile.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <stdio.h>
+
+using namespace std;
+
+namespace {
+
+thread_local Profile* currentProfile = nullptr;
+
+// How many timers are running on this thread, for each stage's depth
+thread_local unsigned running = 0;
+
+// A count for the table, or "-" if it wasn't given
+string count(size_t value) {
+  return value == Profile::kUnknown ? "-" : to_string(value);
+}
+
+string jsonString(const string& value) {
+  string quoted = "\"";
+  for (char c : value) {
+    if (c == '"' || c == '\\') quoted += '\\';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+// Add 'value' to 'total', unless either wasn't given
+void accumulate(size_t& total, size_t value) {
+  if (value == Profile::kUnknown) return;
+  total = (total == Profile::kUnknown) ? value : total + value;
+}
+
+}  // namespace
+
+Profile::Use::Use(Profile* profile) : previous(currentProfile) {
+  currentProfile = profile;
+}
+
+Profile::Use::~Use() {
+  currentProfile = previous;
+}
+
+Profile::Timer::Timer(const char* stage, const char* about)
+    : profile(currentProfile), name(stage), detail(about) {
+  if (profile == nullptr) return;
+  ++running;
+  allocated = Allocations::onThisThread();
+  start = chrono::steady_clock::now();
+}
+
+Profile::Timer::~Timer() {
+  if (profile == nullptr) return;
+
+  const chrono::steady_clock::time_point end = chrono::steady_clock::now();
+  const Allocations::Counts now = Allocations::onThisThread();
+  --running;
+
+  Stage stage;
+  stage.name = name;
+  if (detail != nullptr) {
+    stage.name += " ";
+    stage.name += detail;
+  }
+  stage.depth = running;
+  stage.start = chrono::duration<double>(start - profile->begin).count();
+  stage.seconds = chrono::duration<double>(end - start).count();
+  stage.pointsIn = pointsIn;
+  stage.pointsOut = pointsOut;
+  stage.bytes = byteCount;
+  if (Allocations::counting()) {
+    stage.allocations = now.allocations - allocated.allocations;
+    stage.allocatedBytes = now.bytes - allocated.bytes;
+  }
+
+  // A destructor mustn't throw, and a stage that can't be kept only
+  // leaves a gap in the table
+  try {
+    profile->add(stage);
+  } catch (...) {
+  }
+}
+
+Profile::CountingBuffer::int_type Profile::CountingBuffer::overflow(
+    int_type c) {
+  if (traits_type::eq_int_type(c, traits_type::eof())) {
+    return traits_type::not_eof(c);
+  }
+  const int_type result = destination->sputc(traits_type::to_char_type(c));
+  if (!traits_type::eq_int_type(result, traits_type::eof())) ++written;
+  return result;
+}
+
+streamsize Profile::CountingBuffer::xsputn(const char* s, streamsize n) {
+  const streamsize result = destination->sputn(s, n);
+  written += result;
+  return result;
+}
+
+int Profile::CountingBuffer::sync() {
+  return destination->pubsync();
+}
+
+Profile::Profile() : begin(chrono::steady_clock::now()) {}
+
+Profile* Profile::current() {
+  return currentProfile;
+}
+
+void Profile::add(Stage& stage) {
+  const thread::id id = this_thread::get_id();
+
+  lock_guard<mutex> guard(lock);
+  stage.thread = find(threads.begin(), threads.end(), id) - threads.begin();
+  if (stage.thread == threads.size()) threads.push_back(id);
+  stages.push_back(stage);
+}
+
+vector<Profile::Stage> Profile::getStages() const {
+  lock_guard<mutex> guard(lock);
+  return stages;
+}
+
+void Profile::writeTable(ostream& out) const {
+  vector<Stage> all = getStages();
+  stable_sort(all.begin(), all.end(), [](const Stage& a, const Stage& b) {
+    return a.start < b.start;
+  });
+
+  // The stages of each name, added up
+  struct Row {
+    Stage total;
+    unsigned calls = 0;
+  };
+  vector<Row> rows;
+  for (const Stage& stage : all) {
+    auto row = find_if(rows.begin(), rows.end(), [&](const Row& r) {
+      return r.total.name == stage.name;
+    });
+    if (row == rows.end()) {
+      rows.push_back(Row());
+      row = rows.end() - 1;
+      row->total.name = stage.name;
+      row->total.depth = stage.depth;
+    }
+    ++row->calls;
+    row->total.seconds += stage.seconds;
+    accumulate(row->total.pointsIn, stage.pointsIn);
+    accumulate(row->total.pointsOut, stage.pointsOut);
+    accumulate(row->total.bytes, stage.bytes);
+    accumulate(row->total.allocations, stage.allocations);
+    accumulate(row->total.allocatedBytes, stage.allocatedBytes);
+  }
+
+  // The allocations are only shown where they're counted
+  const bool allocations = Allocations::counting();
+  char line[256];
+  snprintf(line, sizeof(line), "%-32s %6s %11s %11s %11s %12s",
+           "Stage", "Calls", "Wall ms", "Points in", "Points out", "Bytes");
+  out << line;
+  if (allocations) {
+    snprintf(line, sizeof(line), " %10s %12s", "Allocs", "Alloc bytes");
+    out << line;
+  }
+  out << "\n";
+
+  for (const Row& row : rows) {
+    const string name = string(2 * row.total.depth, ' ') + row.total.name;
+    snprintf(line, sizeof(line), "%-32s %6u %11.3f %11s %11s %12s",
+             name.c_str(), row.calls, row.total.seconds * 1000,
+             count(row.total.pointsIn).c_str(),
+             count(row.total.pointsOut).c_str(),
+             count(row.total.bytes).c_str());
+    out << line;
+    if (allocations) {
+      snprintf(line, sizeof(line), " %10s %12s",
+               count(row.total.allocations).c_str(),
+               count(row.total.allocatedBytes).c_str());
+      out << line;
+    }
+    out << "\n";
+  }
+
+  const double elapsed = chrono::duration<double>(
+      chrono::steady_clock::now() - begin).count();
+  snprintf(line, sizeof(line), "%-32s %6s %11.3f\n", "Total", "",
+           elapsed * 1000);
+  out << line;
+
+  const uint64_t peak = Allocations::peakResident();
+  if (peak > 0) {
+    out << "Peak resident memory: " << (peak + 1023) / 1024 << " KB\n";
+  }
+}
+
+void Profile::writeTrace(ostream& out) const {
+  const vector<Stage> all = getStages();
+
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  for (size_t i = 0; i < all.size(); ++i) {
+    const Stage& stage = all[i];
+    char times[64];
+    snprintf(times, sizeof(times), "\"ts\": %.3f, \"dur\": %.3f",
+             stage.start * 1e6, stage.seconds * 1e6);
+
+    out << (i == 0 ? "\n" : ",\n")
+        << "  {\"name\": " << jsonString(stage.name)
+        << ", \"cat\": \"track\", \"ph\": \"X\", " << times
+        << ", \"pid\": 1, \"tid\": " << stage.thread + 1 << ", \"args\": {";
+    const char* separator = "";
+    if (stage.pointsIn != kUnknown) {
+      out << separator << "\"points_in\": " << stage.pointsIn;
+      separator = ", ";
+    }
+    if (stage.pointsOut != kUnknown) {
+      out << separator << "\"points_out\": " << stage.pointsOut;
+      separator = ", ";
+    }
+    if (stage.bytes != kUnknown) {
+      out << separator << "\"bytes\": " << stage.bytes;
+      separator = ", ";
+    }
+    if (stage.allocations != kUnknown) {
+      out << separator << "\"allocations\": " << stage.allocations
+          << ", \"allocated_bytes\": " << stage.allocatedBytes;
+    }
+    out << "}}";
+  }
+  out << "\n]}\n";
+}
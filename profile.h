@@ -0,0 +1,128 @@
+#if !defined PROFILE_H
+#define      PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+#include <iosfwd>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "allocations.h"
+#include "util.h"
+
+// Times the stages of a run (reading, each calculation, each output),
+// for 'track -T'. A Profile is made current on a thread with Use, and a
+// Timer in scope on that thread adds a stage to it: its wall time by the
+// monotonic clock, the points and bytes it was given, and what it
+// allocated on its thread, where that's counted. Without a current
+// Profile, a Timer only checks for one, so stages can be timed everywhere
+// at almost no cost.
+//
+// Stages may be timed on several threads at once, each using the same
+// Profile.
+class Profile : public NoCopy {
+ public:
+  // A count that wasn't given
+  static const size_t kUnknown = SIZE_MAX;
+
+  struct Stage {
+    std::string name;
+    unsigned thread = 0;  // in the order threads were first seen
+    unsigned depth = 0;   // how many stages it's within, on its thread
+    double start = 0;     // seconds since the Profile was made
+    double seconds = 0;
+    size_t pointsIn = kUnknown;
+    size_t pointsOut = kUnknown;
+    size_t bytes = kUnknown;  // read or written
+    size_t allocations = kUnknown;     // if Allocations::counting()
+    size_t allocatedBytes = kUnknown;
+  };
+
+  // Make a Profile current on this thread while in scope. A null one
+  // turns profiling off.
+  class Use : public NoCopy {
+   public:
+    explicit Use(Profile* profile);
+    ~Use();
+
+   private:
+    Profile* previous;
+  };
+
+  // Time a stage, from here to the end of the scope. 'name' and
+  // 'detail' (added after a space, like the format) must outlast it.
+  class Timer : public NoCopy {
+   public:
+    explicit Timer(const char* name, const char* detail = nullptr);
+    ~Timer();
+
+    // Whether the stage is being timed, so counts are worth finding
+    bool active() const { return profile != nullptr; }
+
+    void points(size_t in, size_t out) {
+      pointsIn = in;
+      pointsOut = out;
+    }
+    void bytes(size_t count) { byteCount = count; }
+
+   private:
+    Profile* const profile;
+    const char* name;
+    const char* detail;
+    std::chrono::steady_clock::time_point start;
+    Allocations::Counts allocated;  // on this thread, when it started
+    size_t pointsIn = kUnknown;
+    size_t pointsOut = kUnknown;
+    size_t byteCount = kUnknown;
+  };
+
+  // Passes everything written through to another stream buffer, counting
+  // the bytes, for the size of an output.
+  class CountingBuffer : public std::streambuf {
+   public:
+    explicit CountingBuffer(std::streambuf* target)
+        : destination(target) {}
+
+    size_t count() const { return written; }
+
+   protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+    int sync() override;
+
+   private:
+    std::streambuf* destination;
+    size_t written = 0;
+  };
+
+  Profile();
+
+  // The Profile current on this thread, or null
+  static Profile* current();
+
+  // The stages, in the order they finished
+  std::vector<Stage> getStages() const;
+
+  // Write a table of the stages, with those of the same name together,
+  // in the order they first started, and the peak memory used
+  void writeTable(std::ostream& out) const;
+
+  // Write each stage as a Chrome trace event, in JSON, for
+  // chrome://tracing or Perfetto
+  void writeTrace(std::ostream& out) const;
+
+ private:
+  void add(Stage& stage);
+
+  const std::chrono::steady_clock::time_point begin;
+  mutable std::mutex lock;
+  std::vector<Stage> stages;
+  std::vector<std::thread::id> threads;
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include "remote.h"
+
+#include "exception.h"
+#include "util.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Builds the body of a message
+class Encoder {
+ public:
+  void add(uint32_t value) {
+    body.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  void add(const string& text) {
+    add(static_cast<uint32_t>(text.size()));
+    body.append(text);
+  }
+
+  void add(const vector<string>& list) {
+    add(static_cast<uint32_t>(list.size()));
+    for (const string& text : list) add(text);
+  }
+
+  const string& get() const { return body; }
+
+ private:
+  string body;
+};
+
+// Takes apart the body of a message, failing if it's too short
+class Decoder {
+ public:
+  explicit Decoder(const string& b) : body(b), offset(0) {}
+
+  uint32_t getInt() {
+    uint32_t value;
+    need(sizeof(value));
+    memcpy(&value, body.data() + offset, sizeof(value));
+    offset += sizeof(value);
+    return value;
+  }
+
+  string getString() {
+    const uint32_t len = getInt();
+    need(len);
+    const string text(body, offset, len);
+    offset += len;
+    return text;
+  }
+
+  vector<string> getList() {
+    const uint32_t count = getInt();
+    // Every entry takes at least its length
+    need(static_cast<size_t>(count) * sizeof(uint32_t));
+    vector<string> list;
+    for (uint32_t i = 0; i < count; ++i) {
+      list.push_back(getString());
+    }
+    return list;
+  }
+
+  void finish() const {
+    if (offset != body.size()) {
+      throw Exception("Malformed trackd message (extra data)");
+    }
+  }
+
+ private:
+  void need(size_t len) const {
+    if (body.size() - offset < len) {
+      throw Exception("Malformed trackd message (truncated)");
+    }
+  }
+
+  const string& body;
+  size_t offset;
+};
+
+void writeAll(int socket, const char* data, size_t len) {
+  while (len > 0) {
+    const ssize_t rc = ::send(socket, data, len, MSG_NOSIGNAL);
+    if (rc < 0) {
+      if (errno == EINTR) continue;
+      throw SystemException(errno, "Writing to trackd socket");
+    }
+    data += rc;
+    len -= rc;
+  }
+}
+
+// Returns the number of bytes read, which is less than 'len' only at the
+// end of the stream
+size_t readAll(int socket, char* data, size_t len) {
+  size_t total = 0;
+  while (total < len) {
+    const ssize_t rc = ::read(socket, data + total, len - total);
+    if (rc < 0) {
+      if (errno == EINTR) continue;
+      throw SystemException(errno, "Reading from trackd socket");
+    }
+    if (rc == 0) break;
+    total += rc;
+  }
+  return total;
+}
+
+void sendMessage(int socket, const string& body) {
+  PRECONDITION(body.size() <= Remote::kMaxMessage);
+
+  const uint32_t len = body.size();
+  writeAll(socket, reinterpret_cast<const char*>(&len), sizeof(len));
+  writeAll(socket, body.data(), body.size());
+}
+
+bool receiveMessage(int socket, string& body) {
+  uint32_t len = 0;
+  const size_t got = readAll(socket, reinterpret_cast<char*>(&len),
+                             sizeof(len));
+  if (got == 0) return false;
+  if (got < sizeof(len)) {
+    throw Exception("trackd connection closed in the middle of a message");
+  }
+  if (len > Remote::kMaxMessage) {
+    throw Exception("trackd message too long");
+  }
+
+  body.resize(len);
+  if (len > 0 && readAll(socket, &body[0], len) < len) {
+    throw Exception("trackd connection closed in the middle of a message");
+  }
+  return true;
+}
+
+// Fill in a UNIX domain socket address for 'path'
+void setAddress(const string& path, sockaddr_un& address) {
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+    throw Exception("Invalid trackd socket path: " + path);
+  }
+  memcpy(address.sun_path, path.data(), path.size());
+}
+
+}  // namespace
+
+void Remote::send(int socket, const Request& request) {
+  Encoder message;
+  message.add(request.id);
+  message.add(request.args);
+  message.add(request.input);
+  sendMessage(socket, message.get());
+}
+
+void Remote::send(int socket, const Response& response) {
+  Encoder message;
+  message.add(response.id);
+  message.add(static_cast<uint32_t>(response.status));
+  message.add(response.messages);
+  message.add(response.outputs);
+  sendMessage(socket, message.get());
+}
+
+bool Remote::receive(int socket, Request& request) {
+  string body;
+  if (!receiveMessage(socket, body)) return false;
+
+  Decoder message(body);
+  request.id = message.getInt();
+  request.args = message.getList();
+  request.input = message.getString();
+  message.finish();
+  return true;
+}
+
+bool Remote::receive(int socket, Response& response) {
+  string body;
+  if (!receiveMessage(socket, body)) return false;
+
+  Decoder message(body);
+  response.id = message.getInt();
+  response.status = static_cast<int32_t>(message.getInt());
+  response.messages = message.getString();
+  response.outputs = message.getList();
+  message.finish();
+  return true;
+}
+
+int Remote::connect(const string& path) {
+  sockaddr_un address;
+  setAddress(path, address);
+
+  Descriptor socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+  SystemException::check(socket.get(), "Creating trackd socket");
+  SystemException::check(
+      ::connect(socket.get(), reinterpret_cast<sockaddr*>(&address),
+                sizeof(address)),
+      "Connecting to " + path);
+  return socket.release();
+}
+
+int Remote::listen(const string& path) {
+  sockaddr_un address;
+  setAddress(path, address);
+
+  // Only ever remove a socket, not some other file given by mistake, and
+  // only one nothing is listening on any more. A trackd still running
+  // would otherwise keep running, but be out of reach.
+  struct stat info;
+  if (::lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+    Descriptor probe(::socket(AF_UNIX, SOCK_STREAM, 0));
+    SystemException::check(probe.get(), "Creating trackd socket");
+    if (::connect(probe.get(), reinterpret_cast<sockaddr*>(&address),
+                  sizeof(address)) == 0) {
+      throw Exception("trackd is already running on " + path);
+    }
+    if (errno != ECONNREFUSED) {
+      throw SystemException(errno, "Checking for a trackd on " + path);
+    }
+    SystemException::check(::unlink(path.c_str()), "Removing " + path);
+  }
+
+  Descriptor socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+  SystemException::check(socket.get(), "Creating trackd socket");
+  SystemException::check(
+      ::bind(socket.get(), reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)),
+      "Binding " + path);
+  SystemException::check(::listen(socket.get(), SOMAXCONN),
+                         "Listening on " + path);
+  return socket.release();
+}
@@ -0,0 +1,58 @@
+#if !defined REMOTE_H
+#define      REMOTE_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+// Running 'track' commands in trackd, over a UNIX domain socket.
+//
+// A client sends requests, each with a command line and the contents of
+// its input file, and may send more before the responses arrive. Each
+// response carries the id of its request, with the exit status, what
+// 'track' would have written to stderr, and the contents of each -o
+// output, in order. Responses may come back in any order.
+//
+// Every message is a 32-bit length and then that many bytes. Integers
+// are in the host's byte order, since both ends are on the same machine.
+class Remote {
+ public:
+  struct Request {
+    Request() {}
+
+    uint32_t id = 0;
+    std::vector<std::string> args;  // the command line, from argv[0]
+    std::string input;
+  };
+
+  struct Response {
+    Response() {}
+
+    uint32_t id = 0;
+    int32_t status = 0;
+    std::string messages;
+    std::vector<std::string> outputs;
+  };
+
+  // The longest message accepted
+  static const uint32_t kMaxMessage = 1u << 30;
+
+  static void send(int socket, const Request& request);
+  static void send(int socket, const Response& response);
+
+  // Read the next message, or return false if the other end closed the
+  // connection instead. Throws an Exception for a malformed message.
+  static bool receive(int socket, Request& request);
+  static bool receive(int socket, Response& response);
+
+  // Connect to the socket at 'path', returning the descriptor
+  static int connect(const std::string& path);
+
+  // Create a socket at 'path' and listen on it, returning the
+  // descriptor. A socket left at 'path' by an earlier server is replaced,
+  // but if a server is still listening on it, this throws an Exception.
+  static int listen(const std::string& path);
+};
+
+#endif
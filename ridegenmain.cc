@@ -0,0 +1,129 @@
+// ridegen: makes up rides (see synthetic.h) and writes them as GPX, KML or
+// text, for a corpus to test and time the readers and writers with.
+//
+//   ridegen [-n <points>] [-t <terrain>] [-s <seed>] [-c <count>] <file>...
+
+#include "exception.h"
+#include "parse.h"
+#include "synthetic.h"
+#include "track.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void usage() {
+  cerr << "Usage: ridegen [-n <points>] [-t <terrain>] [-s <seed>]"
+       << " [-c <count>] <file>..." << endl
+       << "Options:" << endl
+       << "             -n <points> (one a second; default 3600)" << endl
+       << "             -t <terrain> (flat, rolling, hilly, mountainous;"
+       << " default rolling)" << endl
+       << "             -s <int> (random seed of the first ride; default 1)"
+       << endl
+       << "             -c <count> (rides; more than one are written as"
+       << " <name>-<n>.<suffix>)" << endl
+       << "Each file is written in the format of its suffix: .gpx, .kml or"
+       << " .txt" << endl;
+}
+
+// 'filename' with "-<index>" before its suffix
+string numbered(const string& filename, int index) {
+  string::size_type dot = filename.rfind('.');
+  const string::size_type slash = filename.rfind('/');
+  if (dot == string::npos || (slash != string::npos && dot < slash)) {
+    dot = filename.size();
+  }
+  return filename.substr(0, dot) + "-" + to_string(index) +
+      filename.substr(dot);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  try {
+    Synthetic::Options options;
+    long points = 3600;
+    long count = 1;
+
+    while (true) {
+      const int opt = getopt(argc, argv, "n:t:s:c:");
+      if (opt == -1) break;
+
+      switch (opt) {
+        case 'n':
+          points = strtol(optarg, 0, 0);
+          if (points < 1) throw Exception("-n (points) must be positive");
+          break;
+
+        case 't':
+          options.terrain = Synthetic::findTerrain(optarg);
+          break;
+
+        case 's':
+          options.seed = strtoul(optarg, 0, 0);
+          break;
+
+        case 'c':
+          count = strtol(optarg, 0, 0);
+          if (count < 1) throw Exception("-c (count) must be positive");
+          break;
+
+        default:
+          throw Exception("Unknown option");
+      }
+    }
+    if (optind == argc) throw Exception("No files given");
+
+    const vector<string> filenames(argv + optind, argv + argc);
+    vector<Parse::Format> formats;
+    for (const string& filename : filenames) {
+      const Parse::Format format = Parse::fileFormat(filename);
+      if (format == Parse::FORMAT_UNKNOWN) {
+        throw Exception("Unknown format for " + filename);
+      }
+      if (format == Parse::FORMAT_FIT) {
+        throw Exception("Unable to write FIT files yet: " + filename);
+      }
+      formats.push_back(format);
+    }
+
+    Track track;
+    for (long i = 0; i < count; ++i) {
+      // Each ride a different one, on a different day
+      Synthetic::Options ride = options;
+      ride.seed = options.seed + i;
+      ride.start = options.start + i * 24 * 60 * 60;
+      Synthetic::generate(track, points, ride);
+
+      for (size_t f = 0; f < filenames.size(); ++f) {
+        const string filename =
+            count > 1 ? numbered(filenames[f], i + 1) : filenames[f];
+        ofstream out(filename.c_str(), ios::out | ios::trunc);
+        if (!out) throw SystemException(errno, "Unable to open " + filename);
+
+        Synthetic::write(out, track, formats[f]);
+        out.close();
+        if (!out) throw SystemException(errno, "Unable to write " + filename);
+      }
+    }
+    return 0;
+
+  } catch (const std::exception& e) {
+    cerr << e.what() << endl;
+  } catch (...) {
+    cerr << "Unknown exception in main" << endl;
+  }
+
+  usage();
+  return 1;
+}
@@ -13,11 +13,19 @@ the comparison with regard to a single point if you find a close-enough point.
 And you can abort the whole comparison if you don't find a point very close
 at all.
 
+With -f, tracks are instead compared in order, using the discrete
+Frechet distance between them. That tells apart a loop ridden in
+opposite directions, or an out-and-back and its reverse. It's
+near-linear per pair, since points are only paired within a band
+along the track, and a comparison stops as soon as it's clear the
+tracks differ by more than the threshold.
+
 ***********************************************************************/
 
 #include "dir.h"
 #include "exception.h"
 #include "parse.h"
+#include "png.h"
 #include "track.h"
 #include "util.h"
 
@@ -27,10 +35,37 @@ at all.
 #include <string>
 #include <vector>
 
+#include <stdlib.h>
+#include <unistd.h>
+
 using namespace std;
 
 namespace {
 
+// If positive, compare tracks in order, and consider them equal if the
+// Frechet distance is no more than this many meters.
+double frechet_threshold = 0;
+
+// Write each cluster directly to cluster_<n>.png, rather than writing a
+// gnuplot script.
+bool write_png = false;
+
+// Spacing of resampled points, and width of the band along the track in
+// which points may be paired, for the ordered comparison (meters).
+const double kFrechetSpacing = 25;
+const double kFrechetBand = 1000;
+
+void usage() {
+  cerr << "Usage: sameroute [-f <meters>] [-p] <input-files>" << endl
+       << "Options:" << endl
+       << "             -f <meters> (compare in order, using the Frechet"
+       << endl
+       << "                distance, with the given threshold)" << endl
+       << "             -p (write cluster_<n>.png files, rather than a"
+       << endl
+       << "                gnuplot script)" << endl;
+}
+
 // Returns the ratio (0 .. 1.0) of points in 'left' that are close to
 // points in 'right'.
 double trackDistance(const Track& left, const Track& right,
@@ -92,8 +127,25 @@ struct Result {
   double right_ratio;
 };
 
+// Compare the tracks in order. This can only decide whether or not
+// they're equal, so the ratios are 1 or 0.
+Result compareOrdered(const Track& left, const Track& right) {
+  Result result;
+  const double d = left.frechetDistance(right, kFrechetSpacing,
+                                        kFrechetBand, frechet_threshold);
+  if (d <= frechet_threshold) {
+    result.judgement = Result::RESULT_EQUAL;
+    result.left_ratio = result.right_ratio = 1;
+  } else {
+    result.judgement = Result::RESULT_NONE;
+    result.left_ratio = result.right_ratio = 0;
+  }
+  return result;
+}
 
 Result compare(const Track& left, const Track& right) {
+  if (frechet_threshold > 0) return compareOrdered(left, right);
+
   Result result;
   const double target = 0.96;
   result.left_ratio = trackDistance(left, right, 25.0, 0.90);
@@ -112,10 +164,107 @@ Result compare(const Track& left, const Track& right) {
   return result;
 }
 
+// Write a gnuplot script to plot the cluster to cluster_<index>.png
+void writeClusterGnuplot(const vector<const Track*>& cluster, int index) {
+  // Find the bounds of the cluster
+  double minLon = 180, maxLon = -180, minLat = 90, maxLat = -90;
+  for (const Track* track : cluster) {
+    if (track->empty()) continue;
+
+    double lon0, lon1, lat0, lat1;
+    track->getBounds(lon0, lon1, lat0, lat1);
+    minLon = min(minLon, lon0);
+    maxLon = max(maxLon, lon1);
+    minLat = min(minLat, lat0);
+    maxLat = max(maxLat, lat1);
+  }
+  const double margin =
+      max(0.05 * max(maxLon - minLon, maxLat - minLat), 0.001);
+  minLon -= margin;
+  maxLon += margin;
+  minLat -= margin;
+  maxLat += margin;
+
+  const int size = 2000;
+
+  cout.precision(8);
+  cout << "set terminal pngcairo size " << size << "," << size << endl;
+  cout << "set xrange [" << minLon << ":" << maxLon << "]" << endl;
+  cout << "set yrange [" << minLat << ":" << maxLat << "]" << endl;
+  cout << "set output \"cluster_" << index << ".png\"" << endl;
+
+  bool first_track = true;
+  for (const Track* track : cluster) {
+    if (first_track) {
+      cout << "plot";
+      first_track = false;
+    } else {
+      cout << ",";
+    }
+    cout << " '-' with lines title '" << track->getName() << "' ";
+  }
+  cout << endl;
+
+  // Only write a point if it lands on a different pixel than the last
+  // one, so the script's size depends on the image, not the tracks.
+  const double scaleX = size / (maxLon - minLon);
+  const double scaleY = size / (maxLat - minLat);
+  for (const Track* track : cluster) {
+    int prev_x = -1;
+    int prev_y = -1;
+    for (const Point& point : *track) {
+      const int x = (point.lon - minLon) * scaleX;
+      const int y = (point.lat - minLat) * scaleY;
+      if (x == prev_x && y == prev_y) continue;
+
+      cout << point.lon << " " << point.lat << endl;
+      prev_x = x;
+      prev_y = y;
+    }
+    cout << "e" << endl;
+  }
+}
+
+// Draw the cluster directly into cluster_<index>.png
+void writeClusterPng(const vector<const Track*>& cluster, int index) {
+  const string filename = "cluster_" + to_string(index) + ".png";
+  ofstream out(filename.c_str(), ios_base::out|ios_base::binary);
+  if (!out.is_open()) {
+    throw Exception("Could not open " + filename);
+  }
+  PNG::writeMap(out, cluster);
+}
+
+void processCommandLine(int argc, char* argv[]) {
+  while (true) {
+    const int opt = getopt(argc, argv, "f:p");
+    if (opt == -1) break;
+
+    switch (opt) {
+      case 'f':
+        frechet_threshold = strtod(optarg, 0);
+        if (frechet_threshold <= 0) {
+          throw Exception("-f (Frechet threshold) must be positive");
+        }
+        break;
+
+      case 'p':
+        write_png = true;
+        break;
+
+      default:
+        usage();
+        throw Exception("Unknown option");
+    }
+  }
+}
+
 }  // namespace
 
 int main(int argc, char* argv[]) {
   try {
+    processCommandLine(argc, argv);
+
     // A track, and the cluster to which the track belongs, if we know it.
     struct TrackInfo {
       Track track;
@@ -123,7 +272,7 @@ int main(int argc, char* argv[]) {
     };
     vector<TrackInfo> tracks;
 
-    for (int i = 1; i < argc; ++i) {
+    for (int i = optind; i < argc; ++i) {
       tracks.push_back(TrackInfo());
       Track* t = &tracks.back().track;
 
@@ -138,6 +287,9 @@ int main(int argc, char* argv[]) {
       }
       t->setName(s);
       t->RemoveBurrs();
+
+      // The ordered comparison works from the distance along the track.
+      if (frechet_threshold > 0) t->CalculateLength();
       cerr << "Read " << t->getName() << endl;
     }
 
@@ -195,31 +347,13 @@ int main(int argc, char* argv[]) {
       }
     }
 
-    cout.precision(8);
     for (unsigned i = 0; i < clusters.size(); ++i) {
-      const set<Track*>& cluster = *clusters[i];
-      cout << "set terminal pngcairo size 2000,2000" << endl;
-      cout << "set xrange [-122.12:-121.80]" << endl;
-      cout << "set yrange [37.18:37.50]" << endl;
-      cout << "set output \"cluster_" << i << ".png\"" << endl;
-
-      bool first_track = true;
-      for (const Track* track : cluster) {
-        if (first_track) {
-          cout << "plot";
-          first_track = false;
-        } else {
-          cout << ",";
-        }
-        cout << " '-' with lines title '" << track->getName() << "' ";
-      }
-      cout << endl;
-
-      for (const Track* track : cluster) {
-        for (const Point& point : *track) {
-          cout << point.lon << " " << point.lat << endl;
-        }
-        cout << "e" << endl;
+      const vector<const Track*> cluster(clusters[i]->begin(),
+                                         clusters[i]->end());
+      if (write_png) {
+        writeClusterPng(cluster, i);
+      } else {
+        writeClusterGnuplot(cluster, i);
       }
     }
 
@@ -0,0 +1,157 @@
+#include "synthetic.h"
+
+#include "exception.h"
+#include "gpx.h"
+#include "kml.h"
+#include "point.h"
+#include "text.h"
+#include "track.h"
+
+#include <algorithm>
+#include <math.h>
+#include <random>
+
+using namespace std;
+
+namespace {
+
+const double kRadiusOfEarthInMeters = 6371000;
+
+// A terrain is a few waves of elevation along the ride, each with an
+// amplitude and a wavelength in meters
+struct Wave {
+  double amplitude;
+  double wavelength;
+};
+
+const struct {
+  const char* name;
+  Wave waves[2];
+} kTerrains[Synthetic::TERRAIN_COUNT] = {
+  { "flat", { { 2, 500 }, { 1, 150 } } },
+  { "rolling", { { 15, 800 }, { 8, 300 } } },
+  { "hilly", { { 120, 6000 }, { 30, 1500 } } },
+  { "mountainous", { { 600, 30000 }, { 100, 5000 } } },
+};
+
+double toRadians(double degrees) { return degrees * M_PI / 180; }
+double toDegrees(double radians) { return radians * 180 / M_PI; }
+
+}  // namespace
+
+void Synthetic::generate(Track& track, size_t points, Options opt) {
+  PRECONDITION(opt.terrain >= 0 && opt.terrain < TERRAIN_COUNT);
+  PRECONDITION(opt.speed > 0);
+
+  mt19937 random(opt.seed);
+  normal_distribution<double> normal(0, 1);
+  uniform_real_distribution<double> uniform(0, 1);
+
+  const Wave* const waves = kTerrains[opt.terrain].waves;
+  double phases[2];
+  for (double& phase : phases) phase = 2 * M_PI * uniform(random);
+
+  // The elevation and grade (as a ratio) at 'distance' along the ride
+  auto elevation = [&](double distance) {
+    double height = 100 + waves[0].amplitude + waves[1].amplitude;
+    for (int i = 0; i < 2; ++i) {
+      height += waves[i].amplitude *
+          sin(2 * M_PI * distance / waves[i].wavelength + phases[i]);
+    }
+    return height;
+  };
+  auto grade = [&](double distance) {
+    double slope = 0;
+    for (int i = 0; i < 2; ++i) {
+      const double k = 2 * M_PI / waves[i].wavelength;
+      slope += waves[i].amplitude * k * cos(k * distance + phases[i]);
+    }
+    return slope;
+  };
+
+  double lat = toRadians(opt.lat);
+  double lon = toRadians(opt.lon);
+  double heading = 2 * M_PI * uniform(random);
+  double distance = 0;
+  double heartRate = 90;
+  double temperature = 22;
+  int stopped = 0;  // seconds left in a stop
+
+  track.clear();
+  track.reserve(points);
+  for (size_t i = 0; i < points; ++i) {
+    Point point;
+    point.lat = toDegrees(lat);
+    point.lon = toDegrees(lon);
+    point.elevation = elevation(distance) + 0.3 * normal(random);
+    point.length = distance;
+    point.timestamp = opt.start + i;
+    point.seq = i;
+
+    // Slower uphill and faster down, with a stop now and then
+    const double slope = grade(distance);
+    double speed = 0;
+    if (stopped > 0) {
+      --stopped;
+    } else if (uniform(random) < 1.0 / 1800) {
+      stopped = 10 + 50 * uniform(random);
+    } else {
+      speed = opt.speed * exp(-12 * slope) * (1 + 0.05 * normal(random));
+      speed = min(max(speed, 1.5), 2.5 * opt.speed);
+    }
+
+    // The heart follows the effort, slowly
+    const double effort = speed > 0 ?
+        95 + 40 * speed / opt.speed + 600 * max(slope, 0.0) : 85;
+    heartRate += 0.05 * (min(effort, 190.0) - heartRate) + normal(random);
+    point.hr = lround(heartRate);
+
+    // Cooler higher up, and drifting
+    temperature += 0.01 * normal(random);
+    point.atemp = round(10 * (temperature - 0.0065 *
+                              (point.elevation - 100))) / 10;
+
+    track.push_back(point);
+
+    // Wander, and move along the great circle in that direction
+    heading += 0.05 * normal(random);
+    const double angle = speed / kRadiusOfEarthInMeters;
+    const double nextLat = asin(sin(lat) * cos(angle) +
+                                cos(lat) * sin(angle) * cos(heading));
+    lon += atan2(sin(heading) * sin(angle) * cos(lat),
+                 cos(angle) - sin(lat) * sin(nextLat));
+    lat = nextLat;
+    if (lon > M_PI) lon -= 2 * M_PI;
+    if (lon < -M_PI) lon += 2 * M_PI;
+    distance += speed;
+  }
+}
+
+void Synthetic::write(ostream& out, const Track& track,
+                      Parse::Format format) {
+  if (format == Parse::FORMAT_GPX) {
+    GPX::write(out, track);
+  } else if (format == Parse::FORMAT_KML) {
+    KML::Options opt;
+    opt.timestamps = true;
+    KML::write(out, track, opt);
+  } else if (format == Parse::FORMAT_TEXT) {
+    Text::write(out, track);
+  } else if (format == Parse::FORMAT_FIT) {
+    throw Exception("Unable to write FIT files yet");
+  } else {
+    throw Exception("Unable to write a ride in that format");
+  }
+}
+
+const char* Synthetic::terrainName(Terrain terrain) {
+  PRECONDITION(terrain >= 0 && terrain < TERRAIN_COUNT);
+  return kTerrains[terrain].name;
+}
+
+Synthetic::Terrain Synthetic::findTerrain(const string& name) {
+  for (int t = 0; t < TERRAIN_COUNT; ++t) {
+    if (name == kTerrains[t].name) return static_cast<Terrain>(t);
+  }
+  throw Exception("Unknown terrain '" + name + "'");
+}
@@ -0,0 +1,56 @@
+#if !defined SYNTHETIC_H
+#define      SYNTHETIC_H
+
+#include <stddef.h>
+#include <time.h>
+
+#include <iosfwd>
+#include <string>
+
+#include "parse.h"
+
+class Track;
+
+// Makes up plausible rides, for benchmarks: a random walk over the
+// sphere, one point a second, with elevation from a terrain profile, and
+// a speed, heart rate and temperature that follow the grade and
+// elevation. The same options and seed always make the same ride.
+class Synthetic {
+ public:
+  enum Terrain {
+    FLAT,         // a few meters of noise
+    ROLLING,      // short hills, tens of meters
+    HILLY,        // climbs of a couple of hundred meters
+    MOUNTAINOUS,  // long climbs of a thousand meters or more
+    TERRAIN_COUNT
+  };
+
+  struct Options {
+    Options() {}
+
+    Terrain terrain = ROLLING;
+    unsigned seed = 1;
+    double lat = 37.3;          // where to start, in degrees
+    double lon = -122.0;
+    time_t start = 1400000000;  // when to start
+    double speed = 8;           // on the flat, in meters/second
+  };
+
+  // Replace the points of 'track' with a ride of 'points' points
+  static void generate(Track& track, size_t points, Options opt = Options());
+
+  // Write 'track' in 'format', one that Parse::read reads (GPX, KML or
+  // text), keeping everything that format can hold, so a corpus of rides
+  // reads back much as it was made. KML gets a gx:Track with timestamps.
+  // FIT can't be written yet, so asking for it throws an Exception.
+  static void write(std::ostream& out, const Track& track,
+                    Parse::Format format);
+
+  static const char* terrainName(Terrain terrain);
+
+  // The terrain with the given name. Throws an Exception if there isn't
+  // one.
+  static Terrain findTerrain(const std::string& name);
+};
+
+#endif
@@ -0,0 +1,71 @@
+#!/bin/sh
+# Checks that 'track' writes exactly what it did: runs it on the rides
+# here, and compares each output (and the messages) byte for byte with
+# the expected one in testdata/expected. With -u, the expected outputs
+# are written instead, for a change that's meant to alter them.
+#
+#   testdata/check.sh [-u] <track>
+#
+# ride.gpx is a short ride, written by hand; synthetic.txt was made with
+# 'ridegen -n 240 -t mountainous -s 11 synthetic.txt'.
+
+update=false
+if [ "$1" = "-u" ]; then
+  update=true
+  shift
+fi
+if [ $# -ne 1 ]; then
+  echo "Usage: $0 [-u] <track>" >&2
+  exit 2
+fi
+track=$1
+data=$(dirname "$0")
+expected=$data/expected
+
+actual=$(mktemp -d "${TMPDIR:-/tmp}/check.XXXXXX") || exit 2
+trap 'rm -rf "$actual"' EXIT
+mkdir -p "$expected"
+
+failures=0
+
+# Run one case: its name, the input, and any other options
+check() {
+  name=$1
+  input=$2
+  shift 2
+
+  if ! "$track" "$data/$input" "$@" \
+      -o "gpx:$actual/$name.gpx" -o "kml:$actual/$name.kml" \
+      -o "txt:$actual/$name.txt" -o "json:$actual/$name.json" \
+      -o "gnuplot:$actual/$name.gnuplot" 2> "$actual/$name.messages"; then
+    echo "FAIL $name: track failed"
+    cat "$actual/$name.messages"
+    failures=$((failures + 1))
+    return
+  fi
+
+  for suffix in gpx kml txt json gnuplot messages; do
+    file=$name.$suffix
+    if $update; then
+      cp "$actual/$file" "$expected/$file"
+    elif ! cmp -s "$expected/$file" "$actual/$file"; then
+      echo "FAIL $file differs:"
+      diff -u "$expected/$file" "$actual/$file" | head -20
+      failures=$((failures + 1))
+    fi
+  done
+}
+
+check ride ride.gpx -r
+check ride-metric ride.gpx -r -m -S 3
+check synthetic synthetic.txt
+check synthetic-shortest synthetic.txt -g -c
+
+if $update; then
+  echo "Wrote the expected outputs to $expected"
+elif [ $failures -ne 0 ]; then
+  echo "$failures outputs differ"
+  exit 1
+else
+  echo "All outputs as expected"
+fi
@@ -0,0 +1,32 @@
+set grid
+set y2tics
+set xlabel 'Distance (km)'
+set ylabel 'Elevation (meters)'
+set y2label 'Grade (%)'
+set terminal pngcairo size 800,300
+set style line 1 linewidth 2 linecolor rgb '#60b060'
+set style line 2 linewidth 1 linecolor rgb '#b06060'
+set style line 3 linewidth 2 linecolor rgb '#707030'
+set style line 4 linewidth 2 linecolor rgb '#a02020'
+set object 1 rectangle from graph 0, graph 0 to graph 1, graph 1 behind fillcolor rgb '#f0ffff' fillstyle solid 1.0
+plot '-' using ($1/1000.0):(($2 > 0) ? $2 : 0) with filledcurves above x1 fill solid 0.6 border linestyle 2 axis x1y2 title 'Grade (%)','-' using ($1/1000.0):($2) with filledcurves above x1 fill transparent solid 0.8 border linestyle 1 title 'Elevation','-' using ($1/1000.0):($2) with lines linestyle 3 notitle,'-' using ($1/1000.0):($2) with lines linestyle 4 notitle
+0 1.0146083
+677.59684 3.3340717
+704.26188 8.7192945
+1557.5364 1.3010311
+1610.8656 1.3010311
+2126.5089 -5.5270222
+e
+0 62
+677.59684 67.3
+704.26188 69.7
+1557.5364 146.2
+1610.8656 151.3
+2126.5089 116.8
+e
+704.26188 69.7
+e
+1557.5364 146.2
+1610.8656 151.3
+2126.5089 116.8
+e
@@ -0,0 +1,246 @@
+set grid
+set y2tics
+set xlabel 'Distance (miles)'
+set ylabel 'Elevation (feet)'
+set y2label 'Grade (%)'
+set terminal pngcairo size 800,300
+set style line 1 linewidth 2 linecolor rgb '#60b060'
+set style line 2 linewidth 1 linecolor rgb '#b06060'
+set style line 3 linewidth 2 linecolor rgb '#707030'
+set style line 4 linewidth 2 linecolor rgb '#a02020'
+set object 1 rectangle from graph 0, graph 0 to graph 1, graph 1 behind fillcolor rgb '#f0ffff' fillstyle solid 1.0
+plot '-' using (($1/1000.0)*0.62137):(($2 > 0) ? $2 : 0) with filledcurves above x1 fill solid 0.6 border linestyle 2 axis x1y2 title 'Grade (%)','-' using (($1/1000.0)*0.62137):($2*3.2808) with filledcurves above x1 fill transparent solid 0.8 border linestyle 1 title 'Elevation','-' using (($1/1000.0)*0.62137):($2*3.2808) with lines linestyle 3 notitle,'-' using (($1/1000.0)*0.62137):($2*3.2808) with lines linestyle 4 notitle
+0 1.0146083
+27.104081 1.0146083
+54.208145 1.0146083
+81.312191 1.0146083
+108.41622 0.51652936
+135.52023 0.51652936
+162.62423 0.51652936
+189.7282 0.51652936
+216.83216 0.51652936
+243.93611 0.9223765
+271.04003 0.9223765
+298.14394 0.9223765
+325.24783 0.9223765
+352.35171 0.73790308
+379.45556 0.73790308
+406.5594 0.73790308
+433.66322 0.73790308
+460.76703 0.3689526
+487.87082 0.3689526
+514.97459 0.3689526
+542.07834 0.3689526
+569.18207 0.3689526
+596.28579 3.3340717
+623.38949 3.3340717
+650.49318 3.3340717
+677.59684 3.3340717
+704.26188 8.7192945
+730.9269 8.7192945
+757.5919 8.7192945
+784.2569 8.7192945
+810.92188 9.1880908
+837.58685 9.1880908
+864.25181 9.1880908
+890.91676 9.1880908
+917.58169 9.0005954
+944.24661 9.0005954
+970.91152 9.0005954
+997.57642 9.0005954
+1024.2413 8.8130993
+1050.9062 8.8130993
+1077.571 8.8130993
+1104.2359 8.8130993
+1130.9007 9.2818984
+1157.5655 9.2818984
+1184.2303 9.2818984
+1210.8951 9.2818984
+1237.5599 8.4381051
+1264.2247 8.4381051
+1290.8895 8.4381051
+1317.5542 8.4381051
+1344.2189 9.5632035
+1370.8837 9.5632035
+1397.5484 9.5632035
+1424.2131 9.5632035
+1450.8778 8.7194076
+1477.5424 8.7194076
+1504.2071 8.7194076
+1530.8718 8.7194076
+1557.5364 1.3010311
+1584.201 1.3010311
+1610.8656 1.3010311
+1638.0045 1.3010311
+1665.1433 -6.6325332
+1692.2823 -6.6325332
+1719.4212 -6.6325332
+1746.5602 -6.6325332
+1773.6992 -6.81674
+1800.8382 -6.81674
+1827.9772 -6.81674
+1855.1163 -6.81674
+1882.2554 -6.3561213
+1909.3946 -6.3561213
+1936.5338 -6.3561213
+1963.673 -6.3561213
+1990.8122 -7.1851488
+2017.9515 -7.1851488
+2045.0908 -7.1851488
+2072.2301 -7.1851488
+2099.3695 -5.5270222
+2126.5089 -5.5270222
+e
+0 62
+27.104081 61.9
+54.208145 62.4
+81.312191 62.8
+108.41622 63.1
+135.52023 63.3
+162.62423 63.4
+189.7282 63.4
+216.83216 63.3
+243.93611 63.8
+271.04003 64.2
+298.14394 64.5
+325.24783 64.7
+352.35171 64.8
+379.45556 64.8
+406.5594 64.7
+433.66322 65.2
+460.76703 65.6
+487.87082 65.9
+514.97459 66.1
+542.07834 66.2
+569.18207 66.2
+596.28579 66.1
+623.38949 66.6
+650.49318 67
+677.59684 67.3
+704.26188 69.7
+730.9269 72
+757.5919 74.2
+784.2569 76.3
+810.92188 79
+837.58685 81.6
+864.25181 84.1
+890.91676 86.5
+917.58169 88.8
+944.24661 91
+970.91152 93.1
+997.57642 95.8
+1024.2413 98.4
+1050.9062 100.9
+1077.571 103.3
+1104.2359 105.6
+1130.9007 107.8
+1157.5655 109.9
+1184.2303 112.6
+1210.8951 115.2
+1237.5599 117.7
+1264.2247 120.1
+1290.8895 122.4
+1317.5542 124.6
+1344.2189 126.7
+1370.8837 129.4
+1397.5484 132
+1424.2131 134.5
+1450.8778 136.9
+1477.5424 139.2
+1504.2071 141.4
+1530.8718 143.5
+1557.5364 146.2
+1584.201 148.8
+1610.8656 151.3
+1638.0045 149.5
+1665.1433 147.6
+1692.2823 145.6
+1719.4212 143.5
+1746.5602 142
+1773.6992 140.4
+1800.8382 138.7
+1827.9772 136.9
+1855.1163 135
+1882.2554 133
+1909.3946 130.9
+1936.5338 129.4
+1963.673 127.8
+1990.8122 126.1
+2017.9515 124.3
+2045.0908 122.4
+2072.2301 120.4
+2099.3695 118.3
+2126.5089 116.8
+e
+704.26188 69.7
+730.9269 72
+757.5919 74.2
+784.2569 76.3
+810.92188 79
+837.58685 81.6
+864.25181 84.1
+890.91676 86.5
+917.58169 88.8
+944.24661 91
+970.91152 93.1
+997.57642 95.8
+1024.2413 98.4
+1050.9062 100.9
+1077.571 103.3
+1104.2359 105.6
+1130.9007 107.8
+1157.5655 109.9
+1184.2303 112.6
+1210.8951 115.2
+1237.5599 117.7
+1264.2247 120.1
+1290.8895 122.4
+1317.5542 124.6
+1344.2189 126.7
+1370.8837 129.4
+1397.5484 132
+1424.2131 134.5
+1450.8778 136.9
+1477.5424 139.2
+1504.2071 141.4
+1530.8718 143.5
+e
+757.5919 74.2
+784.2569 76.3
+810.92188 79
+837.58685 81.6
+864.25181 84.1
+890.91676 86.5
+917.58169 88.8
+944.24661 91
+970.91152 93.1
+997.57642 95.8
+1024.2413 98.4
+1050.9062 100.9
+1077.571 103.3
+1104.2359 105.6
+1130.9007 107.8
+1157.5655 109.9
+1184.2303 112.6
+1210.8951 115.2
+1237.5599 117.7
+1264.2247 120.1
+1290.8895 122.4
+1317.5542 124.6
+1344.2189 126.7
+1370.8837 129.4
+1397.5484 132
+1424.2131 134.5
+1450.8778 136.9
+1477.5424 139.2
+1504.2071 141.4
+1530.8718 143.5
+1557.5364 146.2
+1584.201 148.8
+1610.8656 151.3
+1638.0045 149.5
+1665.1433 147.6
+1692.2823 145.6
+1719.4212 143.5
+1746.5602 142
+e
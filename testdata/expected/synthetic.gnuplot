@@ -0,0 +1,734 @@
+set grid
+set y2tics
+set xlabel 'Distance (miles)'
+set ylabel 'Elevation (feet)'
+set y2label 'Grade (%)'
+set terminal pngcairo size 800,300
+set style line 1 linewidth 2 linecolor rgb '#60b060'
+set style line 2 linewidth 1 linecolor rgb '#b06060'
+set style line 3 linewidth 2 linecolor rgb '#707030'
+set style line 4 linewidth 2 linecolor rgb '#a02020'
+set object 1 rectangle from graph 0, graph 0 to graph 1, graph 1 behind fillcolor rgb '#f0ffff' fillstyle solid 1.0
+plot '-' using (($1/1000.0)*0.62137):(($2 > 0) ? $2 : 0) with filledcurves above x1 fill solid 0.6 border linestyle 2 axis x1y2 title 'Grade (%)','-' using (($1/1000.0)*0.62137):($2*3.2808) with filledcurves above x1 fill transparent solid 0.8 border linestyle 1 title 'Elevation','-' using (($1/1000.0)*0.62137):($2*3.2808) with lines linestyle 3 notitle
+0 6.1015109
+4.3369867 6.1015109
+8.4163697 6.1015109
+12.626022 6.1015109
+16.346263 6.1015109
+20.324171 6.1015109
+24.54723 6.1015109
+28.688883 6.1015109
+32.691219 6.1015109
+37.18232 6.1015109
+41.240348 6.1015109
+45.361739 6.1015109
+49.542125 6.1015109
+53.401897 6.1015109
+57.662994 6.1015109
+61.737604 6.1015109
+65.698172 6.1015109
+69.870914 6.1015109
+73.763163 6.1015109
+77.657575 6.1015109
+81.712154 6.1015109
+85.629039 6.1015109
+89.152239 6.1015109
+93.055484 6.1015109
+97.052068 6.1015109
+100.71276 5.6008626
+104.65208 5.6008626
+108.03338 5.6008626
+111.76023 5.6008626
+115.58513 5.6008626
+119.17873 5.6008626
+122.61216 5.6008626
+126.34575 5.6008626
+130.00126 5.6008626
+133.58126 5.6008626
+137.44 5.6008626
+140.99882 5.6008626
+144.64277 5.6008626
+148.04416 5.6008626
+151.50943 5.6008626
+154.71031 5.6008626
+158.01753 5.6008626
+161.46501 5.6008626
+164.73711 5.6008626
+168.05165 5.6008626
+171.55181 5.6008626
+174.83167 5.6008626
+177.96532 5.6008626
+181.2227 5.6008626
+184.42006 5.6008626
+187.41324 5.6008626
+190.6734 5.6008626
+194.19836 9.00429
+197.68805 9.00429
+200.96964 9.00429
+204.38113 9.00429
+207.59972 9.00429
+210.57317 9.00429
+213.34158 9.00429
+216.36733 9.00429
+219.51128 9.00429
+222.45227 9.00429
+225.52852 9.00429
+228.80551 9.00429
+232.0628 9.00429
+234.99636 9.00429
+237.99176 9.00429
+240.94642 9.00429
+244.1331 9.00429
+247.03546 9.00429
+250.21929 9.00429
+253.03548 9.00429
+256.08326 9.00429
+258.90272 9.00429
+261.70848 9.00429
+264.72454 9.00429
+267.37969 9.00429
+270.02825 9.00429
+272.86586 9.00429
+275.51839 9.00429
+278.02948 9.00429
+280.83158 9.00429
+283.73163 9.00429
+286.52102 10.477939
+289.40315 10.477939
+292.03552 10.477939
+294.91422 10.477939
+297.7833 10.477939
+300.5529 10.477939
+303.25241 10.477939
+306.0049 10.477939
+308.82992 10.477939
+311.49656 10.477939
+314.09192 10.477939
+316.81453 10.477939
+319.50175 10.477939
+322.15336 10.477939
+324.62795 10.477939
+327.31508 10.477939
+329.83928 10.477939
+332.56416 10.477939
+335.16837 10.477939
+337.71215 10.477939
+340.3036 10.477939
+342.77216 10.477939
+345.46381 10.477939
+347.85029 10.477939
+350.303 10.477939
+352.68918 10.477939
+355.32595 10.477939
+357.68501 10.477939
+360.03877 10.477939
+362.4064 10.477939
+364.75599 10.477939
+367.34318 10.477939
+369.68577 10.477939
+372.20534 10.477939
+374.61251 10.477939
+377.00771 10.477939
+379.26362 10.477939
+381.66444 10.477939
+383.90838 10.477939
+386.14267 10.477939
+388.46855 10.320434
+390.93535 10.320434
+393.3404 10.320434
+395.83459 10.320434
+397.91604 10.320434
+400.14297 10.320434
+402.53895 10.320434
+404.86172 10.320434
+406.92595 10.320434
+409.28108 10.320434
+411.656 10.320434
+414.26924 10.320434
+416.4388 10.320434
+418.62975 10.320434
+420.80688 10.320434
+422.94991 10.320434
+425.01001 10.320434
+427.12517 10.320434
+429.42115 10.320434
+431.65142 10.320434
+433.85224 10.320434
+435.90296 10.320434
+437.91569 10.320434
+439.93692 10.320434
+442.11392 10.320434
+444.17395 10.320434
+446.13003 10.320434
+448.26171 10.320434
+450.29407 10.320434
+452.38659 10.320434
+454.35283 10.320434
+456.53311 10.320434
+458.72816 10.320434
+460.72685 10.320434
+462.80234 10.320434
+464.8649 10.320434
+466.91784 10.320434
+468.94401 10.320434
+470.97718 10.320434
+472.98034 10.320434
+475.03101 10.320434
+476.9623 10.320434
+478.97379 10.320434
+481.15227 10.320434
+483.24802 10.320434
+485.22805 12.530649
+487.09636 12.530649
+489.02862 12.530649
+490.96002 12.530649
+492.86597 12.530649
+494.73764 12.530649
+496.56336 12.530649
+498.57263 12.530649
+500.45359 12.530649
+502.19576 12.530649
+504.19943 12.530649
+506.13927 12.530649
+507.93407 12.530649
+509.69737 12.530649
+511.73025 12.530649
+513.59349 12.530649
+515.48588 12.530649
+517.34421 12.530649
+519.20735 12.530649
+520.98189 12.530649
+522.81899 12.530649
+524.55537 12.530649
+526.40685 12.530649
+528.0799 12.530649
+529.83754 12.530649
+531.71133 12.530649
+533.55186 12.530649
+535.37509 12.530649
+537.22126 12.530649
+538.95895 12.530649
+540.7524 12.530649
+542.48223 12.530649
+544.2749 12.530649
+546.02483 12.530649
+547.63509 12.530649
+549.49185 12.530649
+551.20346 12.530649
+552.91806 12.530649
+554.79511 12.530649
+556.45611 12.530649
+558.08241 12.530649
+559.88356 12.530649
+561.61439 12.530649
+563.3586 12.530649
+565.08932 12.530649
+566.79851 12.530649
+568.46 12.530649
+570.18397 12.530649
+571.83246 12.530649
+573.42026 12.530649
+575.11913 12.530649
+576.92773 12.530649
+578.62056 12.530649
+580.19605 12.530649
+581.87109 12.591015
+583.64134 12.591015
+585.20554 12.591015
+586.99305 12.591015
+588.50696 12.591015
+590.17216 12.591015
+591.98991 12.591015
+593.76784 12.591015
+595.45716 12.591015
+597.10384 12.591015
+598.80566 12.591015
+600.45666 12.591015
+602.05438 12.591015
+603.63027 12.591015
+605.16869 12.591015
+606.66869 12.591015
+608.16869 12.591015
+609.66869 12.591015
+e
+0 963.788
+4.3369867 964.323
+8.4163697 964.252
+12.626022 964.511
+16.346263 964.496
+20.324171 964.541
+24.54723 964.645
+28.688883 964.724
+32.691219 964.943
+37.18232 965.596
+41.240348 965.701
+45.361739 966.315
+49.542125 966.197
+53.401897 966.484
+57.662994 967.033
+61.737604 967.265
+65.698172 967
+69.870914 968.123
+73.763163 967.611
+77.657575 967.831
+81.712154 968.23
+85.629039 968.557
+89.152239 969.197
+93.055484 968.388
+97.052068 968.826
+100.71276 969.933
+104.65208 969.315
+108.03338 969.394
+111.76023 970.35
+115.58513 970.18
+119.17873 970.211
+122.61216 970.869
+126.34575 971.125
+130.00126 971.291
+133.58126 972.025
+137.44 971.817
+140.99882 971.892
+144.64277 972.576
+148.04416 972.707
+151.50943 972.287
+154.71031 972.572
+158.01753 973.679
+161.46501 973.347
+164.73711 973.528
+168.05165 974.046
+171.55181 973.713
+174.83167 975.028
+177.96532 974.847
+181.2227 974.973
+184.42006 975.406
+187.41324 976.261
+190.6734 975.345
+194.19836 975.169
+197.68805 975.694
+200.96964 976.614
+204.38113 976.61
+207.59972 976.751
+210.57317 976.859
+213.34158 976.971
+216.36733 977.88
+219.51128 977.516
+222.45227 978.001
+225.52852 978.536
+228.80551 978.824
+232.0628 978.859
+234.99636 979.302
+237.99176 979.505
+240.94642 979.585
+244.1331 979.88
+247.03546 979.953
+250.21929 979.989
+253.03548 980.007
+256.08326 980.716
+258.90272 981.168
+261.70848 981.482
+264.72454 982.366
+267.37969 981.815
+270.02825 982.102
+272.86586 982.111
+275.51839 982.454
+278.02948 982.711
+280.83158 982.689
+283.73163 983.007
+286.52102 983.482
+289.40315 983.514
+292.03552 984.022
+294.91422 984.008
+297.7833 984.349
+300.5529 984.575
+303.25241 984.642
+306.0049 985.145
+308.82992 985.676
+311.49656 985.61
+314.09192 985.332
+316.81453 986.646
+319.50175 986.724
+322.15336 987.251
+324.62795 986.694
+327.31508 987.671
+329.83928 987.369
+332.56416 987.721
+335.16837 987.572
+337.71215 988.164
+340.3036 988.827
+342.77216 988.626
+345.46381 988.928
+347.85029 988.958
+350.303 989.154
+352.68918 989.716
+355.32595 989.942
+357.68501 990.15
+360.03877 990.079
+362.4064 990.421
+364.75599 991.078
+367.34318 991.298
+369.68577 991.33
+372.20534 992.597
+374.61251 992.055
+377.00771 992.555
+379.26362 991.997
+381.66444 993.032
+383.90838 992.527
+386.14267 992.766
+388.46855 994.164
+390.93535 992.554
+393.3404 993.797
+395.83459 993.686
+397.91604 994.466
+400.14297 994.553
+402.53895 995.183
+404.86172 995.254
+406.92595 995.53
+409.28108 995.27
+411.656 996.431
+414.26924 995.124
+416.4388 996.3
+418.62975 996.149
+420.80688 996.953
+422.94991 996.784
+425.01001 997.114
+427.12517 997.186
+429.42115 997.272
+431.65142 998.077
+433.85224 998.457
+435.90296 997.893
+437.91569 998.442
+439.93692 998.674
+442.11392 999.156
+444.17395 999.19
+446.13003 999.705
+448.26171 999.909
+450.29407 1000.42
+452.38659 1000.13
+454.35283 999.948
+456.53311 1000.34
+458.72816 1001.22
+460.72685 1000.87
+462.80234 1001.39
+464.8649 1001.84
+466.91784 1001.69
+468.94401 1002.61
+470.97718 1001.96
+472.98034 1002.85
+475.03101 1002.54
+476.9623 1002.46
+478.97379 1003.17
+481.15227 1002.82
+483.24802 1003.85
+485.22805 1004.15
+487.09636 1003.8
+489.02862 1004.95
+490.96002 1004.23
+492.86597 1005.29
+494.73764 1005.42
+496.56336 1005.51
+498.57263 1005.77
+500.45359 1005.9
+502.19576 1005.94
+504.19943 1006.56
+506.13927 1006.47
+507.93407 1006.46
+509.69737 1007.19
+511.73025 1007.28
+513.59349 1007
+515.48588 1007.47
+517.34421 1008.17
+519.20735 1007.8
+520.98189 1008.62
+522.81899 1008.64
+524.55537 1008.65
+526.40685 1008.58
+528.0799 1009.56
+529.83754 1009.55
+531.71133 1009.8
+533.55186 1009.69
+535.37509 1009.65
+537.22126 1010.12
+538.95895 1011.07
+540.7524 1010.4
+542.48223 1011.53
+544.2749 1011.19
+546.02483 1011.31
+547.63509 1012.36
+549.49185 1012.55
+551.20346 1011.81
+552.91806 1012.4
+554.79511 1012.31
+556.45611 1012.07
+558.08241 1012.8
+559.88356 1013.04
+561.61439 1013.02
+563.3586 1013.5
+565.08932 1014.01
+566.79851 1014.34
+568.46 1014.24
+570.18397 1014.75
+571.83246 1014.94
+573.42026 1015.18
+575.11913 1015.09
+576.92773 1015.8
+578.62056 1015.49
+580.19605 1015.82
+581.87109 1016.26
+583.64134 1016.65
+585.20554 1016.17
+586.99305 1016.77
+588.50696 1017.56
+590.17216 1017.06
+591.98991 1017.63
+593.76784 1017.53
+595.45716 1017.65
+597.10384 1017.85
+598.80566 1017.76
+600.45666 1018.3
+602.05438 1018.92
+603.63027 1019.34
+605.16869 1019.26
+606.66869 1019.41
+608.16869 1020.13
+609.66869 1019.76
+e
+0 963.788
+4.3369867 964.323
+8.4163697 964.252
+12.626022 964.511
+16.346263 964.496
+20.324171 964.541
+24.54723 964.645
+28.688883 964.724
+32.691219 964.943
+37.18232 965.596
+41.240348 965.701
+45.361739 966.315
+49.542125 966.197
+53.401897 966.484
+57.662994 967.033
+61.737604 967.265
+65.698172 967
+69.870914 968.123
+73.763163 967.611
+77.657575 967.831
+81.712154 968.23
+85.629039 968.557
+89.152239 969.197
+93.055484 968.388
+97.052068 968.826
+100.71276 969.933
+104.65208 969.315
+108.03338 969.394
+111.76023 970.35
+115.58513 970.18
+119.17873 970.211
+122.61216 970.869
+126.34575 971.125
+130.00126 971.291
+133.58126 972.025
+137.44 971.817
+140.99882 971.892
+144.64277 972.576
+148.04416 972.707
+151.50943 972.287
+154.71031 972.572
+158.01753 973.679
+161.46501 973.347
+164.73711 973.528
+168.05165 974.046
+171.55181 973.713
+174.83167 975.028
+177.96532 974.847
+181.2227 974.973
+184.42006 975.406
+187.41324 976.261
+190.6734 975.345
+194.19836 975.169
+197.68805 975.694
+200.96964 976.614
+204.38113 976.61
+207.59972 976.751
+210.57317 976.859
+213.34158 976.971
+216.36733 977.88
+219.51128 977.516
+222.45227 978.001
+225.52852 978.536
+228.80551 978.824
+232.0628 978.859
+234.99636 979.302
+237.99176 979.505
+240.94642 979.585
+244.1331 979.88
+247.03546 979.953
+250.21929 979.989
+253.03548 980.007
+256.08326 980.716
+258.90272 981.168
+261.70848 981.482
+264.72454 982.366
+267.37969 981.815
+270.02825 982.102
+272.86586 982.111
+275.51839 982.454
+278.02948 982.711
+280.83158 982.689
+283.73163 983.007
+286.52102 983.482
+289.40315 983.514
+292.03552 984.022
+294.91422 984.008
+297.7833 984.349
+300.5529 984.575
+303.25241 984.642
+306.0049 985.145
+308.82992 985.676
+311.49656 985.61
+314.09192 985.332
+316.81453 986.646
+319.50175 986.724
+322.15336 987.251
+324.62795 986.694
+327.31508 987.671
+329.83928 987.369
+332.56416 987.721
+335.16837 987.572
+337.71215 988.164
+340.3036 988.827
+342.77216 988.626
+345.46381 988.928
+347.85029 988.958
+350.303 989.154
+352.68918 989.716
+355.32595 989.942
+357.68501 990.15
+360.03877 990.079
+362.4064 990.421
+364.75599 991.078
+367.34318 991.298
+369.68577 991.33
+372.20534 992.597
+374.61251 992.055
+377.00771 992.555
+379.26362 991.997
+381.66444 993.032
+383.90838 992.527
+386.14267 992.766
+388.46855 994.164
+390.93535 992.554
+393.3404 993.797
+395.83459 993.686
+397.91604 994.466
+400.14297 994.553
+402.53895 995.183
+404.86172 995.254
+406.92595 995.53
+409.28108 995.27
+411.656 996.431
+414.26924 995.124
+416.4388 996.3
+418.62975 996.149
+420.80688 996.953
+422.94991 996.784
+425.01001 997.114
+427.12517 997.186
+429.42115 997.272
+431.65142 998.077
+433.85224 998.457
+435.90296 997.893
+437.91569 998.442
+439.93692 998.674
+442.11392 999.156
+444.17395 999.19
+446.13003 999.705
+448.26171 999.909
+450.29407 1000.42
+452.38659 1000.13
+454.35283 999.948
+456.53311 1000.34
+458.72816 1001.22
+460.72685 1000.87
+462.80234 1001.39
+464.8649 1001.84
+466.91784 1001.69
+468.94401 1002.61
+470.97718 1001.96
+472.98034 1002.85
+475.03101 1002.54
+476.9623 1002.46
+478.97379 1003.17
+481.15227 1002.82
+483.24802 1003.85
+485.22805 1004.15
+487.09636 1003.8
+489.02862 1004.95
+490.96002 1004.23
+492.86597 1005.29
+494.73764 1005.42
+496.56336 1005.51
+498.57263 1005.77
+500.45359 1005.9
+502.19576 1005.94
+504.19943 1006.56
+506.13927 1006.47
+507.93407 1006.46
+509.69737 1007.19
+511.73025 1007.28
+513.59349 1007
+515.48588 1007.47
+517.34421 1008.17
+519.20735 1007.8
+520.98189 1008.62
+522.81899 1008.64
+524.55537 1008.65
+526.40685 1008.58
+528.0799 1009.56
+529.83754 1009.55
+531.71133 1009.8
+533.55186 1009.69
+535.37509 1009.65
+537.22126 1010.12
+538.95895 1011.07
+540.7524 1010.4
+542.48223 1011.53
+544.2749 1011.19
+546.02483 1011.31
+547.63509 1012.36
+549.49185 1012.55
+551.20346 1011.81
+552.91806 1012.4
+554.79511 1012.31
+556.45611 1012.07
+558.08241 1012.8
+559.88356 1013.04
+561.61439 1013.02
+563.3586 1013.5
+565.08932 1014.01
+566.79851 1014.34
+568.46 1014.24
+570.18397 1014.75
+571.83246 1014.94
+573.42026 1015.18
+575.11913 1015.09
+576.92773 1015.8
+578.62056 1015.49
+580.19605 1015.82
+581.87109 1016.26
+583.64134 1016.65
+585.20554 1016.17
+586.99305 1016.77
+588.50696 1017.56
+590.17216 1017.06
+591.98991 1017.63
+593.76784 1017.53
+595.45716 1017.65
+597.10384 1017.85
+598.80566 1017.76
+600.45666 1018.3
+602.05438 1018.92
+603.63027 1019.34
+605.16869 1019.26
+606.66869 1019.41
+608.16869 1020.13
+e
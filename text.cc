@@ -6,6 +6,7 @@
 #include <ctype.h>
 
 #include "exception.h"
+#include "output.h"
 #include "point.h"
 #include "track.h"
 
@@ -66,15 +67,15 @@ void Text::read(istream& in, Track& track) {
   }
 }
 
-void Text::write(ostream& out, const Track& track) {
+void Text::write(ostream& stream, const Track& track, Options options) {
+  OutputBuffer out(stream);
+  out.shortest(options.shortest);
+
   if (!track.getName().empty()) {
-    out << "name=" << track.getName() << endl;
+    out << "name=" << track.getName() << "\n";
   }
 
-  out << "# lat lon ele timestamp seq hr atemp length grade velocity climb"
-      << endl;
-
-  streamsize s = out.precision();
+  out << "# lat lon ele timestamp seq hr atemp length grade velocity climb\n";
 
   for (const Point& point : track) {
     out.precision(16);
@@ -91,7 +92,6 @@ void Text::write(ostream& out, const Track& track) {
     out << " " << point.grade
         << " " << point.velocity
         << " " << point.climb
-        << endl;
+        << "\n";
   }
-  out.precision(s);
 }
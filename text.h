@@ -25,8 +25,15 @@ class Track;
 
 class Text {
 public:
+  struct Options {
+    Options() {}
+
+    bool shortest = false;  // shortest exact numbers, not fixed precision
+  };
+
   static void read(std::istream& in, Track& track);
-  static void write(std::ostream& out, const Track& track);
+  static void write(std::ostream& out, const Track& track,
+                    Options options = Options());
 };
 
 #endif
@@ -1,11 +1,17 @@
 #include "track.h"
 #include "exception.h"
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <queue>
 #include <set>
 #include <sstream>
 #include <memory>
+#include <thread>
 #include <unordered_map>
 
+#include <math.h>
 #include <stdint.h>
 
 using namespace std;
@@ -41,6 +47,7 @@ const Point& Track::last() const {
 // 'samples', but not exact
 void Track::ShrinkBySample(unsigned samples) {
   if (samples >= size()) return;
+  difficulty.clear();
 
   // Climbs and peaks refer to points by index, but obviously removing
   // points will change indices. So first, we map the relevant original
@@ -129,7 +136,8 @@ void Track::ShrinkByAverage(unsigned points) {
   PRECONDITION(points > 0);
 
   if (points >= size()) return;
-  
+  difficulty.clear();
+
   vector<Point> replacements;
 
   for (unsigned i = 0; i < points; ++i) {
@@ -181,8 +189,183 @@ void Track::ShrinkByAverage(unsigned points) {
   swap(replacements);
 }
 
+// Interpolate between points 'a' and 'b', where 'f' is the fraction
+// (0 to 1) of the distance from 'a' to 'b'.
+static Point interpolate(const Point& a, const Point& b, double f) {
+  Point p(a);
+  p.lat       = a.lat + (b.lat - a.lat) * f;
+  p.lon       = a.lon + (b.lon - a.lon) * f;
+  p.elevation = a.elevation + (b.elevation - a.elevation) * f;
+  p.length    = a.length + (b.length - a.length) * f;
+  p.timestamp = a.timestamp + llround((b.timestamp - a.timestamp) * f);
+  p.grade     = a.grade + (b.grade - a.grade) * f;
+  p.velocity  = a.velocity + (b.velocity - a.velocity) * f;
+  p.climb     = a.climb + (b.climb - a.climb) * f;
+  // A heart rate of 0 wasn't recorded, so there's nothing to interpolate
+  // toward; the nearer point's is used
+  if (a.hr > 0 && b.hr > 0) {
+    p.hr = a.hr + lround((b.hr - a.hr) * f);
+  } else {
+    p.hr = (f < 0.5) ? a.hr : b.hr;
+  }
+  if (a.validTemp() && b.validTemp()) {
+    p.atemp = a.atemp + (b.atemp - a.atemp) * f;
+  }
+  return p;
+}
+
+void Track::ResampleByDistance(double meters) {
+  PRECONDITION(meters > 0);
+
+  if (size() < 2) return;
+  difficulty.clear();
+
+  // As with ShrinkBySample, the points referenced by climbs and peaks
+  // must be retained. They're kept in addition to the evenly-spaced
+  // points, and 'newIndex' records where each one ends up.
+  vector<unsigned> keep;
+  for (const Track::Peak& peak : peaks) {
+    keep.push_back(peak.index);
+  }
+  for (const Track::Climb& climb : climbs) {
+    keep.push_back(climb.getStartIndex());
+    keep.push_back(climb.getEndIndex());
+  }
+  std::sort(keep.begin(), keep.end());
+  keep.erase(std::unique(keep.begin(), keep.end()), keep.end());
+  vector<unsigned> newIndex(keep.size());
+
+  // First pass: decide where each new point comes from, as an original
+  // index and a fraction of the way to the following point. The
+  // distances only increase, so this is a single merge-like scan.
+  vector<unsigned> source;
+  vector<double> fraction;
+  source.reserve(getTotalDistance() / meters + keep.size() + 2);
+  fraction.reserve(source.capacity());
+
+  source.push_back(0);
+  fraction.push_back(0);
+
+  unsigned k = 0;  // next entry in 'keep'
+  if (k < keep.size() && keep[k] == 0) newIndex[k++] = 0;
+
+  double next = first().length + meters;
+  for (unsigned i = 1; i < size(); i++) {
+    const double from = at(i-1).length;
+    const double to = at(i).length;
+
+    // Points strictly between i-1 and i. Since 'next' is always beyond
+    // 'from', and less than 'to', the division is safe.
+    while (next < to) {
+      source.push_back(i - 1);
+      fraction.push_back((next - from) / (to - from));
+      next += meters;
+    }
+
+    const bool kept = (k < keep.size() && keep[k] == i);
+    if (next == to || kept || i == size() - 1) {
+      if (kept) newIndex[k++] = source.size();
+      source.push_back(i);
+      fraction.push_back(0);
+      if (next == to) next += meters;
+    }
+  }
+  POSTCONDITION(k == keep.size());
+
+  // Second pass: build the new points. This loop has no dependencies
+  // between iterations, and no branches beyond the temperature check.
+  const unsigned lastIndex = size() - 1;
+  vector<Point> replacements(source.size());
+  for (unsigned j = 0; j < source.size(); j++) {
+    const unsigned i = source[j];
+    replacements[j] = interpolate(at(i), at(std::min(i + 1, lastIndex)),
+                                  fraction[j]);
+    replacements[j].seq = j;
+  }
+
+  swap(replacements);
+
+  // Reset the climbs and peaks
+  for (Track::Peak& peak : peaks) {
+    const auto it = std::lower_bound(keep.begin(), keep.end(), peak.index);
+    ASSERTION(it != keep.end() && *it == static_cast<unsigned>(peak.index));
+    peak.index = newIndex[it - keep.begin()];
+  }
+
+  for (Track::Climb& climb : climbs) {
+    auto it = std::lower_bound(keep.begin(), keep.end(),
+                               climb.getStartIndex());
+    ASSERTION(it != keep.end() && *it == climb.getStartIndex());
+    const unsigned new_start = newIndex[it - keep.begin()];
+
+    it = std::lower_bound(keep.begin(), keep.end(), climb.getEndIndex());
+    ASSERTION(it != keep.end() && *it == climb.getEndIndex());
+    const unsigned new_end = newIndex[it - keep.begin()];
+
+    climb.SetStart(new_start);
+    climb.SetEnd(new_end);
+  }
+}
+
+void Track::Simplify(double toleranceMeters, SimplifyMethod method) {
+  PRECONDITION(toleranceMeters > 0);
+
+  if (size() < 3) return;
+  difficulty.clear();
+
+  // As with ShrinkBySample, the points referenced by climbs and peaks
+  // must be retained. Simplifying each stretch between them separately
+  // keeps them, and the ends.
+  vector<unsigned> fixed;
+  fixed.push_back(0);
+  for (const Track::Peak& peak : peaks) {
+    fixed.push_back(peak.index);
+  }
+  for (const Track::Climb& climb : climbs) {
+    fixed.push_back(climb.getStartIndex());
+    fixed.push_back(climb.getEndIndex());
+  }
+  fixed.push_back(size() - 1);
+  std::sort(fixed.begin(), fixed.end());
+  fixed.erase(std::unique(fixed.begin(), fixed.end()), fixed.end());
+
+  vector<unsigned> kept;
+  kept.push_back(0);
+  for (unsigned f = 1; f < fixed.size(); ++f) {
+    const vector<unsigned> points =
+        significantPoints(fixed[f - 1], fixed[f], toleranceMeters, method);
+    // The first is the last of the previous stretch
+    kept.insert(kept.end(), points.begin() + 1, points.end());
+  }
+
+  // Reset the climbs and peaks, before the indexes change
+  auto newIndex = [&](unsigned index) {
+    const auto it = std::lower_bound(kept.begin(), kept.end(), index);
+    ASSERTION(it != kept.end() && *it == index);
+    return static_cast<unsigned>(it - kept.begin());
+  };
+
+  for (Track::Peak& peak : peaks) {
+    peak.index = newIndex(peak.index);
+  }
+  for (Track::Climb& climb : climbs) {
+    const unsigned new_start = newIndex(climb.getStartIndex());
+    const unsigned new_end = newIndex(climb.getEndIndex());
+    climb.SetStart(new_start);
+    climb.SetEnd(new_end);
+  }
+
+  // Renumbered, since the writers use a climb's seq as its row
+  for (unsigned i = 0; i < kept.size(); ++i) {
+    at(i) = at(kept[i]);
+    at(i).seq = i;
+  }
+  erase(begin() + kept.size(), end());
+}
+
 // Remove points within the given rectangle
 void Track::Mask(double minLon, double maxLon, double minLat, double maxLat) {
+  difficulty.clear();
   unsigned i = 0;
   while (i < size()) {
     const Point& p = at(i);
@@ -197,6 +380,7 @@ void Track::Mask(double minLon, double maxLon, double minLat, double maxLat) {
 }
 
 void Track::RemoveBurrs() {
+  difficulty.clear();
   unsigned presize;
   do {
     presize = size();
@@ -220,6 +404,7 @@ void Track::RemoveBurrs() {
 }
 
 void Track::CalculateLength() {
+  difficulty.clear();
   double running = 0;
   for (unsigned i = 0; i < size(); ++i) {
     if (i > 0) {
@@ -232,6 +417,7 @@ void Track::CalculateLength() {
 // Decay the elevation. This helps if you're using GPS elevation, which
 // is very noisy
 void Track::decayElevation(int samples) {
+  difficulty.clear();
   double running;
   for (unsigned i = 0; i < size(); ++i) {
     if (i == 0) {
@@ -452,6 +638,171 @@ double Track::getMinimumElevation() const {
   return min;
 }
 
+void Track::getBounds(double& minLon, double& maxLon,
+                      double& minLat, double& maxLat) const {
+  PRECONDITION(!empty());
+
+  minLon = maxLon = first().lon;
+  minLat = maxLat = first().lat;
+  for (const Point& p : *this) {
+    minLon = std::min(minLon, p.lon);
+    maxLon = std::max(maxLon, p.lon);
+    minLat = std::min(minLat, p.lat);
+    maxLat = std::max(maxLat, p.lat);
+  }
+}
+
+namespace {
+
+constexpr double pi = 3.14159265358979323846;
+constexpr double kMetersPerDegree = 6371000 * pi / 180;
+
+// Return the distance in meters from 'p' to the line segment from 'a' to
+// 'b', on a flat projection where longitude is scaled by 'lonScale'.
+// That's plenty accurate over the distances between track points.
+double distanceToSegment(const Point& p, const Point& a, const Point& b,
+                         double lonScale) {
+  const double bx = (b.lon - a.lon) * lonScale;
+  const double by = b.lat - a.lat;
+  const double px = (p.lon - a.lon) * lonScale;
+  const double py = p.lat - a.lat;
+
+  const double lengthSquared = bx * bx + by * by;
+  double t = 0;
+  if (lengthSquared > 0) {
+    t = std::max(0.0, std::min(1.0, (px * bx + py * by) / lengthSquared));
+  }
+
+  return hypot(px - t * bx, py - t * by) * kMetersPerDegree;
+}
+
+// Return the area in square meters of the triangle a, b, c, on the same
+// projection as above.
+double triangleArea(const Point& a, const Point& b, const Point& c,
+                    double lonScale) {
+  const double bx = (b.lon - a.lon) * lonScale;
+  const double by = b.lat - a.lat;
+  const double cx = (c.lon - a.lon) * lonScale;
+  const double cy = c.lat - a.lat;
+
+  return fabs(bx * cy - by * cx) / 2 * kMetersPerDegree * kMetersPerDegree;
+}
+
+// Visvalingam-Whyatt, for Track::significantPoints. The points form a
+// linked list, and a heap orders them by the area of the triangle with
+// their neighbors. Removing a point changes its neighbors' areas, so
+// they're pushed again, and outdated heap entries are skipped.
+vector<bool> visvalingam(const Track& track, unsigned start, unsigned end,
+                         double tolerance, double lonScale) {
+  const unsigned n = end - start + 1;
+  const double limit = tolerance * tolerance;
+
+  vector<bool> keep(n, true);
+  vector<unsigned> prev(n);
+  vector<unsigned> next(n);
+  vector<double> area(n, DBL_MAX);
+
+  auto areaAt = [&](unsigned i) {
+    return triangleArea(track[start + prev[i]], track[start + i],
+                        track[start + next[i]], lonScale);
+  };
+
+  typedef pair<double, unsigned> Entry;
+  priority_queue<Entry, vector<Entry>, greater<Entry>> heap;
+  for (unsigned i = 0; i < n; ++i) {
+    prev[i] = (i > 0) ? i - 1 : 0;
+    next[i] = (i < n - 1) ? i + 1 : n - 1;
+  }
+  for (unsigned i = 1; i < n - 1; ++i) {
+    area[i] = areaAt(i);
+    heap.push(make_pair(area[i], i));
+  }
+
+  while (!heap.empty()) {
+    const Entry entry = heap.top();
+    heap.pop();
+
+    const unsigned i = entry.second;
+    if (!keep[i] || entry.first != area[i]) continue;  // outdated
+    if (entry.first >= limit) break;
+
+    keep[i] = false;
+    next[prev[i]] = next[i];
+    prev[next[i]] = prev[i];
+
+    // A neighbor's area never drops below the area just removed, so
+    // points are removed in a consistent order.
+    for (unsigned j : { prev[i], next[i] }) {
+      if (j == 0 || j == n - 1) continue;
+      area[j] = std::max(areaAt(j), entry.first);
+      heap.push(make_pair(area[j], j));
+    }
+  }
+
+  return keep;
+}
+
+}  // namespace
+
+vector<unsigned> Track::significantPoints(unsigned start, unsigned end,
+                                          double tolerance,
+                                          SimplifyMethod method) const {
+  PRECONDITION(start <= end);
+  PRECONDITION(end < size());
+
+  vector<unsigned> result;
+  if (tolerance <= 0 || end - start < 2) {
+    for (unsigned i = start; i <= end; ++i) result.push_back(i);
+    return result;
+  }
+
+  const double lonScale = cos(at(start).lat * pi / 180);
+
+  if (method == VISVALINGAM_WHYATT) {
+    const vector<bool> keep =
+        visvalingam(*this, start, end, tolerance, lonScale);
+    for (unsigned i = start; i <= end; ++i) {
+      if (keep[i - start]) result.push_back(i);
+    }
+    return result;
+  }
+
+  vector<bool> keep(end - start + 1, false);
+  keep.front() = keep.back() = true;
+
+  // Each range on the stack has both ends kept. Find the point farthest
+  // from the line between them, and if it's too far, keep it and split
+  // the range there.
+  vector<pair<unsigned, unsigned>> ranges;
+  ranges.push_back(make_pair(start, end));
+  while (!ranges.empty()) {
+    const unsigned a = ranges.back().first;
+    const unsigned b = ranges.back().second;
+    ranges.pop_back();
+
+    double farthest = 0;
+    unsigned index = a;
+    for (unsigned i = a + 1; i < b; ++i) {
+      const double d = distanceToSegment(at(i), at(a), at(b), lonScale);
+      if (d > farthest) {
+        farthest = d;
+        index = i;
+      }
+    }
+
+    if (farthest > tolerance) {
+      keep[index - start] = true;
+      if (index - a > 1) ranges.push_back(make_pair(a, index));
+      if (b - index > 1) ranges.push_back(make_pair(index, b));
+    }
+  }
+
+  for (unsigned i = start; i <= end; ++i) {
+    if (keep[i - start]) result.push_back(i);
+  }
+  return result;
+}
+
 // Return an arbitrary number indicating the relative difficulty of
 // the track
 double Track::calculateDifficulty() const {
@@ -684,24 +1035,47 @@ void Track::calculateClimbs(double minimumGrade,
 
 void Track::mostDifficult(int meters, int& start, int& end,
                           double& score) const {
-  // Find the most difficult stretch of 'meters'.
+  if (empty()) return;
+
+  vector<Difficult>::const_iterator found = difficulty.begin();
+  while (found != difficulty.end() && found->meters != meters) ++found;
 
+  const Difficult best = (found != difficulty.end()) ?
+      *found : difficultyCurve(vector<double>(1, meters))[0];
+  start = best.start;
+  end = best.end;
+  score = best.score;
+}
+
+vector<Track::Difficult> Track::difficultyCurve(
+    const vector<double>& windows) const {
   // Here's what I'll do: for each point, create a 'pain' number
   // (grade^^2 * length), then just scan once for the most difficult
-  // stretch.
+  // stretch of each length.
   //
   // Squaring the grade matches reality, I think, but also unfortunately
   // exaggerates sensor errors. So to combat that, I'm using an extended
   // average. I'm also *not* using the segment grade, because that is also
   // too susceptible to sensor error.
+  //
+  // The pain is kept as a running sum, so the pain of any stretch is a
+  // subtraction, and each scan only needs that and the lengths.
+
+  vector<Difficult> curve(windows.size());
+  for (unsigned w = 0; w < windows.size(); ++w) {
+    curve[w].meters = windows[w];
+    curve[w].start = -1;
+    curve[w].end = -1;
+    curve[w].score = 0;
+  }
+  if (size() < 2) return curve;
 
-  if (empty()) return;
-
-  auto_ptr<double> pain(new double[size()]);
-
+  vector<double> pain(size());
+  vector<double> lengths(size());
   const int SAMPLES = 10;
   double runningGrade = 0;
-  pain.get()[0] = 0;
+  pain[0] = 0;
+  lengths[0] = at(0).length;
 
   for (unsigned i = 1; i < size(); i++) {
     double ele = at(i).elevation - at(i-1).elevation;
@@ -714,38 +1088,283 @@ void Track::mostDifficult(int meters, int& start, int& end,
     // We need to avoid crazy spikes in grade due to sensor error
     runningGrade = (runningGrade * (SAMPLES-1) + grade) / SAMPLES;
 
+    double p = 0;
     if (runningGrade > 0) {
-      pain.get()[i] = (runningGrade * runningGrade) * length;
-    } else {
-      pain.get()[i] = 0;
+      p = (runningGrade * runningGrade) * length;
+    }
+    pain[i] = pain[i - 1] + p;
+    lengths[i] = at(i).length;
+  }
+
+  // Now just find the most difficult span of each length. The pain of
+  // the span from s to i (inclusive) is pain[i] - pain[s - 1].
+  auto scan = [&](Difficult& best) {
+    unsigned s = 0;  // candidate start
+    for (unsigned i = 1; i < lengths.size(); i++) {
+      while ((lengths[i] - lengths[s]) > best.meters) {
+        s++;
+      }
+
+      // We use the fact that we've bumped 's' as an indication that
+      // distance(s,i) is approximately 'meters' long. So, yeah, the
+      // first point will never be included.
+      if (s > 0) {
+        const double total = pain[i] - pain[s - 1];
+        if (total > best.score) {
+          best.score = total;
+          best.start = s;
+          best.end = i;
+        }
+      }
+    }
+  };
+
+  // Scanning is quick, so threads only pay for themselves on a long
+  // track with several lengths
+  const size_t kPointsPerThread = 1 << 18;
+  const unsigned threads = std::min<size_t>(
+      std::min<size_t>(max(1u, thread::hardware_concurrency()),
+                       curve.size()),
+      max<size_t>(1, size() * curve.size() / kPointsPerThread));
+
+  atomic<unsigned> next(0);
+  auto work = [&] {
+    for (unsigned w = next++; w < curve.size(); w = next++) {
+      scan(curve[w]);
     }
+  };
+
+  vector<thread> helpers;
+  for (unsigned i = 1; i < threads; ++i) {
+    helpers.push_back(thread(work));
+  }
+  work();
+  for (thread& helper : helpers) {
+    helper.join();
   }
 
-  // Now just find the most difficult 'meters' span
-  score = 0;
-  start = -1;
-  end = -1;
+  return curve;
+}
 
-  int s = 0; // candidate start
-  double total = 0;
+void Track::calculateDifficultyCurve(const vector<double>& windows) {
+  difficulty = difficultyCurve(windows);
+}
 
-  for (unsigned i = 1; i < size(); i++) {
-    total += pain.get()[i];
-    while ((at(i).length - at(s).length) > meters) {
-      total -= pain.get()[s];
-      s++;
+const vector<double>& Track::defaultDifficultyWindows() {
+  static const vector<double> windows = {
+    200, 500, kDifficultMeters, 2000, 5000, 10000, 20000
+  };
+  return windows;
+}
+
+// The mean-max curve of one piece of a ride, of 'values' at 'times',
+// which are in order, with no gap longer than kMeanMaxGap
+static vector<Track::MeanMax> meanMaxOfPiece(const vector<time_t>& times,
+                                             const vector<double>& values,
+                                             Track::MeanMaxField field) {
+  vector<Track::MeanMax> curve;
+  if (times.size() < 2) return curve;
+
+  // Resample to a value a second, so the average over a span is the
+  // difference of two sums, divided by its length. For speed, the sum is
+  // the length itself; for heart rate, it's the running sum of the
+  // samples, after a leading 0.
+  const size_t seconds = times.back() - times.front();
+  vector<double> sums;
+  sums.reserve(seconds + 2);
+  if (field == Track::HEART_RATE) sums.push_back(0);
+
+  unsigned j = 0;
+  for (size_t k = 0; k <= seconds; ++k) {
+    const time_t t = times.front() + k;
+    while (times[j + 1] < t) ++j;
+
+    const double fraction =
+        static_cast<double>(t - times[j]) / (times[j + 1] - times[j]);
+    const double value = values[j] + fraction * (values[j + 1] - values[j]);
+    sums.push_back((field == Track::SPEED) ? value : sums.back() + value);
+  }
+
+  for (unsigned duration : Track::meanMaxDurations(sums.size() - 1)) {
+    const double* const sum = sums.data();
+    const size_t starts = sums.size() - duration;
+
+    // Four maxima at once, so each comparison needn't wait for the one
+    // before, and the loop vectorizes
+    double lanes[4];
+    std::fill(lanes, lanes + 4, -DBL_MAX);
+    size_t t = 0;
+    for ( ; t + 4 <= starts; t += 4) {
+      for (int lane = 0; lane < 4; ++lane) {
+        lanes[lane] = std::max(lanes[lane],
+                               sum[t + lane + duration] - sum[t + lane]);
+      }
+    }
+    for ( ; t < starts; ++t) {
+      lanes[0] = std::max(lanes[0], sum[t + duration] - sum[t]);
+    }
+    const double best = *std::max_element(lanes, lanes + 4);
+
+    // Then find the first span with it, which is quicker than keeping
+    // track of where each lane's maximum was. (Only values that aren't
+    // numbers could keep it from being found.)
+    size_t first = 0;
+    while (first + 1 < starts && sum[first + duration] - sum[first] != best) {
+      ++first;
     }
 
-    // We use the fact that we've bumped 's' as an indication that
-    // distance(s,i) is approximately 'meters' long. So, yeah, the
-    // first point will never be included.
-        
-    if (s > 0) {
-      if (total > score) {
-	score = total;
-	start = s;
-	end = i;
+    Track::MeanMax result;
+    result.seconds = duration;
+    result.value = best / duration;
+    result.start = times.front() + first;
+    curve.push_back(result);
+  }
+  return curve;
+}
+
+vector<Track::MeanMax> Track::meanMaxCurve(MeanMaxField field) const {
+  // The points with a time and the field, in pieces in time order. Of
+  // several at the same time, the last is kept.
+  vector<MeanMax> curve;
+  vector<time_t> times;
+  vector<double> values;
+  for (const Point& point : *this) {
+    if (point.timestamp <= 0) continue;
+    if (field == HEART_RATE && point.hr <= 0) continue;
+
+    if (!times.empty() && (point.timestamp < times.back() ||
+                           point.timestamp - times.back() > kMeanMaxGap)) {
+      curve = mergeMeanMax(curve, meanMaxOfPiece(times, values, field));
+      times.clear();
+      values.clear();
+    }
+
+    const double value = (field == SPEED) ? point.length : point.hr;
+    if (!times.empty() && point.timestamp == times.back()) {
+      values.back() = value;
+    } else {
+      times.push_back(point.timestamp);
+      values.push_back(value);
+    }
+  }
+  return mergeMeanMax(curve, meanMaxOfPiece(times, values, field));
+}
+
+vector<unsigned> Track::meanMaxDurations(unsigned longest) {
+  // Twelve steps to each doubling, rounded to whole seconds
+  const double kStep = pow(2, 1.0 / 12);
+
+  vector<unsigned> durations;
+  double next = 1;
+  unsigned duration = 1;
+  while (duration <= longest) {
+    durations.push_back(duration);
+    next *= kStep;
+    duration = max<unsigned>(duration + 1, lround(next));
+  }
+  return durations;
+}
+
+vector<Track::MeanMax> Track::mergeMeanMax(const vector<MeanMax>& a,
+                                           const vector<MeanMax>& b) {
+  vector<MeanMax> merged;
+  merged.reserve(max(a.size(), b.size()));
+
+  size_t i = 0;
+  size_t j = 0;
+  while (i < a.size() || j < b.size()) {
+    if (j == b.size() || (i < a.size() && a[i].seconds < b[j].seconds)) {
+      merged.push_back(a[i++]);
+    } else if (i == a.size() || b[j].seconds < a[i].seconds) {
+      merged.push_back(b[j++]);
+    } else {
+      // The same duration in both. The earlier one wins a tie.
+      merged.push_back((b[j].value > a[i].value) ? b[j] : a[i]);
+      ++i;
+      ++j;
+    }
+  }
+  return merged;
+}
+
+double Track::frechetDistance(const Track& other, double spacing, double band,
+                              double limit) const {
+  PRECONDITION(spacing > 0);
+  PRECONDITION(band >= 0);
+
+  // Only the points are needed, not the climbs or peaks
+  Track a;
+  a.assign(begin(), end());
+  a.ResampleByDistance(spacing);
+
+  Track b;
+  b.assign(other.begin(), other.end());
+  b.ResampleByDistance(spacing);
+
+  if (a.empty() || b.empty()) return DBL_MAX;
+
+  // Any coupling pairs the two starts and the two ends, so each of those
+  // is a lower bound on the result. They're cheap, so check them first.
+  if (a.front().distance(b.front()) > limit ||
+      a.back().distance(b.back()) > limit) {
+    return DBL_MAX;
+  }
+
+  // Row 'i' (a point in 'a') is only compared with the columns (points in
+  // 'b') within 'width' of the diagonal. The band must be at least as wide
+  // as the slope of the diagonal, or consecutive rows wouldn't connect.
+  const int rows = a.size();
+  const int cols = b.size();
+  const double slope = (rows > 1) ? (cols - 1.0) / (rows - 1) : cols;
+  const int width = std::max(static_cast<int>(band / spacing),
+                             static_cast<int>(ceil(slope)) + 1);
+
+  // Only two rows of the coupling matrix are needed at any time. Cells
+  // outside the band, or whose value exceeds 'limit', hold DBL_MAX.
+  vector<double> prev(cols, DBL_MAX);
+  vector<double> cur(cols, DBL_MAX);
+  int prevLo = 0;
+  int prevHi = -1;
+
+  for (int i = 0; i < rows; ++i) {
+    const int lo = std::max(0, static_cast<int>(floor(i * slope)) - width);
+    const int hi = std::min(cols - 1,
+                            static_cast<int>(ceil(i * slope)) + width);
+
+    double rowMin = DBL_MAX;
+    for (int j = lo; j <= hi; ++j) {
+      double reach = DBL_MAX;
+      if (i == 0 && j == 0) {
+        reach = 0;
+      }
+      if (j >= prevLo && j <= prevHi) {
+        reach = std::min(reach, prev[j]);
+      }
+      if (j - 1 >= prevLo && j - 1 <= prevHi) {
+        reach = std::min(reach, prev[j-1]);
+      }
+      if (j > lo) {
+        reach = std::min(reach, cur[j-1]);
       }
+
+      cur[j] = DBL_MAX;
+      if (reach <= limit) {
+        const double d = std::max(reach, a[i].distance(b[j]));
+        if (d <= limit) cur[j] = d;
+      }
+      rowMin = std::min(rowMin, cur[j]);
     }
+
+    // Every coupling passes through every row, so if nothing in this
+    // row is within the limit, the result can't be either.
+    if (rowMin > limit) return DBL_MAX;
+
+    prev.swap(cur);
+    prevLo = lo;
+    prevHi = hi;
   }
+
+  // After the final swap, the last row is in 'prev'
+  POSTCONDITION(prevHi == cols - 1);
+  return prev[cols - 1];
 }
@@ -3,6 +3,7 @@
 
 #include "point.h"
 
+#include <cfloat>
 #include <string>
 #include <vector>
 
@@ -40,6 +41,42 @@ public:
     unsigned end;
   };
 
+  // The most difficult stretch of one length (see mostDifficult)
+  struct Difficult {
+    double meters;  // the length asked for
+    int start;      // index of the first point, or -1 if there's none
+    int end;        // index of the last point, or -1
+    double score;
+  };
+
+  // What meanMaxCurve averages
+  enum MeanMaxField {
+    SPEED,       // meters/second, from the length and timestamps
+    HEART_RATE   // beats/minute, where it was recorded
+  };
+
+  // The best average of a field over spans of one duration
+  struct MeanMax {
+    unsigned seconds;  // the duration
+    double value;      // the best average
+    time_t start;      // when the span with that average began
+  };
+
+  // The length of the most difficult stretch the report and the writers
+  // show, in meters
+  static const int kDifficultMeters = 1000;
+
+  // Ways to decide which points matter to the shape of a track
+  enum SimplifyMethod {
+    // Keep the point farthest from the line between the points kept so
+    // far, until every point is within the tolerance of that line.
+    DOUGLAS_PEUCKER,
+
+    // Repeatedly drop the point forming the smallest triangle with its
+    // neighbors, while that area is less than the tolerance squared.
+    VISVALINGAM_WHYATT
+  };
+
   Track() {}
 
   void setName(const std::string & n) { name = n; }
@@ -55,6 +92,18 @@ public:
   // Shrink the track by averaging points down to the desired size
   void ShrinkByAverage(unsigned points);
 
+  // Replace the points with points exactly 'meters' apart along the
+  // track, interpolating between the original points. The first and last
+  // points, and any referenced by climbs or peaks, are also retained.
+  void ResampleByDistance(double meters);
+
+  // Remove points that don't affect the shape of the track on the map,
+  // by more than about 'toleranceMeters'. Unlike the other methods, this
+  // keeps corners and switchbacks. The first and last points, and any
+  // referenced by climbs or peaks, are retained.
+  void Simplify(double toleranceMeters,
+                SimplifyMethod method = DOUGLAS_PEUCKER);
+
   // Remove points within the given rectangle
   void Mask(double minLon, double maxLon,
             double minLat, double maxLat);
@@ -138,23 +187,99 @@ public:
 
   // Find the most 'difficult' section of 'meters' length, returning
   // the results in 'start' and 'end'. Difficult, in this context, is
-  // measured with the same arbitrary algorithm as 'calculateDifficulty'
+  // measured with the same arbitrary algorithm as 'calculateDifficulty'.
+  // If calculateDifficultyCurve found it already, that's returned.
   void mostDifficult(int meters, int & start, int & end,
                      double & score) const;
 
+  // Find the most difficult section of each of the lengths in 'windows',
+  // as mostDifficult would, but working out the difficulty of each point
+  // only once. On a long track the lengths are searched in parallel.
+  std::vector<Difficult> difficultyCurve(
+      const std::vector<double>& windows) const;
+
+  // Keep the difficultyCurve for 'windows', for mostDifficult and
+  // getDifficultyCurve. Methods that change the points drop it.
+  void calculateDifficultyCurve(
+      const std::vector<double>& windows = defaultDifficultyWindows());
+
+  // From 200 meters to 20 km, including kDifficultMeters
+  static const std::vector<double>& defaultDifficultyWindows();
+
+  // The best average of 'field' over spans of each of meanMaxDurations,
+  // up to the length of the ride. The track is first resampled to one
+  // value a second by the timestamps, interpolating across gaps of up to
+  // kMeanMaxGap. Points without a time, or without the field (a heart
+  // rate of 0), are skipped. Empty if fewer than two points are left.
+  //
+  // A longer gap, or a step back in time, breaks the ride in two, and no
+  // span crosses the break. So a timestamp far off, like a GPS glitch,
+  // neither takes memory for every second to it nor loses the rest of
+  // the ride, only the spans across it.
+  std::vector<MeanMax> meanMaxCurve(MeanMaxField field) const;
+
+  // The longest gap between points that meanMaxCurve interpolates
+  // across, in seconds
+  static const int kMeanMaxGap = 3600;
+
+  // The durations meanMaxCurve uses, in seconds, up to 'longest': every
+  // second for the first minute or so, then about 6% apart. Every track
+  // uses the same ones, so their curves can be merged.
+  static std::vector<unsigned> meanMaxDurations(unsigned longest);
+
+  // The better of 'a' and 'b' at each duration in either, for the best
+  // of several activities, like a season's
+  static std::vector<MeanMax> mergeMeanMax(const std::vector<MeanMax>& a,
+                                           const std::vector<MeanMax>& b);
+
+  // Return the discrete Frechet distance, in meters, between this track
+  // and 'other'. Unlike a nearest-point comparison this respects the
+  // order of the points, so a route and its reverse are far apart.
+  // Both tracks are first resampled to a point every 'spacing' meters.
+  // A point some fraction of the way along this track may only be paired
+  // with the points of 'other' within 'band' meters of the one the same
+  // fraction of the way along it (a Sakoe-Chiba band around the
+  // proportional diagonal). The band is widened where it must be, to
+  // one more than the points of 'other' per point of this one, so it
+  // stays connected. Only for tracks of the same length is that the same
+  // as pairing points whose distances along them differ by up to 'band'.
+  // If the distance is certain to exceed 'limit' the comparison stops
+  // early and returns DBL_MAX.
+  double frechetDistance(const Track& other, double spacing, double band,
+                         double limit = DBL_MAX) const;
+
   double getMaximumElevation() const;
   double getMinimumElevation() const;
 
+  // Return the indexes of the points from 'start' to 'end' (inclusive)
+  // that keep the shape of the path on the map (elevation is ignored),
+  // to the given tolerance in meters. The first and last are always
+  // included. See SimplifyMethod.
+  std::vector<unsigned> significantPoints(
+      unsigned start, unsigned end, double tolerance,
+      SimplifyMethod method = DOUGLAS_PEUCKER) const;
+
+  // Return the bounding rectangle of the track, in degrees
+  void getBounds(double& minLon, double& maxLon,
+                 double& minLat, double& maxLat) const;
+
   // Only non-empty if you've called calculatePeaks
   const std::vector<Peak>& getPeaks() const { return peaks; }
 
   // Only non-empty if you've called calculateClimbs
   const std::vector<Climb>& getClimbs() const { return climbs; }
 
+  // Only non-empty if you've called calculateDifficultyCurve, and not
+  // changed the points since
+  const std::vector<Difficult>& getDifficultyCurve() const {
+    return difficulty;
+  }
+
  private:
   std::string name;
   std::vector<Peak> peaks;
   std::vector<Climb> climbs;
+  std::vector<Difficult> difficulty;
 };
 
 #endif
@@ -0,0 +1,250 @@
+// trackd: runs 'track' commands sent over a UNIX domain socket (see
+// remote.h), on a pool of threads that stay warm from one request to the
+// next. That saves each request starting a process, and setting up libgd
+// and fontconfig. 'track' itself sends commands here if TRACKD_SOCKET is
+// set to the socket.
+//
+// Clients can't name a cache (-C), or any other file for trackd to
+// write, since it would be written with trackd's privileges. trackd may
+// keep its own, with -C.
+
+#include "command.h"
+#include "exception.h"
+#include "png.h"
+#include "remote.h"
+#include "track.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static void usage() {
+  cerr << "Usage: trackd [-n <threads>] [-C <directory>[,<megabytes>]]"
+       << " <socket-path>" << endl
+       << "Options:" << endl
+       << "             -n <int> (worker threads; default one per core)"
+       << endl
+       << "             -C <directory>[,<megabytes>] (keep results in a"
+       << " cache," << endl
+       << "                for every client; default limit 1024 MB)"
+       << endl;
+}
+
+namespace {
+
+// A client. It's closed once the client has stopped sending, and every
+// response has been sent.
+struct Connection : public NoCopy {
+  explicit Connection(int s) : socket(s) {}
+
+  Descriptor socket;
+  mutex writeLock;  // responses are sent whole, one at a time
+};
+
+// trackd's own cache of results, if it has one
+struct Cache {
+  string directory;
+  uint64_t limit = Command::kDefaultCacheLimit;
+};
+
+struct Job {
+  shared_ptr<Connection> connection;
+  Remote::Request request;
+};
+
+// Requests waiting for a worker, from every connection
+class Queue : public NoCopy {
+ public:
+  void push(Job&& job) {
+    lock_guard<mutex> lock(guard);
+    jobs.push_back(std::move(job));
+    ready.notify_one();
+  }
+
+  Job pop() {
+    unique_lock<mutex> lock(guard);
+    ready.wait(lock, [this] { return !jobs.empty(); });
+    Job job = std::move(jobs.front());
+    jobs.pop_front();
+    return job;
+  }
+
+ private:
+  mutex guard;
+  condition_variable ready;
+  deque<Job> jobs;
+};
+
+// Run one command, just as 'track' would
+Remote::Response process(const Remote::Request& request,
+                         const Cache& cache, PNG::Renderer& renderer) {
+  Remote::Response response;
+  response.id = request.id;
+
+  ostringstream messages;
+  try {
+    // getopt wants writable arguments, and may reorder them
+    vector<string> args(request.args);
+    vector<char*> argv;
+    for (string& arg : args) argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    Command command(messages);
+    command.parse(args.size(), argv.data());
+    if (!command.isSingleTrack()) {
+      throw Exception("trackd only runs commands for a single track, "
+                      "without -C or --trace");
+    }
+    if (!cache.directory.empty()) {
+      command.setCache(cache.directory, cache.limit);
+    }
+
+    istringstream in(request.input);
+    vector<unique_ptr<ostringstream>> outputs;
+    vector<ostream*> streams;
+    for (unsigned i = 0; i < command.getOutputs().size(); ++i) {
+      outputs.push_back(unique_ptr<ostringstream>(new ostringstream));
+      streams.push_back(outputs.back().get());
+    }
+
+    command.run(in, streams, &renderer);
+
+    for (const unique_ptr<ostringstream>& out : outputs) {
+      response.outputs.push_back(out->str());
+    }
+  } catch (const std::exception& e) {
+    messages << e.what() << endl;
+    Command::usage(messages);
+    response.status = 1;
+    response.outputs.clear();
+  }
+
+  response.messages = messages.str();
+  return response;
+}
+
+// Render a small profile, so fontconfig, the font cache and the
+// renderer's canvas are ready before the first real request
+void warmUp(PNG::Renderer& renderer) {
+  Track track;
+  for (int i = 0; i < 10; ++i) {
+    Point point;
+    point.length = i * 100;
+    point.elevation = 100 + i * 5;
+    track.push_back(point);
+  }
+  track.calculateSegmentGrade(100);
+
+  ostringstream discard;
+  renderer.write(discard, track, PNG::Options());
+}
+
+void work(Queue& queue, const Cache& cache) {
+  PNG::Renderer renderer;
+  try {
+    warmUp(renderer);
+  } catch (const std::exception& e) {
+    cerr << "trackd: warming up: " << e.what() << endl;
+  }
+
+  while (true) {
+    Job job = queue.pop();
+    const Remote::Response response =
+        process(job.request, cache, renderer);
+
+    lock_guard<mutex> lock(job.connection->writeLock);
+    try {
+      Remote::send(job.connection->socket.get(), response);
+    } catch (const std::exception&) {
+      // The client has gone away, and there's nobody else to tell
+    }
+  }
+}
+
+// Queue each request from the connection as soon as it arrives, so a
+// client can send several before waiting for the responses.
+void readRequests(shared_ptr<Connection> connection, Queue& queue) {
+  try {
+    while (true) {
+      Job job;
+      if (!Remote::receive(connection->socket.get(), job.request)) break;
+      job.connection = connection;
+      queue.push(std::move(job));
+    }
+  } catch (const std::exception& e) {
+    cerr << "trackd: " << e.what() << endl;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char * argv[]) {
+  try {
+    unsigned threads = max(1u, thread::hardware_concurrency());
+    Cache cache;
+
+    while (true) {
+      const int opt = getopt(argc, argv, "n:C:");
+      if (opt == -1) break;
+
+      switch (opt) {
+        case 'n':
+          threads = strtol(optarg, 0, 0);
+          if (threads < 1 || threads > 1024) {
+            throw Exception("-n (threads) must be from 1 to 1024");
+          }
+          break;
+
+        case 'C':
+          Command::parseCache(optarg, cache.directory, cache.limit);
+          break;
+
+        default:
+          throw Exception("Unknown option");
+      }
+    }
+
+    if (optind != argc - 1) {
+      throw Exception("Expecting one socket path");
+    }
+
+    Descriptor listener(Remote::listen(argv[optind]));
+
+    Queue queue;
+    for (unsigned i = 0; i < threads; ++i) {
+      thread(work, std::ref(queue), std::cref(cache)).detach();
+    }
+
+    while (true) {
+      const int client = ::accept(listener.get(), nullptr, nullptr);
+      if (client < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) continue;
+        throw SystemException(errno, "Accepting a connection");
+      }
+
+      shared_ptr<Connection> connection(new Connection(client));
+      thread(readRequests, connection, std::ref(queue)).detach();
+    }
+
+  } catch (const std::exception& e) {
+    cerr << e.what() << endl;
+  } catch (...) {
+    cerr << "Unknown exception in main" << endl;
+  }
+
+  usage();
+  return 1;
+}
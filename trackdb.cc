@@ -0,0 +1,368 @@
+#include "trackdb.h"
+
+#include "exception.h"
+#include "track.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const char kMagic[8] = { 'T', 'R', 'A', 'C', 'K', 'D', 'B', '1' };
+const uint32_t kVersion = 1;
+
+// Columns start on a cache line
+const uint64_t kAlignment = 64;
+
+const char* const kColumnNames[TrackDB::COLUMN_COUNT] = {
+  "start_time", "end_time", "distance", "climb", "moving_time",
+  "total_time", "average_speed", "moving_speed", "min_lat", "max_lat",
+  "min_lon", "max_lon", "difficulty", "difficult_score", "climbs", "points"
+};
+
+const char* const kPathOffsets = "path.offsets";
+const char* const kPathText = "path.text";
+const char* const kNameOffsets = "name.offsets";
+const char* const kNameText = "name.text";
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t entries;  // in the directory, which follows
+  uint64_t rows;
+};
+
+struct Entry {
+  char name[24];
+  uint64_t offset;
+  uint64_t bytes;
+};
+
+uint64_t align(uint64_t offset) {
+  return (offset + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+}  // namespace
+
+TrackDB::Row::Row() {
+  fill(values, values + COLUMN_COUNT, 0.0);
+}
+
+TrackDB::Row TrackDB::summarize(const string& path, const Track& track) {
+  Row row;
+  row.path = path;
+  row.name = track.getName();
+  if (track.empty()) return row;
+
+  double* v = row.values;
+  v[START_TIME] = track.getStartTime();
+  v[END_TIME] = track.getEndTime();
+  v[DISTANCE] = track.getTotalDistance();
+  v[CLIMB] = track.last().climb;
+  v[MOVING_TIME] = track.calculateMovingTime();
+  v[TOTAL_TIME] = track.calculateTotalTime();
+  if (v[TOTAL_TIME] > 0) v[AVERAGE_SPEED] = v[DISTANCE] / v[TOTAL_TIME];
+  if (v[MOVING_TIME] > 0) v[MOVING_SPEED] = v[DISTANCE] / v[MOVING_TIME];
+  track.getBounds(v[MIN_LON], v[MAX_LON], v[MIN_LAT], v[MAX_LAT]);
+  v[DIFFICULTY] = track.calculateDifficulty();
+
+  int start = -1;
+  int end = -1;
+  double score = 0;
+  track.mostDifficult(Track::kDifficultMeters, start, end, score);
+  if (start >= 0) v[DIFFICULT_SCORE] = score;
+
+  v[CLIMBS] = track.getClimbs().size();
+  v[POINTS] = track.size();
+  return row;
+}
+
+const char* TrackDB::columnName(Column column) {
+  PRECONDITION(column >= 0 && column < COLUMN_COUNT);
+  return kColumnNames[column];
+}
+
+TrackDB::Column TrackDB::findColumn(const string& name) {
+  for (int c = 0; c < COLUMN_COUNT; ++c) {
+    if (name == kColumnNames[c]) return static_cast<Column>(c);
+  }
+  throw Exception("Unknown column '" + name + "'");
+}
+
+TrackDB::Filter TrackDB::parseFilter(const string& text) {
+  // The operators, longest first so "<=" isn't taken for "<"
+  static const struct {
+    const char* text;
+    Filter::Op op;
+  } kOps[] = {
+    { "<=", Filter::LESS_EQUAL }, { ">=", Filter::GREATER_EQUAL },
+    { "!=", Filter::NOT_EQUAL }, { "<", Filter::LESS },
+    { ">", Filter::GREATER }, { "=", Filter::EQUAL }
+  };
+
+  const string::size_type pos = text.find_first_of("<>=!");
+  if (pos == string::npos) {
+    throw Exception("Expecting a filter like distance>=100000, not '" +
+                    text + "'");
+  }
+
+  for (const auto& op : kOps) {
+    const size_t len = strlen(op.text);
+    if (text.compare(pos, len, op.text) != 0) continue;
+
+    Filter filter;
+    filter.column = findColumn(text.substr(0, pos));
+    filter.op = op.op;
+
+    const char* value = text.c_str() + pos + len;
+    char* end = nullptr;
+    filter.value = strtod(value, &end);
+    if (end == value || *end != 0) {
+      throw Exception("Invalid number in filter '" + text + "'");
+    }
+    return filter;
+  }
+
+  throw Exception("Unknown operator in filter '" + text + "'");
+}
+
+TrackDB::TrackDB(const string& filename) : file(filename), rows(0) {
+  fill(columns, columns + COLUMN_COUNT, nullptr);
+  if (file.size() == 0) return;
+
+  const char* const base = file.data();
+  const size_t length = file.size();
+  if (length < sizeof(Header)) {
+    throw Exception(filename + " is not a track database");
+  }
+
+  Header header;
+  memcpy(&header, base, sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    throw Exception(filename + " is not a track database");
+  }
+  if (header.version != kVersion) {
+    throw Exception(filename + " is from a different version of trackdb");
+  }
+  if (header.entries > (length - sizeof(Header)) / sizeof(Entry)) {
+    throw Exception(filename + " is damaged (directory)");
+  }
+  rows = header.rows;
+
+  // Find each entry, and check that it fits in the file. Its size is left
+  // in 'found'.
+  uint64_t found = 0;
+  auto find = [&](const char* name, uint64_t bytes) -> const char* {
+    for (uint32_t i = 0; i < header.entries; ++i) {
+      Entry entry;
+      memcpy(&entry, base + sizeof(Header) + i * sizeof(Entry),
+             sizeof(entry));
+      if (strncmp(entry.name, name, sizeof(entry.name)) != 0) continue;
+
+      if (entry.offset > length || entry.bytes > length - entry.offset ||
+          (bytes != 0 && entry.bytes != bytes) ||
+          entry.offset % sizeof(uint64_t) != 0) {
+        throw Exception(filename + " is damaged (" + name + ")");
+      }
+      found = entry.bytes;
+      return base + entry.offset;
+    }
+    throw Exception(filename + " has no column " + name);
+  };
+
+  if (rows > length / sizeof(double)) {
+    throw Exception(filename + " is damaged (rows)");
+  }
+  const uint64_t columnBytes = rows * sizeof(double);
+  for (int c = 0; c < COLUMN_COUNT; ++c) {
+    columns[c] = reinterpret_cast<const double*>(
+        find(kColumnNames[c], columnBytes));
+  }
+
+  auto strings = [&](const char* offsetsName, const char* textName,
+                     Strings& table) {
+    table.offsets = reinterpret_cast<const uint64_t*>(
+        find(offsetsName, (rows + 1) * sizeof(uint64_t)));
+    table.text = find(textName, 0);
+
+    // Make sure every string is within the text
+    if (table.offsets[0] != 0 || table.offsets[rows] > found) {
+      throw Exception(filename + " is damaged (" + textName + ")");
+    }
+    for (size_t r = 0; r < rows; ++r) {
+      if (table.offsets[r] > table.offsets[r + 1]) {
+        throw Exception(filename + " is damaged (" + textName + ")");
+      }
+    }
+  };
+  strings(kPathOffsets, kPathText, paths);
+  strings(kNameOffsets, kNameText, names);
+}
+
+string TrackDB::path(size_t row) const {
+  PRECONDITION(row < rows);
+  return paths.get(row);
+}
+
+string TrackDB::name(size_t row) const {
+  PRECONDITION(row < rows);
+  return names.get(row);
+}
+
+size_t TrackDB::select(const vector<Filter>& filters,
+                       vector<uint8_t>& selected) const {
+  selected.assign(rows, 1);
+  uint8_t* const s = selected.data();
+
+  // One pass over the column per filter. The loops have no branches, so
+  // the compiler can vectorize them.
+  for (const Filter& filter : filters) {
+    const double* const v = columns[filter.column];
+    const double x = filter.value;
+    switch (filter.op) {
+      case Filter::LESS:
+        for (size_t i = 0; i < rows; ++i) s[i] &= (v[i] < x);
+        break;
+      case Filter::LESS_EQUAL:
+        for (size_t i = 0; i < rows; ++i) s[i] &= (v[i] <= x);
+        break;
+      case Filter::GREATER:
+        for (size_t i = 0; i < rows; ++i) s[i] &= (v[i] > x);
+        break;
+      case Filter::GREATER_EQUAL:
+        for (size_t i = 0; i < rows; ++i) s[i] &= (v[i] >= x);
+        break;
+      case Filter::EQUAL:
+        for (size_t i = 0; i < rows; ++i) s[i] &= (v[i] == x);
+        break;
+      case Filter::NOT_EQUAL:
+        for (size_t i = 0; i < rows; ++i) s[i] &= (v[i] != x);
+        break;
+    }
+  }
+
+  size_t count = 0;
+  for (size_t i = 0; i < rows; ++i) count += s[i];
+  return count;
+}
+
+TrackDB::Aggregate TrackDB::aggregate(Column c,
+                                      const vector<uint8_t>& selected) const {
+  PRECONDITION(selected.size() == rows);
+
+  Aggregate result;
+  const double* const v = columns[c];
+  for (size_t i = 0; i < rows; ++i) {
+    if (!selected[i]) continue;
+    if (result.count == 0) {
+      result.min = result.max = v[i];
+    } else {
+      result.min = std::min(result.min, v[i]);
+      result.max = std::max(result.max, v[i]);
+    }
+    result.sum += v[i];
+    ++result.count;
+  }
+  return result;
+}
+
+void TrackDB::write(const string& filename, const TrackDB& existing,
+                    const vector<Row>& added) {
+  const uint64_t total = existing.size() + added.size();
+
+  // Gather the strings
+  vector<uint64_t> pathOffsets(1, 0);
+  vector<uint64_t> nameOffsets(1, 0);
+  string pathText;
+  string nameText;
+  for (size_t r = 0; r < existing.size(); ++r) {
+    pathText += existing.path(r);
+    nameText += existing.name(r);
+    pathOffsets.push_back(pathText.size());
+    nameOffsets.push_back(nameText.size());
+  }
+  for (const Row& row : added) {
+    pathText += row.path;
+    nameText += row.name;
+    pathOffsets.push_back(pathText.size());
+    nameOffsets.push_back(nameText.size());
+  }
+
+  // Lay out the file: the header, the directory, then each entry
+  vector<Entry> entries;
+  vector<pair<const char*, uint64_t>> contents;  // for each entry
+  uint64_t offset = sizeof(Header) + (COLUMN_COUNT + 4) * sizeof(Entry);
+  auto add = [&](const char* name, const char* bytes, uint64_t len) {
+    Entry entry;
+    memset(&entry, 0, sizeof(entry));
+    strncpy(entry.name, name, sizeof(entry.name) - 1);
+    offset = align(offset);
+    entry.offset = offset;
+    entry.bytes = len;
+    offset += len;
+    entries.push_back(entry);
+    contents.push_back(make_pair(bytes, len));
+  };
+
+  vector<vector<double>> columns(COLUMN_COUNT);
+  for (int c = 0; c < COLUMN_COUNT; ++c) {
+    vector<double>& values = columns[c];
+    values.reserve(total);
+    values.insert(values.end(), existing.column(static_cast<Column>(c)),
+                  existing.column(static_cast<Column>(c)) + existing.size());
+    for (const Row& row : added) {
+      values.push_back(row.values[c]);
+    }
+    add(kColumnNames[c], reinterpret_cast<const char*>(values.data()),
+        total * sizeof(double));
+  }
+  add(kPathOffsets, reinterpret_cast<const char*>(pathOffsets.data()),
+      pathOffsets.size() * sizeof(uint64_t));
+  add(kPathText, pathText.data(), pathText.size());
+  add(kNameOffsets, reinterpret_cast<const char*>(nameOffsets.data()),
+      nameOffsets.size() * sizeof(uint64_t));
+  add(kNameText, nameText.data(), nameText.size());
+
+  Header header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.entries = entries.size();
+  header.rows = total;
+
+  const string temporary = filename + ".tmp." + to_string(::getpid());
+  {
+    ofstream out(temporary.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!out) {
+      throw SystemException(errno, "Unable to open " + temporary);
+    }
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()),
+              entries.size() * sizeof(Entry));
+    uint64_t written = sizeof(header) + entries.size() * sizeof(Entry);
+    static const char padding[kAlignment] = {};
+    for (size_t i = 0; i < entries.size(); ++i) {
+      out.write(padding, entries[i].offset - written);
+      out.write(contents[i].first, contents[i].second);
+      written = entries[i].offset + contents[i].second;
+    }
+
+    out.close();
+    if (!out) {
+      ::unlink(temporary.c_str());
+      throw Exception("Error writing " + temporary);
+    }
+  }
+
+  if (::rename(temporary.c_str(), filename.c_str()) != 0) {
+    const int error = errno;
+    ::unlink(temporary.c_str());
+    throw SystemException(error, "Unable to rename " + temporary);
+  }
+}
@@ -0,0 +1,125 @@
+#if !defined TRACKDB_H
+#define      TRACKDB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "util.h"
+
+class Track;
+
+// A catalog of activity summaries: one row per activity, stored by column
+// so a query reads only the columns it uses, straight from the file
+// mapped into memory.
+//
+// Every column holds a double per row, except the path and name, which
+// are kept as string tables. The file starts with a header and a
+// directory of columns by name, so columns can be added without breaking
+// older files. A database is never changed in place: adding rows writes
+// a new file and renames it over the old one, so readers always see a
+// whole database.
+class TrackDB : public NoCopy {
+ public:
+  enum Column {
+    START_TIME,       // seconds since the epoch
+    END_TIME,
+    DISTANCE,         // meters
+    CLIMB,            // meters
+    MOVING_TIME,      // seconds
+    TOTAL_TIME,
+    AVERAGE_SPEED,    // meters/second, over the total time
+    MOVING_SPEED,     // meters/second, over the moving time
+    MIN_LAT,          // bounding box, in degrees
+    MAX_LAT,
+    MIN_LON,
+    MAX_LON,
+    DIFFICULTY,       // see Track::calculateDifficulty
+    DIFFICULT_SCORE,  // the most difficult kilometer; 0 if none
+    CLIMBS,           // the number of climbs
+    POINTS,
+    COLUMN_COUNT
+  };
+
+  // The summary of one activity
+  struct Row {
+    Row();
+
+    std::string path;
+    std::string name;
+    double values[COLUMN_COUNT];
+  };
+
+  // Compare a column with a value
+  struct Filter {
+    enum Op { LESS, LESS_EQUAL, GREATER, GREATER_EQUAL, EQUAL, NOT_EQUAL };
+
+    Column column;
+    Op op;
+    double value;
+  };
+
+  struct Aggregate {
+    size_t count = 0;
+    double sum = 0;
+    double min = 0;  // only valid if count > 0
+    double max = 0;
+  };
+
+  // Summarize a track that's been analyzed, with its climbs found
+  static Row summarize(const std::string& path, const Track& track);
+
+  static const char* columnName(Column column);
+
+  // The column with the given name. Throws an Exception if there isn't one.
+  static Column findColumn(const std::string& name);
+
+  // Parse a filter like "distance>=100000". Throws an Exception if it's
+  // not valid.
+  static Filter parseFilter(const std::string& text);
+
+  // Map the database in 'filename'. A missing file is an empty database.
+  explicit TrackDB(const std::string& filename);
+
+  size_t size() const { return rows; }
+
+  // All the values of a column, one per row
+  const double* column(Column c) const { return columns[c]; }
+
+  std::string path(size_t row) const;
+  std::string name(size_t row) const;
+
+  // Set 'selected' to 1 for each row that passes all the filters, and 0
+  // for the rest. Returns the number selected.
+  size_t select(const std::vector<Filter>& filters,
+                std::vector<uint8_t>& selected) const;
+
+  // Aggregate a column over the selected rows
+  Aggregate aggregate(Column c, const std::vector<uint8_t>& selected) const;
+
+  // Write a database to 'filename' with the rows of 'existing' followed
+  // by 'added', replacing whatever was there.
+  static void write(const std::string& filename, const TrackDB& existing,
+                    const std::vector<Row>& added);
+
+ private:
+  // A table of strings, one per row: 'rows + 1' offsets into 'text'
+  struct Strings {
+    const uint64_t* offsets = nullptr;
+    const char* text = nullptr;
+
+    std::string get(size_t row) const {
+      return std::string(text + offsets[row], offsets[row + 1] - offsets[row]);
+    }
+  };
+
+  MappedFile file;
+  size_t rows;
+  const double* columns[COLUMN_COUNT];
+  Strings paths;
+  Strings names;
+};
+
+#endif
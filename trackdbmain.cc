@@ -0,0 +1,405 @@
+// trackdb: keeps a catalog of activity summaries (see trackdb.h), and
+// answers questions about them without reading the activities again.
+//
+//   trackdb ingest [-r] <db> <files...>
+//   trackdb count <db> [-w <filter>]...
+//   trackdb sum|min|max|avg <db> <column> [-w <filter>]...
+//   trackdb list <db> [-w <filter>]... [-s [-]<column>] [-n <rows>]
+//   trackdb within <db> -b <min-lat>,<min-lon>,<max-lat>,<max-lon>
+//   trackdb near <db> -p <lat>,<lon>,<meters>
+
+#include "cellindex.h"
+#include "command.h"
+#include "dtoa.h"
+#include "exception.h"
+#include "track.h"
+#include "trackdb.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static void usage() {
+  cerr << "Usage: trackdb ingest [-r] <db> <files...>" << endl
+       << "       trackdb count <db> [-w <filter>]..." << endl
+       << "       trackdb sum|min|max|avg <db> <column> [-w <filter>]..."
+       << endl
+       << "       trackdb list <db> [-w <filter>]... [-s [-]<column>]"
+       << " [-n <rows>]" << endl
+       << "       trackdb within <db> -b <min-lat>,<min-lon>,<max-lat>,"
+       << "<max-lon> [-w <filter>]..." << endl
+       << "       trackdb near <db> -p <lat>,<lon>,<meters>"
+       << " [-w <filter>]..." << endl
+       << "Options:" << endl
+       << "             -r (remove burrs, as track -r)" << endl
+       << "             -w <filter> (only rows where, eg, distance>=100000)"
+       << endl
+       << "             -s <column> (sort by the column; -<column> for"
+       << " descending)" << endl
+       << "             -n <rows> (at most this many rows)" << endl
+       << "             -b <box> (activities that passed through the box)"
+       << endl
+       << "             -p <position> (activities that passed within the"
+       << " distance)" << endl
+       << "             A file named - means read file names from stdin"
+       << endl
+       << "Columns:";
+  for (int c = 0; c < TrackDB::COLUMN_COUNT; ++c) {
+    cerr << (c % 6 == 0 ? "\n             " : " ")
+         << TrackDB::columnName(static_cast<TrackDB::Column>(c));
+  }
+  cerr << endl;
+}
+
+static string number(double value) {
+  char buffer[Dtoa::kBufferSize];
+  return string(buffer, Dtoa::shortest(value, buffer));
+}
+
+static string csvField(const string& value) {
+  if (value.find_first_of(",\"\r\n") == string::npos) return value;
+
+  string quoted = "\"";
+  for (char c : value) {
+    if (c == '"') quoted += '"';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+// The cell index of the database in 'db'
+static string cellIndexFile(const string& db) {
+  return db + ".cells";
+}
+
+// Parse 'count' numbers separated by commas
+static vector<double> parseNumbers(const string& text, size_t count) {
+  vector<double> numbers;
+  const char* p = text.c_str();
+  while (true) {
+    char* end = nullptr;
+    numbers.push_back(strtod(p, &end));
+    if (end == p) break;
+    p = end;
+    if (*p != ',') break;
+    ++p;
+  }
+  if (numbers.size() != count || *p != 0) {
+    throw Exception("Expecting " + to_string(count) +
+                    " numbers separated by commas, not '" + text + "'");
+  }
+  return numbers;
+}
+
+// The same file named two ways should only be added once
+static string canonicalPath(const string& path) {
+  char resolved[PATH_MAX];
+  if (::realpath(path.c_str(), resolved) == nullptr) return path;
+  return resolved;
+}
+
+// Summarize each new file, on one thread per core, and add them all to
+// the database at once. A file that fails is reported and skipped.
+static int ingest(int argc, char* argv[]) {
+  bool removeBurrs = false;
+  while (true) {
+    const int opt = getopt(argc, argv, "r");
+    if (opt == -1) break;
+    switch (opt) {
+      case 'r':
+        removeBurrs = true;
+        break;
+      default:
+        throw Exception("Unknown option");
+    }
+  }
+  if (argc - optind < 2) {
+    throw Exception("Expecting a database and some files");
+  }
+
+  const string db = argv[optind++];
+  vector<string> files;
+  for ( ; optind < argc; ++optind) {
+    if (string(argv[optind]) == "-") {
+      string line;
+      while (getline(cin, line)) {
+        if (!line.empty()) files.push_back(line);
+      }
+    } else {
+      files.push_back(argv[optind]);
+    }
+  }
+
+  // Analyze each track as 'track -q -c' would, so the climbs are found
+  vector<string> args = { "track", "-q", "-c" };
+  if (removeBurrs) args.push_back("-r");
+  vector<char*> trackArgv;
+  for (string& arg : args) trackArgv.push_back(&arg[0]);
+  Command command;
+  command.parse(trackArgv.size(), trackArgv.data());
+
+  const TrackDB existing(db);
+  set<string> seen;
+  for (size_t r = 0; r < existing.size(); ++r) {
+    seen.insert(existing.path(r));
+  }
+
+  // The index's ids are the database's rows. Rows that aren't in the
+  // index yet (as when it's new) are read again, to add them.
+  const string cellsFile = cellIndexFile(db);
+  const CellIndex cells(cellsFile);
+  if (cells.activities() > existing.size()) {
+    throw Exception(cellsFile + " has more activities than " + db);
+  }
+  vector<string> paths;
+  for (size_t r = cells.activities(); r < existing.size(); ++r) {
+    paths.push_back(existing.path(r));
+  }
+  const size_t reindexed = paths.size();
+
+  for (const string& file : files) {
+    const string path = canonicalPath(file);
+    if (seen.insert(path).second) paths.push_back(path);
+  }
+
+  vector<TrackDB::Row> rows(paths.size());
+  vector<vector<CellIndex::Visit>> visits(paths.size());
+  vector<uint8_t> ok(paths.size(), 0);
+  atomic<size_t> next(0);
+  mutex errorLock;
+
+  auto work = [&] {
+    for (size_t i = next++; i < paths.size(); i = next++) {
+      try {
+        Track track;
+        command.read(paths[i], track);
+        rows[i] = TrackDB::summarize(paths[i], track);
+        visits[i] = CellIndex::visits(track);
+        ok[i] = 1;
+      } catch (const std::exception& e) {
+        lock_guard<mutex> lock(errorLock);
+        cerr << paths[i] << ": " << e.what() << endl;
+      }
+    }
+  };
+
+  const unsigned count = std::min<size_t>(
+      max(1u, thread::hardware_concurrency()), max<size_t>(1, paths.size()));
+  vector<thread> threads;
+  for (unsigned i = 1; i < count; ++i) {
+    threads.push_back(thread(work));
+  }
+  work();
+  for (thread& t : threads) {
+    t.join();
+  }
+
+  // A row that can no longer be read stays in the database, with no
+  // cells
+  CellIndex::Builder builder(cells);
+  vector<TrackDB::Row> added;
+  size_t failed = 0;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (!ok[i]) {
+      ++failed;
+      if (i < reindexed) builder.add(vector<CellIndex::Visit>());
+      continue;
+    }
+    if (i >= reindexed) added.push_back(std::move(rows[i]));
+    builder.add(visits[i]);
+  }
+
+  // Write the database first: an index that's behind is caught up next
+  // time
+  TrackDB::write(db, existing, added);
+  builder.write(cellsFile);
+
+  cerr << "Added " << added.size() << " of " << files.size()
+       << " files; " << existing.size() + added.size() << " in all" << endl;
+  return failed == 0 ? 0 : 1;
+}
+
+// count, sum, min, max, avg and list
+static int query(const string& what, int argc, char* argv[]) {
+  vector<TrackDB::Filter> filters;
+  bool sorted = false;
+  bool descending = false;
+  TrackDB::Column sortColumn = TrackDB::START_TIME;
+  long limit = -1;
+
+  while (true) {
+    const int opt = getopt(argc, argv, "w:s:n:");
+    if (opt == -1) break;
+    switch (opt) {
+      case 'w':
+        filters.push_back(TrackDB::parseFilter(optarg));
+        break;
+      case 's': {
+        string name = optarg;
+        descending = !name.empty() && name[0] == '-';
+        if (descending) name.erase(0, 1);
+        sortColumn = TrackDB::findColumn(name);
+        sorted = true;
+        break;
+      }
+      case 'n':
+        limit = strtol(optarg, 0, 0);
+        if (limit < 0) throw Exception("-n (rows) can't be negative");
+        break;
+      default:
+        throw Exception("Unknown option");
+    }
+  }
+
+  const bool isAggregate = what != "count" && what != "list";
+  if (optind + (isAggregate ? 2 : 1) != argc) {
+    throw Exception(isAggregate ? "Expecting a database and a column"
+                                : "Expecting a database");
+  }
+
+  const TrackDB db(argv[optind]);
+  vector<uint8_t> selected;
+  const size_t count = db.select(filters, selected);
+
+  if (what == "count") {
+    cout << count << endl;
+    return 0;
+  }
+
+  if (isAggregate) {
+    const TrackDB::Column column = TrackDB::findColumn(argv[optind + 1]);
+    const TrackDB::Aggregate result = db.aggregate(column, selected);
+    if (what == "sum") {
+      cout << number(result.sum) << endl;
+    } else if (result.count == 0) {
+      cout << endl;  // there's no minimum, maximum or average of nothing
+    } else if (what == "min") {
+      cout << number(result.min) << endl;
+    } else if (what == "max") {
+      cout << number(result.max) << endl;
+    } else {
+      cout << number(result.sum / result.count) << endl;
+    }
+    return 0;
+  }
+
+  vector<size_t> rows;
+  rows.reserve(count);
+  for (size_t r = 0; r < selected.size(); ++r) {
+    if (selected[r]) rows.push_back(r);
+  }
+  if (sorted) {
+    const double* v = db.column(sortColumn);
+    stable_sort(rows.begin(), rows.end(), [&](size_t a, size_t b) {
+      return descending ? v[a] > v[b] : v[a] < v[b];
+    });
+  }
+  if (limit >= 0 && rows.size() > static_cast<size_t>(limit)) {
+    rows.resize(limit);
+  }
+
+  cout << "path,name";
+  for (int c = 0; c < TrackDB::COLUMN_COUNT; ++c) {
+    cout << ',' << TrackDB::columnName(static_cast<TrackDB::Column>(c));
+  }
+  cout << '\n';
+  for (size_t r : rows) {
+    cout << csvField(db.path(r)) << ',' << csvField(db.name(r));
+    for (int c = 0; c < TrackDB::COLUMN_COUNT; ++c) {
+      cout << ',' << number(db.column(static_cast<TrackDB::Column>(c))[r]);
+    }
+    cout << '\n';
+  }
+  cout.flush();
+  return 0;
+}
+
+// within and near: find the activities that passed through an area, with
+// the points that may be in it
+static int area(const string& what, int argc, char* argv[]) {
+  vector<TrackDB::Filter> filters;
+  vector<double> where;
+
+  while (true) {
+    const int opt = getopt(argc, argv, "w:b:p:");
+    if (opt == -1) break;
+    switch (opt) {
+      case 'w':
+        filters.push_back(TrackDB::parseFilter(optarg));
+        break;
+      case 'b':
+        if (what != "within") throw Exception("-b is only for within");
+        where = parseNumbers(optarg, 4);
+        break;
+      case 'p':
+        if (what != "near") throw Exception("-p is only for near");
+        where = parseNumbers(optarg, 3);
+        if (where[2] <= 0) throw Exception("The distance must be positive");
+        break;
+      default:
+        throw Exception("Unknown option");
+    }
+  }
+
+  if (optind + 1 != argc) throw Exception("Expecting a database");
+  if (where.empty()) {
+    throw Exception(what == "within" ? "Expecting a box (-b)"
+                                     : "Expecting a position (-p)");
+  }
+
+  const string filename = argv[optind];
+  const TrackDB db(filename);
+  const CellIndex cells(cellIndexFile(filename));
+  vector<uint8_t> selected;
+  db.select(filters, selected);
+
+  const vector<CellIndex::Match> matches =
+      what == "within" ? cells.within(where[0], where[1], where[2], where[3])
+                       : cells.near(where[0], where[1], where[2]);
+
+  cout << "path,first,last\n";
+  for (const CellIndex::Match& match : matches) {
+    if (match.activity >= db.size() || !selected[match.activity]) continue;
+    cout << csvField(db.path(match.activity)) << ',' << match.first << ','
+         << match.last << '\n';
+  }
+  cout.flush();
+  return 0;
+}
+
+int main(int argc, char * argv[]) {
+  try {
+    if (argc < 2) throw Exception("Expecting a command");
+
+    // The command takes the place of the program name for getopt
+    const string what = argv[1];
+    if (what == "ingest") {
+      return ingest(argc - 1, argv + 1);
+    } else if (what == "count" || what == "sum" || what == "min" ||
+               what == "max" || what == "avg" || what == "list") {
+      return query(what, argc - 1, argv + 1);
+    } else if (what == "within" || what == "near") {
+      return area(what, argc - 1, argv + 1);
+    }
+    throw Exception("Unknown command '" + what + "'");
+
+  } catch (const std::exception& e) {
+    cerr << e.what() << endl;
+  } catch (...) {
+    cerr << "Unknown exception in main" << endl;
+  }
+
+  usage();
+  return 1;
+}
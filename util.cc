@@ -1,15 +1,44 @@
 
 #include "util.h"
+#include "exception.h"
 
 #include <string>
 #include <string.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace std;
 
 const double kMilesPerKilometer = 0.62137;
 const double kFeetPerMeter = 3.2808;
 
+MappedFile::MappedFile(const string& filename)
+    : address(nullptr), length(0) {
+  Descriptor file(::open(filename.c_str(), O_RDONLY));
+  if (file.get() < 0) {
+    if (errno == ENOENT) return;
+    throw SystemException(errno, "Opening " + filename);
+  }
+
+  struct stat info;
+  SystemException::check(::fstat(file.get(), &info), "Reading " + filename);
+  if (info.st_size == 0) return;
+
+  void* mapped = ::mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED,
+                        file.get(), 0);
+  if (mapped == MAP_FAILED) {
+    throw SystemException(errno, "Mapping " + filename);
+  }
+  address = mapped;
+  length = info.st_size;
+}
+
+MappedFile::~MappedFile() {
+  if (address != nullptr) ::munmap(address, length);
+}
+
 bool Util::endsWith(const string& str, const string& suffix) {
   return (suffix.size() <= str.size() &&
           (strncmp(suffix.data(),
@@ -41,6 +41,21 @@ class Descriptor {
   int descriptor;
 };
 
+// Map a whole file into memory, read-only. A missing or empty file maps
+// as empty. Throws a SystemException if the file can't be read.
+class MappedFile : public NoCopy {
+ public:
+  explicit MappedFile(const std::string& filename);
+  ~MappedFile();
+
+  const char* data() const { return static_cast<const char*>(address); }
+  size_t size() const { return length; }
+
+ private:
+  void* address;
+  size_t length;
+};
+
 class Util {
  public:
   // Does 'str' end with 'suffix'?